@@ -0,0 +1,411 @@
+// big_integer benchmark suite
+//
+// measures the cost of every big_integer operation at operand sizes growing
+// geometrically from --min-bits to --max-bits (64 bits to 1M bits by
+// default), and prints one record per (operation, size) pair with the
+// average time and the average number of heap allocations per operation.
+// the records are machine readable (csv or json) so runs can be diffed to
+// track regressions, and the per operation scaling curves can be used to
+// pick algorithm thresholds from the measured crossover points.
+//
+// usage:
+//   big_integer_bench [--format csv|json] [--output file]
+//                     [--min-bits n] [--max-bits n] [--step n]
+//                     [--min-time-ms n] [--max-op-ms n] [--ops a,b,...]
+//                     [--seed n]
+//
+// some of the operations are super-linear, so a single call at the larger
+// sizes may take minutes or hours. the time taken by an operation at the
+// previous sizes is used to predict its cost at the next size, and once the
+// prediction exceeds --max-op-ms the remaining sizes of that operation are
+// skipped (and reported on stderr) instead of stalling the whole run.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdexcept>
+
+#include "big_integer.h"
+
+///////////////////////////////////////
+// allocation counting
+
+static unsigned long long bench_alloc_count = 0;
+static unsigned long long bench_alloc_bytes = 0;
+
+void* operator new(std::size_t size){
+  ++bench_alloc_count, bench_alloc_bytes += size;
+  void *ptr = std::malloc(size ? size : 1);
+  if(ptr == NULL) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](std::size_t size){
+  ++bench_alloc_count, bench_alloc_bytes += size;
+  void *ptr = std::malloc(size ? size : 1);
+  if(ptr == NULL) throw std::bad_alloc();
+  return ptr;
+}
+
+// the replacements pair malloc and free, gcc only sees operator new and free
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 11)
+#pragma GCC diagnostic pop
+#endif
+
+///////////////////////////////////////
+// operands
+
+// xorshift64*, deterministic for a given seed so runs are comparable
+static unsigned long long bench_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long bench_random(){
+  bench_rng_state ^= bench_rng_state >> 12;
+  bench_rng_state ^= bench_rng_state << 25;
+  bench_rng_state ^= bench_rng_state >> 27;
+  return bench_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+// a positive random operand of exactly the given number of bits
+static big_integer random_operand(const int &bits, const bool &odd){
+  int bytes = (bits + 7) / 8;
+  std::vector<unsigned char> buffer(bytes);
+  for(int i = 0; i < bytes; ++i)
+    buffer[i] = (unsigned char)(bench_random() >> 56);
+
+  int top_bits = bits - ((bytes - 1) * 8);
+  buffer[0] &= (unsigned char)((1 << top_bits) - 1);
+  buffer[0] |= (unsigned char)(1 << (top_bits - 1));
+  if(odd) buffer[bytes - 1] |= 1;
+
+  return big_integer(my_bitset(&buffer[0], bytes), 1);
+}
+
+// a decimal string with roughly the same magnitude as a bits-wide operand
+static std::string random_decimal(const int &bits){
+  int digits = (int)(bits * 0.30102999566398120) + 1;
+  std::string str(digits, '0');
+  str[0] = (char)('1' + (bench_random() % 9));
+  for(int i = 1; i < digits; ++i)
+    str[i] = (char)('0' + (bench_random() % 10));
+  return str;
+}
+
+///////////////////////////////////////
+// cases
+
+// every case owns its operands, prepare() builds them for a given size
+// outside the measured region, and run() performs exactly one operation
+class bench_case {
+public:
+  virtual ~bench_case() { }
+  virtual const char* name() const = 0;
+  virtual void prepare(const int &bits) = 0;
+  virtual void run() = 0;
+};
+
+// keeps the results alive so the measured calls are not optimized away
+static unsigned long long bench_sink = 0;
+static void consume(const big_integer &value){ bench_sink += (value > 0); }
+static void consume(const std::string &value){ bench_sink += value.size(); }
+
+class add_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "add"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand(bits, 0); }
+  void run(){ consume(a + b); }
+};
+
+class sub_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "sub"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand(bits - 1, 0); }
+  void run(){ consume(a - b); }
+};
+
+// balanced multiplication, both operands have the full size
+class mul_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "mul"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand(bits, 0); }
+  void run(){ consume(a * b); }
+};
+
+// unbalanced multiplication by a single 64 bits word
+class mul_word_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "mul_word"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand(64, 0); }
+  void run(){ consume(a * b); }
+};
+
+// a bits-wide dividend by a half size divisor
+class div_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "div"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand((bits + 1) / 2, 0); }
+  void run(){ consume(a / b); }
+};
+
+class mod_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "mod"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand((bits + 1) / 2, 0); }
+  void run(){ consume(a % b); }
+};
+
+// base, exponent and modulus all have the full size
+class pow_mod_case : public bench_case {
+  big_integer base, exp, mod;
+public:
+  const char* name() const { return "pow_mod"; }
+  void prepare(const int &bits){
+    base = random_operand(bits - 1, 0), exp = random_operand(bits, 0), mod = random_operand(bits, 1);
+  }
+  void run(){ consume(base.pow_mod(exp, mod)); }
+};
+
+class gcd_case : public bench_case {
+  big_integer a, b;
+public:
+  const char* name() const { return "gcd"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0), b = random_operand(bits, 0); }
+  void run(){ consume(a.gcd(b)); }
+};
+
+class mod_inverse_case : public bench_case {
+  big_integer a, mod;
+public:
+  const char* name() const { return "mod_inverse"; }
+  void prepare(const int &bits){ a = random_operand(bits - 1, 0), mod = random_operand(bits, 1); }
+  void run(){ consume(a.mod_inverse(mod)); }
+};
+
+class parse_dec_case : public bench_case {
+  std::string str;
+public:
+  const char* name() const { return "parse_dec"; }
+  void prepare(const int &bits){ str = random_decimal(bits); }
+  void run(){ consume(big_integer(str)); }
+};
+
+class print_dec_case : public bench_case {
+  big_integer a;
+public:
+  const char* name() const { return "print_dec"; }
+  void prepare(const int &bits){ a = random_operand(bits, 0); }
+  void run(){ consume(a.to_dec_string()); }
+};
+
+///////////////////////////////////////
+// driver
+
+struct bench_options {
+  std::string format;
+  std::string output;
+  std::string ops;
+  int min_bits;
+  int max_bits;
+  int step;
+  double min_time_ms;
+  double max_op_ms;
+  unsigned long long seed;
+};
+
+struct bench_record {
+  std::string op;
+  int bits;
+  unsigned long long iterations;
+  double ns_per_op;
+  double allocs_per_op;
+  double bytes_per_op;
+};
+
+static double elapsed_ns(
+    const std::chrono::steady_clock::time_point &start,
+    const std::chrono::steady_clock::time_point &end){
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// runs the case until the minimum time is reached, the first call is
+// measured alone so that very slow operations are executed only once
+static bench_record measure(bench_case *c, const int &bits, const bench_options &options){
+  bench_record record;
+  record.op = c->name();
+  record.bits = bits;
+
+  c->prepare(bits);
+
+  double total_ns = 0;
+  unsigned long long iterations = 0, batch = 1;
+  unsigned long long allocs = 0, bytes = 0;
+  while(true){
+    unsigned long long allocs_before = bench_alloc_count, bytes_before = bench_alloc_bytes;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(unsigned long long i = 0; i < batch; ++i)
+      c->run();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    total_ns += elapsed_ns(start, end);
+    allocs += bench_alloc_count - allocs_before;
+    bytes += bench_alloc_bytes - bytes_before;
+    iterations += batch;
+
+    if(total_ns >= options.min_time_ms * 1e6) break;
+    batch = ((batch < (1ULL << 20)) ? (batch << 1) : batch);
+  }
+
+  record.iterations = iterations;
+  record.ns_per_op = total_ns / iterations;
+  record.allocs_per_op = (double)allocs / iterations;
+  record.bytes_per_op = (double)bytes / iterations;
+  return record;
+}
+
+static bool selected(const std::string &ops, const std::string &name){
+  if(ops.empty()) return true;
+  std::string list = "," + ops + ",";
+  return (list.find("," + name + ",") != std::string::npos);
+}
+
+static void write_csv(FILE *out, const std::vector<bench_record> &records){
+  fprintf(out, "op,bits,iterations,ns_per_op,allocs_per_op,bytes_per_op\n");
+  for(size_t i = 0; i < records.size(); ++i){
+    const bench_record &r = records[i];
+    fprintf(out, "%s,%d,%llu,%.1f,%.2f,%.1f\n", r.op.c_str(), r.bits,
+        r.iterations, r.ns_per_op, r.allocs_per_op, r.bytes_per_op);
+  }
+}
+
+static void write_json(FILE *out, const std::vector<bench_record> &records){
+  fprintf(out, "[\n");
+  for(size_t i = 0; i < records.size(); ++i){
+    const bench_record &r = records[i];
+    fprintf(out, "  {\"op\": \"%s\", \"bits\": %d, \"iterations\": %llu, "
+        "\"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}%s\n",
+        r.op.c_str(), r.bits, r.iterations, r.ns_per_op, r.allocs_per_op,
+        r.bytes_per_op, ((i + 1 < records.size()) ? "," : ""));
+  }
+  fprintf(out, "]\n");
+}
+
+static void usage(const char *program){
+  fprintf(stderr,
+      "usage: %s [--format csv|json] [--output file] [--min-bits n] [--max-bits n]\n"
+      "          [--step n] [--min-time-ms n] [--max-op-ms n] [--ops a,b,...] [--seed n]\n"
+      "ops: add,sub,mul,mul_word,div,mod,pow_mod,gcd,mod_inverse,parse_dec,print_dec\n",
+      program);
+}
+
+static bool parse_options(int argc, char **argv, bench_options &options){
+  options.format = "csv";
+  options.min_bits = 64;
+  options.max_bits = 1 << 20;
+  options.step = 4;
+  options.min_time_ms = 200;
+  options.max_op_ms = 5000;
+  options.seed = 1;
+
+  for(int i = 1; i < argc; ++i){
+    std::string arg = argv[i];
+    if(arg == "--help" || arg == "-h") return false;
+    if(i + 1 >= argc) return false;
+
+    std::string value = argv[++i];
+    if(arg == "--format") options.format = value;
+    else if(arg == "--output") options.output = value;
+    else if(arg == "--ops") options.ops = value;
+    else if(arg == "--min-bits") options.min_bits = atoi(value.c_str());
+    else if(arg == "--max-bits") options.max_bits = atoi(value.c_str());
+    else if(arg == "--step") options.step = atoi(value.c_str());
+    else if(arg == "--min-time-ms") options.min_time_ms = atof(value.c_str());
+    else if(arg == "--max-op-ms") options.max_op_ms = atof(value.c_str());
+    else if(arg == "--seed") options.seed = strtoull(value.c_str(), NULL, 10);
+    else return false;
+  }
+
+  return (options.format == "csv" || options.format == "json")
+      && (options.min_bits >= 8) && (options.max_bits >= options.min_bits)
+      && (options.step >= 2);
+}
+
+int main(int argc, char **argv){
+  bench_options options;
+  if(!parse_options(argc, argv, options)){
+    usage(argv[0]);
+    return 1;
+  }
+
+  bench_rng_state ^= options.seed * 0xBF58476D1CE4E5B9ULL;
+
+  std::vector<bench_case*> cases;
+  cases.push_back(new add_case());
+  cases.push_back(new sub_case());
+  cases.push_back(new mul_case());
+  cases.push_back(new mul_word_case());
+  cases.push_back(new div_case());
+  cases.push_back(new mod_case());
+  cases.push_back(new pow_mod_case());
+  cases.push_back(new gcd_case());
+  cases.push_back(new mod_inverse_case());
+  cases.push_back(new parse_dec_case());
+  cases.push_back(new print_dec_case());
+
+  std::vector<bench_record> records;
+  for(size_t c = 0; c < cases.size(); ++c){
+    if(!selected(options.ops, cases[c]->name())) continue;
+
+    double prev_ns = 0, last_ns = 0;
+    for(long long bits = options.min_bits; bits <= options.max_bits; bits *= options.step){
+      // extrapolate the growth observed between the last two sizes, and
+      // assume at least linear growth when there is no history yet
+      if(last_ns > 0){
+        double growth = ((prev_ns > 0) ? (last_ns / prev_ns) : options.step);
+        if(growth < options.step) growth = options.step;
+        if(last_ns * growth > options.max_op_ms * 1e6){
+          fprintf(stderr, "%s: skipping sizes from %lld bits, predicted %.0f ms per op\n",
+              cases[c]->name(), bits, (last_ns * growth) / 1e6);
+          break;
+        }
+      }
+
+      bench_record record = measure(cases[c], (int)bits, options);
+      records.push_back(record);
+      prev_ns = last_ns, last_ns = record.ns_per_op;
+      fprintf(stderr, "%s %lld bits: %.1f ns/op\n", record.op.c_str(), bits, record.ns_per_op);
+    }
+  }
+
+  for(size_t c = 0; c < cases.size(); ++c)
+    delete cases[c];
+
+  FILE *out = stdout;
+  if(!options.output.empty()){
+    out = fopen(options.output.c_str(), "w");
+    if(out == NULL){
+      fprintf(stderr, "can not open %s\n", options.output.c_str());
+      return 1;
+    }
+  }
+
+  if(options.format == "json") write_json(out, records);
+  else write_csv(out, records);
+
+  if(out != stdout) fclose(out);
+  return (bench_sink == 0xFFFFFFFFFFFFFFFFULL);
+}
@@ -0,0 +1,204 @@
+#ifndef ATOMIC_BITSET_H_
+#define ATOMIC_BITSET_H_
+
+#include <cstdlib>
+#include <atomic>
+#include <stdexcept>
+
+#include "bit_ops.h"
+#include "my_bitset.h"
+
+// fixed size bitset that many threads can update at once, every block is
+// a 64 bits std::atomic and the single bit updates are one lock free
+// fetch_or / fetch_and, so no mutex is needed. the bits follow the
+// my_bitset layout (bit 0 is the most significant bit of block 0).
+//
+// the default orderings: a write is a release, a read is an acquire, and
+// the read-modify-write operations are acq_rel, so a thread that sees a
+// bit set also sees everything its setter wrote before setting it. pass
+// std::memory_order_relaxed when the bits carry no other data.
+//
+// the bulk functions (count, get_block, to_my_bitset, clear) read or write
+// each block once with relaxed ordering, they are meant for the phases
+// when no other thread is writing, they do not see a consistent snapshot
+// otherwise.
+
+class atomic_bitset {
+private:
+  const static int block_size = (sizeof(unsigned long long) * 8);
+  std::atomic<unsigned long long> *arr;
+  int bits;
+  int blocks;
+
+  void check_index(const int &index, const char *where) const;
+  unsigned long long static mask(const int &index);
+
+  atomic_bitset(const atomic_bitset &);
+  atomic_bitset& operator = (const atomic_bitset &);
+
+public:
+  // all bits clear
+  atomic_bitset(const int &size);
+  // the bits of a my_bitset
+  atomic_bitset(const my_bitset &_my_bitset);
+  ~atomic_bitset();
+
+  int size() const;
+  int blocks_count() const;
+
+  // a load cannot be a release, release and acq_rel are read as acquire
+  bool test(const int &index,
+      const std::memory_order &order = std::memory_order_acquire) const;
+  void set(const int &index,
+      const std::memory_order &order = std::memory_order_release);
+  void reset(const int &index,
+      const std::memory_order &order = std::memory_order_release);
+  // set the bit and return its previous value, exactly one of the
+  // threads racing on a clear bit gets false
+  bool test_and_set(const int &index,
+      const std::memory_order &order = std::memory_order_acq_rel);
+  bool test_and_reset(const int &index,
+      const std::memory_order &order = std::memory_order_acq_rel);
+  // or / and a whole block with a mask, return the previous block
+  unsigned long long fetch_or_word(const int &block_index, const unsigned long long &mask,
+      const std::memory_order &order = std::memory_order_acq_rel);
+  unsigned long long fetch_and_word(const int &block_index, const unsigned long long &mask,
+      const std::memory_order &order = std::memory_order_acq_rel);
+
+  // bulk access, for quiescent phases only
+  unsigned long long get_block(const int &index) const;
+  int count() const;
+  void clear();
+  my_bitset to_my_bitset() const;
+};
+
+///////////////////////////////////////
+
+const int atomic_bitset::block_size;
+
+void atomic_bitset::check_index(const int &index, const char *where) const{
+  if((index < 0) || (index >= this->bits))
+    throw std::out_of_range(where);
+}
+
+unsigned long long atomic_bitset::mask(const int &index){
+  return 1ULL << (atomic_bitset::block_size - (index % atomic_bitset::block_size) - 1);
+}
+
+atomic_bitset::atomic_bitset(const int &size){
+  if(size < 0)
+    throw std::runtime_error("atomic_bitset::atomic_bitset: invalid_size");
+
+  this->bits = size;
+  this->blocks = (size + atomic_bitset::block_size - 1) / atomic_bitset::block_size;
+  this->arr = ((this->blocks == 0) ? NULL : new std::atomic<unsigned long long>[this->blocks]);
+  for(int i = 0; i < this->blocks; ++i)
+    this->arr[i].store(0, std::memory_order_relaxed);
+}
+
+atomic_bitset::atomic_bitset(const my_bitset &_my_bitset){
+  if(_my_bitset.size() > 0x7FFFFFFFLL)
+    throw std::length_error("atomic_bitset::atomic_bitset: size_too_large");
+  this->bits = (int)_my_bitset.size();
+  this->blocks = _my_bitset.blocks_count();
+  this->arr = ((this->blocks == 0) ? NULL : new std::atomic<unsigned long long>[this->blocks]);
+  for(int i = 0; i < this->blocks; ++i)
+    this->arr[i].store(_my_bitset.get_block(i), std::memory_order_relaxed);
+}
+
+atomic_bitset::~atomic_bitset(){
+  delete[] this->arr;
+}
+
+int atomic_bitset::size() const{
+  return this->bits;
+}
+
+int atomic_bitset::blocks_count() const{
+  return this->blocks;
+}
+
+bool atomic_bitset::test(const int &index, const std::memory_order &order) const{
+  this->check_index(index, "atomic_bitset::test: index_out_of_bound");
+  std::memory_order load_order = (((order == std::memory_order_release) || (order == std::memory_order_acq_rel)) ?
+      std::memory_order_acquire : order);
+  return (this->arr[index / atomic_bitset::block_size].load(load_order) & atomic_bitset::mask(index)) != 0;
+}
+
+void atomic_bitset::set(const int &index, const std::memory_order &order){
+  this->check_index(index, "atomic_bitset::set: index_out_of_bound");
+  this->arr[index / atomic_bitset::block_size].fetch_or(atomic_bitset::mask(index), order);
+}
+
+void atomic_bitset::reset(const int &index, const std::memory_order &order){
+  this->check_index(index, "atomic_bitset::reset: index_out_of_bound");
+  this->arr[index / atomic_bitset::block_size].fetch_and(~atomic_bitset::mask(index), order);
+}
+
+bool atomic_bitset::test_and_set(const int &index, const std::memory_order &order){
+  this->check_index(index, "atomic_bitset::test_and_set: index_out_of_bound");
+  unsigned long long bit = atomic_bitset::mask(index);
+  std::atomic<unsigned long long> &block = this->arr[index / atomic_bitset::block_size];
+  // a plain load first avoids taking the cache line exclusively
+  // when the bit is already set, the common case of a visited map. a
+  // seq_cst call that returns there must still take part in the single
+  // total order, so its load is seq_cst too
+  std::memory_order load_order = ((order == std::memory_order_relaxed) ? std::memory_order_relaxed :
+      ((order == std::memory_order_seq_cst) ? std::memory_order_seq_cst : std::memory_order_acquire));
+  if(block.load(load_order) & bit) return true;
+  return (block.fetch_or(bit, order) & bit) != 0;
+}
+
+bool atomic_bitset::test_and_reset(const int &index, const std::memory_order &order){
+  this->check_index(index, "atomic_bitset::test_and_reset: index_out_of_bound");
+  unsigned long long bit = atomic_bitset::mask(index);
+  return (this->arr[index / atomic_bitset::block_size].fetch_and(~bit, order) & bit) != 0;
+}
+
+unsigned long long atomic_bitset::fetch_or_word(const int &block_index, const unsigned long long &mask,
+    const std::memory_order &order){
+  if((block_index < 0) || (block_index >= this->blocks))
+    throw std::out_of_range("atomic_bitset::fetch_or_word: index_out_of_bound");
+
+  // the unused low bits of the last block stay clear
+  unsigned long long _mask = mask;
+  int used = this->bits % atomic_bitset::block_size;
+  if((block_index == this->blocks - 1) && (used != 0)) _mask &= ~(~0ULL >> used);
+  return this->arr[block_index].fetch_or(_mask, order);
+}
+
+unsigned long long atomic_bitset::fetch_and_word(const int &block_index, const unsigned long long &mask,
+    const std::memory_order &order){
+  if((block_index < 0) || (block_index >= this->blocks))
+    throw std::out_of_range("atomic_bitset::fetch_and_word: index_out_of_bound");
+  return this->arr[block_index].fetch_and(mask, order);
+}
+
+unsigned long long atomic_bitset::get_block(const int &index) const{
+  if((index < 0) || (index >= this->blocks))
+    throw std::out_of_range("atomic_bitset::get_block: index_out_of_bound");
+  return this->arr[index].load(std::memory_order_relaxed);
+}
+
+int atomic_bitset::count() const{
+  int result = 0;
+  for(int i = 0; i < this->blocks; ++i)
+    result += bit_ops::popcount(this->arr[i].load(std::memory_order_relaxed));
+  return result;
+}
+
+void atomic_bitset::clear(){
+  for(int i = 0; i < this->blocks; ++i)
+    this->arr[i].store(0, std::memory_order_relaxed);
+}
+
+my_bitset atomic_bitset::to_my_bitset() const{
+  my_bitset result(this->bits, 0);
+  for(int i = 0; i < this->blocks; ++i){
+    unsigned long long block = this->arr[i].load(std::memory_order_relaxed);
+    if(block != 0) result.set_block(i, block);
+  }
+  return result;
+}
+
+#endif /* ATOMIC_BITSET_H_ */
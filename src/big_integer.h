@@ -34,6 +34,9 @@ public:
   // numerical constructor (base 10)
   big_integer(const long long &value);
   big_integer(const unsigned long long &value, const signed char &sign);
+  // magnitude constructor, the bitset holds the big-endian magnitude, of
+  // any number of bits
+  big_integer(const my_bitset &magnitude, const signed char &sign);
   // string constructor (base 10)
   big_integer(const std::string &value);
   ~big_integer();
@@ -78,6 +81,9 @@ public:
   std::string to_dec_string() const;
   std::string to_hex_string() const;
   long long to_llong() const;
+
+  signed char get_sign() const;
+  const my_bitset& get_magnitude() const;
 };
 
 ///////////////////////////////////////
@@ -132,7 +138,7 @@ my_bitset big_integer::add(const my_bitset &op1, const my_bitset &op2){
   }
 
   if(carry)
-    result = result.pad_left(1, 0), result.set_word(0, carry);
+    result = result.pad_left(word_size, 0), result.set_word(0, carry);
 
   if((result.words_count() > 0) && (result.get_word(0) == 0))
     result = result.trim_left();
@@ -270,7 +276,7 @@ my_bitset big_integer::div_and_mod(const my_bitset &op1, const my_bitset &op2, c
     if(r.get_word(0) >= NEED_TO_PAD_THRESHOLD)
       r = r.pad_left(r.size(), 0);
 
-    r = r << 1;
+    r <<= 1;
     r.set(r.size() - 1, op1.get(i));
     if(r >= op2){
       r = big_integer::sub(r, op2);
@@ -349,6 +355,16 @@ big_integer::big_integer(const unsigned long long &value, const signed char &sig
   this->mag = my_bitset(value).trim_left();
 }
 
+big_integer::big_integer(const my_bitset &magnitude, const signed char &sign){
+  this->mag = magnitude.trim_left();
+  // the magnitude is kept in whole words, the leading zeros of a partial
+  // first word are added back
+  long long partial = this->mag.size() % my_bitset::get_word_size();
+  if(partial != 0) this->mag = this->mag.pad_left(my_bitset::get_word_size() - partial, 0);
+  this->sign = ((sign == 0) ? 0 : ((sign < 0) ? -1 : 1));
+  if(this->mag.size() == 0) this->sign = 0;
+}
+
 // string constructor (base 10)
 big_integer::big_integer(const std::string &value){
   int cursor = 0;
@@ -627,7 +643,7 @@ big_integer big_integer::pow_mod(const big_integer &exp, const big_integer &mod)
 
   big_integer base(*this);
   big_integer result(1);
-  while(_exp > 0){
+  while(_exp.sign > 0){
     if (_exp.mag.get(_exp.mag.size() - 1))  result = (result * base) % mod;
     _exp = _exp >> 1;
     base = (base * base) % mod;
@@ -672,8 +688,8 @@ big_integer big_integer::gcd(const big_integer &_big_integer) const{
     ++max_pow_2;
   }
 
-  (*op1_ptr) = (*op1_ptr) >> max_pow_2;
-  (*op2_ptr) = (*op2_ptr) >> max_pow_2;
+  (*op1_ptr) >>= max_pow_2;
+  (*op2_ptr) >>= max_pow_2;
 
   // dividing a by a power of 2 to be odd
   int last_set_bit = 0;
@@ -682,7 +698,7 @@ big_integer big_integer::gcd(const big_integer &_big_integer) const{
     ++last_set_bit;
   }
 
-  (*op1_ptr) = (*op1_ptr) >> last_set_bit;
+  (*op1_ptr) >>= last_set_bit;
 
   while (op2_ptr->size() > 0) {
     // dividing b by a power of 2 to be odd
@@ -692,7 +708,7 @@ big_integer big_integer::gcd(const big_integer &_big_integer) const{
       ++last_set_bit;
     }
 
-    (*op2_ptr) = (*op2_ptr) >> last_set_bit;
+    (*op2_ptr) >>= last_set_bit;
 
     // swap if a > b
     if(my_bitset::compare((*op1_ptr), (*op2_ptr)) == -1){
@@ -706,10 +722,13 @@ big_integer big_integer::gcd(const big_integer &_big_integer) const{
 
   }
 
-  // restore common factors of 2 by left shift
+  // restore common factors of 2 by left shift, the padding is rounded
+  // up to whole words to keep the magnitude a multiple of the word size
+  int pad_size = ((max_pow_2 + my_bitset::get_word_size() - 1) /
+      my_bitset::get_word_size()) * my_bitset::get_word_size();
   big_integer result;
   result.sign = ((mag_comprison > 0) ? this->sign : _big_integer.sign);
-  result.mag = ((*op1_ptr).pad_left(max_pow_2, 0)) << max_pow_2;
+  result.mag = ((*op1_ptr).pad_left(pad_size, 0)) << max_pow_2;
   if((result.mag.words_count() > 0) && (result.mag.get_word(0) == 0))
     result.mag = result.mag.trim_left();
   if(result.mag.size() == 0) result.sign = 0;
@@ -830,6 +849,8 @@ std::string big_integer::to_string() const{
     result[i] += (unsigned char)'0';
 
   std::string result_str((char*)result, result_size);
+  delete[] result;
+  delete[] dec_one;
   if(this->sign < 0) return "-" + result_str;
   else return result_str;
 }
@@ -943,4 +964,12 @@ long long big_integer::to_llong() const{
   return llong_mag * this->sign;
 }
 
+signed char big_integer::get_sign() const{
+  return this->sign;
+}
+
+const my_bitset& big_integer::get_magnitude() const{
+  return this->mag;
+}
+
 #endif /* BIG_INTEGER_H_ */
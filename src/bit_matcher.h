@@ -0,0 +1,309 @@
+#ifndef BIT_MATCHER_H_
+#define BIT_MATCHER_H_
+
+#include <cstdlib>
+#include <string>
+#include <stdexcept>
+#include <vector>
+
+#include "my_bitset.h"
+
+// bit parallel string matching, the state of the automaton of a pattern of
+// m characters is a vector of m bits held in (m + 63) / 64 words of 64
+// bits, so a text character costs O(m / 64) word operations whatever the
+// length of the pattern. the words are least significant bit first (bit i
+// of the vector is bit i % 64 of word i / 64), unlike the my_bitset blocks,
+// because the algorithms shift and add across the words as one big number.
+//
+// exact matching is shift-or: bit i of the state is 0 when the last i + 1
+// characters of the text are the first i + 1 characters of the pattern.
+//
+// approximate matching is myers' bit vector algorithm, the column of the
+// edit distance dynamic programming matrix is encoded by its vertical
+// deltas (+1 in pv, -1 in mv), the search version only updates the words
+// down to the last one that can still hold a value <= k (myers' block
+// cutoff, hyyro's multi word form), so the cost follows k / 64 rather than
+// m / 64 when the pattern is much longer than the errors allowed.
+
+class bit_matcher {
+public:
+  struct match {
+    // the index of the last character of the matching substring
+    int end;
+    int distance;
+  };
+
+private:
+  const static int word_size = 64;
+  const static int alphabet = 256;
+
+  int length;
+  int words;
+  // peq[c * words + w], bit i set when pattern[i] == c
+  std::vector<unsigned long long> peq;
+  // the complements, the shift-or masks
+  std::vector<unsigned long long> not_peq;
+
+  void init(const unsigned char *pattern, const int &length);
+  // the bit of the last pattern character in its word
+  unsigned long long last_bit() const;
+  int height(const int &word) const;
+  // one step of myers' algorithm on one word, returns the horizontal
+  // delta at its bottom, hin is the one at its top
+  int static advance_word(unsigned long long &pv, unsigned long long &mv, const unsigned long long &eq,
+      const int &hin, const unsigned long long &high_bit);
+
+public:
+  bit_matcher(const char *pattern, const int &length);
+  bit_matcher(const std::string &pattern);
+
+  int size() const;
+
+  // the start indices of all the occurrences, overlapping ones included
+  std::vector<int> find_all(const char *text, const int &length) const;
+  std::vector<int> find_all(const std::string &text) const;
+  // the same as a bitset of the text size, bit i set if an occurrence
+  // starts at i
+  my_bitset occurrences(const char *text, const int &length) const;
+  // the first occurrence at or after from, -1 if there is none
+  int find(const char *text, const int &length, const int &from) const;
+
+  // all the text positions where a substring ending there is within edit
+  // distance k of the pattern, with that smallest distance
+  std::vector<match> find_approximate(const char *text, const int &length, const int &k) const;
+  std::vector<match> find_approximate(const std::string &text, const int &k) const;
+  // the edit distance (levenshtein) of the pattern and the whole text
+  int edit_distance(const char *text, const int &length) const;
+  int edit_distance(const std::string &text) const;
+};
+
+///////////////////////////////////////
+
+const int bit_matcher::word_size;
+const int bit_matcher::alphabet;
+
+void bit_matcher::init(const unsigned char *pattern, const int &length){
+  if(length <= 0)
+    throw std::runtime_error("bit_matcher::bit_matcher: empty_pattern");
+
+  this->length = length;
+  this->words = (length + bit_matcher::word_size - 1) / bit_matcher::word_size;
+  this->peq.assign((size_t)bit_matcher::alphabet * this->words, 0);
+  for(int i = 0; i < length; ++i)
+    this->peq[(size_t)pattern[i] * this->words + (i / bit_matcher::word_size)] |= 1ULL << (i % bit_matcher::word_size);
+
+  this->not_peq.resize(this->peq.size());
+  for(size_t i = 0; i < this->peq.size(); ++i)
+    this->not_peq[i] = ~this->peq[i];
+}
+
+bit_matcher::bit_matcher(const char *pattern, const int &length){
+  this->init((const unsigned char*)pattern, length);
+}
+
+bit_matcher::bit_matcher(const std::string &pattern){
+  this->init((const unsigned char*)pattern.c_str(), (int)pattern.size());
+}
+
+unsigned long long bit_matcher::last_bit() const{
+  return 1ULL << ((this->length - 1) % bit_matcher::word_size);
+}
+
+int bit_matcher::height(const int &word) const{
+  int rest = this->length - (word * bit_matcher::word_size);
+  return ((rest < bit_matcher::word_size) ? rest : bit_matcher::word_size);
+}
+
+int bit_matcher::size() const{
+  return this->length;
+}
+
+///////////////////////////////////////
+// shift-or
+
+int bit_matcher::find(const char *text, const int &length, const int &from) const{
+  const unsigned char *t = (const unsigned char*)text;
+  int start = ((from < 0) ? 0 : from);
+  unsigned long long high = this->last_bit();
+
+  if(this->words == 1) {
+    unsigned long long d = ~0ULL;
+    for(int j = start; j < length; ++j){
+      d = (d << 1) | this->not_peq[t[j]];
+      if(!(d & high)) return j - this->length + 1;
+    }
+    return -1;
+  }
+
+  std::vector<unsigned long long> d(this->words, ~0ULL);
+  for(int j = start; j < length; ++j){
+    const unsigned long long *mask = this->not_peq.data() + (size_t)t[j] * this->words;
+    unsigned long long carry = 0;
+    for(int w = 0; w < this->words; ++w){
+      unsigned long long next = (d[w] << 1) | carry | mask[w];
+      carry = d[w] >> (bit_matcher::word_size - 1);
+      d[w] = next;
+    }
+    if(!(d[this->words - 1] & high)) return j - this->length + 1;
+  }
+  return -1;
+}
+
+my_bitset bit_matcher::occurrences(const char *text, const int &length) const{
+  if(length < 0)
+    throw std::runtime_error("bit_matcher::occurrences: invalid_size");
+
+  const unsigned char *t = (const unsigned char*)text;
+  my_bitset result(length, 0);
+  unsigned long long high = this->last_bit();
+
+  if(this->words == 1) {
+    unsigned long long d = ~0ULL;
+    for(int j = 0; j < length; ++j){
+      d = (d << 1) | this->not_peq[t[j]];
+      if(!(d & high)) result.set(j - this->length + 1, true);
+    }
+    return result;
+  }
+
+  std::vector<unsigned long long> d(this->words, ~0ULL);
+  for(int j = 0; j < length; ++j){
+    const unsigned long long *mask = this->not_peq.data() + (size_t)t[j] * this->words;
+    unsigned long long carry = 0;
+    for(int w = 0; w < this->words; ++w){
+      unsigned long long next = (d[w] << 1) | carry | mask[w];
+      carry = d[w] >> (bit_matcher::word_size - 1);
+      d[w] = next;
+    }
+    if(!(d[this->words - 1] & high)) result.set(j - this->length + 1, true);
+  }
+  return result;
+}
+
+std::vector<int> bit_matcher::find_all(const char *text, const int &length) const{
+  std::vector<int> result;
+  this->occurrences(text, length).for_each_set_bit([&result](int index){ result.push_back(index); });
+  return result;
+}
+
+std::vector<int> bit_matcher::find_all(const std::string &text) const{
+  return this->find_all(text.c_str(), (int)text.size());
+}
+
+///////////////////////////////////////
+// myers
+
+int bit_matcher::advance_word(unsigned long long &pv, unsigned long long &mv, const unsigned long long &eq,
+    const int &hin, const unsigned long long &high_bit){
+  unsigned long long e = eq;
+  unsigned long long xv = e | mv;
+  // a -1 coming from above acts as a match in the first row
+  if(hin < 0) e |= 1;
+  unsigned long long xh = (((e & pv) + pv) ^ pv) | e;
+  unsigned long long ph = mv | ~(xh | pv);
+  unsigned long long mh = pv & xh;
+
+  int hout = 0;
+  if(ph & high_bit) hout = 1;
+  else if(mh & high_bit) hout = -1;
+
+  ph <<= 1;
+  mh <<= 1;
+  if(hin < 0) mh |= 1;
+  else if(hin > 0) ph |= 1;
+  pv = mh | ~(xv | ph);
+  mv = ph & xv;
+  return hout;
+}
+
+std::vector<bit_matcher::match> bit_matcher::find_approximate(const char *text, const int &length, const int &k) const{
+  if(k < 0)
+    throw std::runtime_error("bit_matcher::find_approximate: invalid_k");
+
+  const unsigned char *t = (const unsigned char*)text;
+  const unsigned long long top = 1ULL << (bit_matcher::word_size - 1);
+  int last = this->words - 1;
+  std::vector<match> result;
+
+  if(this->words == 1) {
+    unsigned long long pv = ~0ULL, mv = 0, high = this->last_bit();
+    int score = this->length;
+    for(int j = 0; j < length; ++j){
+      score += bit_matcher::advance_word(pv, mv, this->peq[t[j]], 0, high);
+      if(score <= k) {
+        match found = {j, score};
+        result.push_back(found);
+      }
+    }
+    return result;
+  }
+
+  std::vector<unsigned long long> pv(this->words, ~0ULL), mv(this->words, 0);
+  // score[w] is the value of the bottom row of word w
+  std::vector<int> score(this->words);
+  for(int w = 0; w < this->words; ++w)
+    score[w] = (w * bit_matcher::word_size) + this->height(w);
+
+  // the words 0 to y are active, below them every value is > k
+  int y = (k + bit_matcher::word_size - 1) / bit_matcher::word_size - 1;
+  if(y < 0) y = 0;
+  if(y > last) y = last;
+
+  for(int j = 0; j < length; ++j){
+    const unsigned long long *eq = this->peq.data() + (size_t)t[j] * this->words;
+
+    // the first row is all zeros, a match can start anywhere
+    int carry = 0;
+    for(int w = 0; w <= y; ++w){
+      carry = bit_matcher::advance_word(pv[w], mv[w], eq[w], carry, ((w == last) ? this->last_bit() : top));
+      score[w] += carry;
+    }
+
+    if((y < last) && (score[y] - carry <= k) && ((eq[y + 1] & 1) || (carry < 0))) {
+      // the next word can reach k, it starts from the column of a
+      // fresh start, every value one more than the one above
+      ++y;
+      pv[y] = ~0ULL;
+      mv[y] = 0;
+      int hout = bit_matcher::advance_word(pv[y], mv[y], eq[y], carry, ((y == last) ? this->last_bit() : top));
+      score[y] = score[y - 1] + this->height(y) - carry + hout;
+    }
+    else {
+      while((y > 0) && (score[y] >= k + bit_matcher::word_size)) --y;
+    }
+
+    if((y == last) && (score[y] <= k)) {
+      match found = {j, score[y]};
+      result.push_back(found);
+    }
+  }
+  return result;
+}
+
+std::vector<bit_matcher::match> bit_matcher::find_approximate(const std::string &text, const int &k) const{
+  return this->find_approximate(text.c_str(), (int)text.size(), k);
+}
+
+int bit_matcher::edit_distance(const char *text, const int &length) const{
+  const unsigned char *t = (const unsigned char*)text;
+  const unsigned long long top = 1ULL << (bit_matcher::word_size - 1);
+  int last = this->words - 1;
+
+  std::vector<unsigned long long> pv(this->words, ~0ULL), mv(this->words, 0);
+  int score = this->length;
+  for(int j = 0; j < length; ++j){
+    const unsigned long long *eq = this->peq.data() + (size_t)t[j] * this->words;
+    // the first row counts the text characters, +1 at every step
+    int carry = 1;
+    for(int w = 0; w <= last; ++w)
+      carry = bit_matcher::advance_word(pv[w], mv[w], eq[w], carry, ((w == last) ? this->last_bit() : top));
+    score += carry;
+  }
+  return score;
+}
+
+int bit_matcher::edit_distance(const std::string &text) const{
+  return this->edit_distance(text.c_str(), (int)text.size());
+}
+
+#endif /* BIT_MATCHER_H_ */
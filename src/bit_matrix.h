@@ -0,0 +1,403 @@
+#ifndef BIT_MATRIX_H_
+#define BIT_MATRIX_H_
+
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+#include "worker_threads.h"
+
+// dense matrix over GF(2), addition is xor and multiplication is and. the
+// rows are stored one after the other in a single array, every row in the
+// my_bitset block format (column 0 is the most significant bit of the first
+// block of the row, the unused low bits of the last block are zeros), so a
+// row converts to and from a my_bitset with one copy and the row updates go
+// through the simd kernels.
+//
+// the product uses the method of the four russians: the rows of the right
+// matrix are taken 8 at a time and all the 256 sums of them are built once,
+// then every row of the left matrix adds one table row per 8 columns
+// instead of up to 8. the product can run on several threads, each one
+// building its own tables for a contiguous band of result rows, pass
+// threads = 0 to take one thread per core.
+//
+// the elimination gives the reduced row echelon form, rank and solve are
+// built on it.
+
+class bit_matrix {
+private:
+  const static int block_size = 64;
+  // the columns taken at once by the four russians tables
+  const static int table_bits = 8;
+  // a band thinner than this costs more in table building and thread
+  // start than its rows save
+  const static int rows_per_thread = 256;
+
+  int rows;
+  int cols;
+  // the blocks of a row
+  int stride;
+  std::vector<unsigned long long> arr;
+
+  unsigned long long* row(const int &index);
+  const unsigned long long* row(const int &index) const;
+  void check_index(const int &row_index, const int &col_index, const char *where) const;
+
+  void static multiply_rows(const bit_matrix &_bit_matrix1, const bit_matrix &_bit_matrix2,
+      bit_matrix &result, const int &first, const int &last);
+  void static transpose_64(unsigned long long *block);
+
+public:
+  bit_matrix();
+  // all zeros
+  bit_matrix(const int &rows, const int &cols);
+  // one row per bitset, all of the same size
+  bit_matrix(const std::vector<my_bitset> &rows);
+  bit_matrix static identity(const int &size);
+
+  int rows_count() const;
+  int cols_count() const;
+  bool get(const int &row_index, const int &col_index) const;
+  void set(const int &row_index, const int &col_index, const bool &value);
+  my_bitset get_row(const int &index) const;
+  void set_row(const int &index, const my_bitset &_my_bitset);
+  // the blocks of a row, a writer must keep the unused tail bits clear
+  unsigned long long* row_data(const int &index);
+  const unsigned long long* row_data(const int &index) const;
+
+  bool operator == (const bit_matrix &_bit_matrix) const;
+  bool operator != (const bit_matrix &_bit_matrix) const;
+
+  // the sum, both matrices must have the same shape
+  bit_matrix operator ^ (const bit_matrix &_bit_matrix) const;
+  bit_matrix& operator ^= (const bit_matrix &_bit_matrix);
+  // the product, the columns of the left matrix must match the rows of
+  // the right one
+  bit_matrix operator * (const bit_matrix &_bit_matrix) const;
+  bit_matrix static multiply(const bit_matrix &_bit_matrix1, const bit_matrix &_bit_matrix2, const int &threads);
+  // the product with a column vector of cols_count() bits
+  my_bitset operator * (const my_bitset &_my_bitset) const;
+
+  // 64x64 blocks are transposed in registers and written to their
+  // mirrored place
+  bit_matrix transpose() const;
+
+  // turns the matrix into its reduced row echelon form and returns its
+  // rank, the pivot rows are the first ones
+  int eliminate();
+  int rank() const;
+  // finds an x with (*this) * x == b, b has rows_count() bits, the free
+  // variables are zeros, returns false if the system has no solution
+  bool solve(const my_bitset &b, my_bitset &x) const;
+};
+
+///////////////////////////////////////
+
+const int bit_matrix::block_size;
+const int bit_matrix::table_bits;
+const int bit_matrix::rows_per_thread;
+
+unsigned long long* bit_matrix::row(const int &index){
+  return this->arr.data() + ((size_t)index * this->stride);
+}
+
+const unsigned long long* bit_matrix::row(const int &index) const{
+  return this->arr.data() + ((size_t)index * this->stride);
+}
+
+void bit_matrix::check_index(const int &row_index, const int &col_index, const char *where) const{
+  if((row_index < 0) || (row_index >= this->rows) || (col_index < 0) || (col_index >= this->cols))
+    throw std::out_of_range(where);
+}
+
+bit_matrix::bit_matrix(){
+  this->rows = this->cols = this->stride = 0;
+}
+
+bit_matrix::bit_matrix(const int &rows, const int &cols){
+  if((rows < 0) || (cols < 0))
+    throw std::runtime_error("bit_matrix::bit_matrix: invalid_size");
+
+  this->rows = rows;
+  this->cols = cols;
+  this->stride = (cols + bit_matrix::block_size - 1) / bit_matrix::block_size;
+  this->arr.assign((size_t)rows * this->stride, 0);
+}
+
+bit_matrix::bit_matrix(const std::vector<my_bitset> &rows){
+  this->rows = (int)rows.size();
+  this->cols = (rows.empty() ? 0 : rows[0].size());
+  this->stride = (this->cols + bit_matrix::block_size - 1) / bit_matrix::block_size;
+  this->arr.assign((size_t)this->rows * this->stride, 0);
+  for(int i = 0; i < this->rows; ++i)
+    this->set_row(i, rows[i]);
+}
+
+bit_matrix bit_matrix::identity(const int &size){
+  bit_matrix result(size, size);
+  for(int i = 0; i < size; ++i)
+    result.row(i)[i / bit_matrix::block_size] = 1ULL << (bit_matrix::block_size - 1 - (i % bit_matrix::block_size));
+  return result;
+}
+
+int bit_matrix::rows_count() const{
+  return this->rows;
+}
+
+int bit_matrix::cols_count() const{
+  return this->cols;
+}
+
+bool bit_matrix::get(const int &row_index, const int &col_index) const{
+  this->check_index(row_index, col_index, "bit_matrix::get: index_out_of_bound");
+  return (bool)((this->row(row_index)[col_index / bit_matrix::block_size] >>
+      (bit_matrix::block_size - 1 - (col_index % bit_matrix::block_size))) & 1);
+}
+
+void bit_matrix::set(const int &row_index, const int &col_index, const bool &value){
+  this->check_index(row_index, col_index, "bit_matrix::set: index_out_of_bound");
+  unsigned long long mask = 1ULL << (bit_matrix::block_size - 1 - (col_index % bit_matrix::block_size));
+  unsigned long long &block = this->row(row_index)[col_index / bit_matrix::block_size];
+  if(value) block |= mask;
+  else block &= ~mask;
+}
+
+my_bitset bit_matrix::get_row(const int &index) const{
+  if((index < 0) || (index >= this->rows))
+    throw std::out_of_range("bit_matrix::get_row: index_out_of_bound");
+
+  my_bitset result(this->cols, 0);
+  if(this->stride != 0)
+    memcpy(result.data(), this->row(index), this->stride * sizeof(unsigned long long));
+  return result;
+}
+
+void bit_matrix::set_row(const int &index, const my_bitset &_my_bitset){
+  if((index < 0) || (index >= this->rows))
+    throw std::out_of_range("bit_matrix::set_row: index_out_of_bound");
+  if(_my_bitset.size() != this->cols)
+    throw std::runtime_error("bit_matrix::set_row: size_mismatch");
+
+  if(this->stride != 0)
+    memcpy(this->row(index), _my_bitset.data(), this->stride * sizeof(unsigned long long));
+}
+
+unsigned long long* bit_matrix::row_data(const int &index){
+  if((index < 0) || (index >= this->rows))
+    throw std::out_of_range("bit_matrix::row_data: index_out_of_bound");
+  return this->row(index);
+}
+
+const unsigned long long* bit_matrix::row_data(const int &index) const{
+  if((index < 0) || (index >= this->rows))
+    throw std::out_of_range("bit_matrix::row_data: index_out_of_bound");
+  return this->row(index);
+}
+
+bool bit_matrix::operator == (const bit_matrix &_bit_matrix) const{
+  if((this->rows != _bit_matrix.rows) || (this->cols != _bit_matrix.cols)) return false;
+  return bitset_kernels::equal_blocks(this->arr.data(), _bit_matrix.arr.data(), (int)this->arr.size());
+}
+
+bool bit_matrix::operator != (const bit_matrix &_bit_matrix) const{
+  return !(this->operator == (_bit_matrix));
+}
+
+bit_matrix bit_matrix::operator ^ (const bit_matrix &_bit_matrix) const{
+  bit_matrix result(*this);
+  result ^= _bit_matrix;
+  return result;
+}
+
+bit_matrix& bit_matrix::operator ^= (const bit_matrix &_bit_matrix){
+  if((this->rows != _bit_matrix.rows) || (this->cols != _bit_matrix.cols))
+    throw std::runtime_error("bit_matrix::operator^=: size_mismatch");
+  bitset_kernels::xor_blocks(this->arr.data(), this->arr.data(), _bit_matrix.arr.data(), (int)this->arr.size());
+  return (*this);
+}
+
+///////////////////////////////////////
+// product
+
+// the rows [first, last) of the product, every thread builds its own tables
+void bit_matrix::multiply_rows(const bit_matrix &_bit_matrix1, const bit_matrix &_bit_matrix2,
+    bit_matrix &result, const int &first, const int &last){
+  const int entries = 1 << bit_matrix::table_bits;
+  int width = result.stride;
+  if((width == 0) || (first >= last)) return;
+  std::vector<unsigned long long> table((size_t)entries * width, 0);
+
+  for(int c = 0; c < _bit_matrix1.cols; c += bit_matrix::table_bits){
+    // table[index] is the sum of the rows c + 7 - t of the right matrix
+    // for the set bits t of index, every entry is one more row added to
+    // an entry built before it
+    for(int index = 1; index < entries; ++index){
+      unsigned long long *entry = table.data() + (size_t)index * width;
+      int t = bit_ops::count_trailing_zeros((unsigned long long)index);
+      int source = c + bit_matrix::table_bits - 1 - t;
+      const unsigned long long *previous = table.data() + (size_t)(index & (index - 1)) * width;
+      if(source < _bit_matrix1.cols)
+        bitset_kernels::xor_blocks(entry, previous, _bit_matrix2.row(source), width);
+      else
+        memcpy(entry, previous, width * sizeof(unsigned long long));
+    }
+
+    int block = c / bit_matrix::block_size;
+    int shift = bit_matrix::block_size - bit_matrix::table_bits - (c % bit_matrix::block_size);
+    for(int i = first; i < last; ++i){
+      int index = (int)((_bit_matrix1.row(i)[block] >> shift) & (entries - 1));
+      if(index != 0)
+        bitset_kernels::xor_blocks(result.row(i), result.row(i), table.data() + (size_t)index * width, width);
+    }
+  }
+}
+
+bit_matrix bit_matrix::multiply(const bit_matrix &_bit_matrix1, const bit_matrix &_bit_matrix2, const int &threads){
+  if(_bit_matrix1.cols != _bit_matrix2.rows)
+    throw std::runtime_error("bit_matrix::multiply: size_mismatch");
+
+  bit_matrix result(_bit_matrix1.rows, _bit_matrix2.cols);
+  int count = worker_threads::count(threads, result.rows / bit_matrix::rows_per_thread);
+  if(count == 1) {
+    bit_matrix::multiply_rows(_bit_matrix1, _bit_matrix2, result, 0, result.rows);
+    return result;
+  }
+
+  std::vector<std::thread> workers;
+  int per_thread = (result.rows + count - 1) / count;
+  for(int t = 1; t < count; ++t){
+    int first = t * per_thread;
+    int last = std::min(result.rows, first + per_thread);
+    workers.push_back(std::thread(bit_matrix::multiply_rows,
+        std::cref(_bit_matrix1), std::cref(_bit_matrix2), std::ref(result), first, last));
+  }
+  bit_matrix::multiply_rows(_bit_matrix1, _bit_matrix2, result, 0, std::min(result.rows, per_thread));
+  for(size_t t = 0; t < workers.size(); ++t)
+    workers[t].join();
+  return result;
+}
+
+bit_matrix bit_matrix::operator * (const bit_matrix &_bit_matrix) const{
+  return bit_matrix::multiply(*this, _bit_matrix, 1);
+}
+
+my_bitset bit_matrix::operator * (const my_bitset &_my_bitset) const{
+  if(_my_bitset.size() != this->cols)
+    throw std::runtime_error("bit_matrix::operator*: size_mismatch");
+
+  my_bitset result(this->rows, 0);
+  for(int i = 0; i < this->rows; ++i)
+    if(bitset_kernels::count_and_blocks(this->row(i), _my_bitset.data(), this->stride) & 1)
+      result.set(i, true);
+  return result;
+}
+
+///////////////////////////////////////
+// transpose
+
+// transposes a 64x64 block held as 64 rows, bit c of row r (from the most
+// significant bit) goes to bit r of row c, by swapping the off diagonal
+// halves of 32x32, 16x16, ..., 1x1 sub blocks
+void bit_matrix::transpose_64(unsigned long long *block){
+  unsigned long long mask = 0x00000000FFFFFFFFULL;
+  for(int j = 32; j != 0; j >>= 1, mask ^= (mask << j)){
+    for(int k = 0; k < 64; k = ((k | j) + 1) & ~j){
+      unsigned long long t = (block[k] ^ (block[k | j] >> j)) & mask;
+      block[k] ^= t;
+      block[k | j] ^= (t << j);
+    }
+  }
+}
+
+bit_matrix bit_matrix::transpose() const{
+  bit_matrix result(this->cols, this->rows);
+  unsigned long long block[bit_matrix::block_size];
+
+  for(int r = 0; r < this->rows; r += bit_matrix::block_size){
+    int height = std::min(bit_matrix::block_size, this->rows - r);
+    for(int b = 0; b < this->stride; ++b){
+      for(int i = 0; i < height; ++i)
+        block[i] = this->row(r + i)[b];
+      for(int i = height; i < bit_matrix::block_size; ++i)
+        block[i] = 0;
+
+      bit_matrix::transpose_64(block);
+
+      int c = b * bit_matrix::block_size;
+      int width = std::min(bit_matrix::block_size, this->cols - c);
+      for(int i = 0; i < width; ++i)
+        result.row(c + i)[r / bit_matrix::block_size] = block[i];
+    }
+  }
+  return result;
+}
+
+///////////////////////////////////////
+// elimination
+
+int bit_matrix::eliminate(){
+  int rank = 0;
+  for(int c = 0; (c < this->cols) && (rank < this->rows); ++c){
+    int block = c / bit_matrix::block_size;
+    unsigned long long mask = 1ULL << (bit_matrix::block_size - 1 - (c % bit_matrix::block_size));
+
+    int pivot = rank;
+    while((pivot < this->rows) && !(this->row(pivot)[block] & mask)) ++pivot;
+    if(pivot == this->rows) continue;
+    if(pivot != rank)
+      std::swap_ranges(this->row(pivot), this->row(pivot) + this->stride, this->row(rank));
+
+    // the columns before c are zero in the pivot row, only the blocks
+    // from the one of c on need to be added
+    const unsigned long long *source = this->row(rank) + block;
+    int width = this->stride - block;
+    for(int i = 0; i < this->rows; ++i){
+      if((i != rank) && (this->row(i)[block] & mask)) {
+        unsigned long long *target = this->row(i) + block;
+        bitset_kernels::xor_blocks(target, target, source, width);
+      }
+    }
+    ++rank;
+  }
+  return rank;
+}
+
+int bit_matrix::rank() const{
+  bit_matrix copy(*this);
+  return copy.eliminate();
+}
+
+bool bit_matrix::solve(const my_bitset &b, my_bitset &x) const{
+  if(b.size() != this->rows)
+    throw std::runtime_error("bit_matrix::solve: size_mismatch");
+
+  // the augmented matrix [A | b], the right hand side is the last column
+  bit_matrix augmented(this->rows, this->cols + 1);
+  for(int i = 0; i < this->rows; ++i){
+    if(this->stride != 0)
+      memcpy(augmented.row(i), this->row(i), this->stride * sizeof(unsigned long long));
+    if(b.get(i)) augmented.set(i, this->cols, true);
+  }
+  int rank = augmented.eliminate();
+
+  // every pivot row sets the variable of its pivot column, a pivot in the
+  // last column is an equation 0 = 1
+  x = my_bitset(this->cols, 0);
+  for(int i = 0; i < rank; ++i){
+    const unsigned long long *pivot_row = augmented.row(i);
+    int block = 0;
+    while(pivot_row[block] == 0) ++block;
+    int pivot = block * bit_matrix::block_size + bit_ops::count_leading_zeros(pivot_row[block]);
+    if(pivot == this->cols) return false;
+    if(augmented.get(i, this->cols)) x.set(pivot, true);
+  }
+  return true;
+}
+
+#endif /* BIT_MATRIX_H_ */
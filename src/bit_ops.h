@@ -0,0 +1,132 @@
+#ifndef BIT_OPS_H_
+#define BIT_OPS_H_
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// portable wrappers around the hardware bit counting instructions
+// (popcnt, lzcnt, tzcnt), with plain c++ fallbacks for other compilers,
+// and big-endian loads and stores of 64 bits words that compile down to
+// a single load or store and a byte swap
+
+class bit_ops {
+public:
+  int static popcount(const unsigned long long &x);
+  // both are undefined for x == 0
+  int static count_leading_zeros(const unsigned long long &x);
+  int static count_trailing_zeros(const unsigned long long &x);
+
+  // the position, counted from the most significant bit, of the set bit
+  // that has k set bits before it, k must be less than popcount(x)
+  int static select(const unsigned long long &x, const int &k);
+
+  // reverses the order of the bits, bit 0 becomes bit 63
+  unsigned long long static reverse(const unsigned long long &x);
+
+  unsigned long long static load_big_endian(const unsigned char *buffer);
+  void static store_big_endian(unsigned char *buffer, const unsigned long long &x);
+};
+
+///////////////////////////////////////
+
+int bit_ops::popcount(const unsigned long long &x){
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  return (int)__popcnt64(x);
+#else
+  unsigned long long v = x - ((x >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+int bit_ops::count_leading_zeros(const unsigned long long &x){
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return 63 - (int)index;
+#else
+  int n = 0;
+  unsigned long long v = x;
+  while(!(v & 0x8000000000000000ULL)) v <<= 1, ++n;
+  return n;
+#endif
+}
+
+int bit_ops::count_trailing_zeros(const unsigned long long &x){
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return (int)index;
+#else
+  int n = 0;
+  unsigned long long v = x;
+  while(!(v & 1)) v >>= 1, ++n;
+  return n;
+#endif
+}
+
+int bit_ops::select(const unsigned long long &x, const int &k){
+#if defined(__BMI2__) && (defined(__x86_64__) || defined(_M_X64))
+  // deposit a single bit at the rank of the wanted bit counted from
+  // the least significant end
+  int from_low = bit_ops::popcount(x) - 1 - k;
+  return 63 - bit_ops::count_trailing_zeros(_pdep_u64(1ULL << from_low, x));
+#else
+  // skip whole bytes, then the bits of the byte holding it
+  int remaining = k;
+  for(int shift = 56; shift >= 0; shift -= 8){
+    unsigned long long byte = (x >> shift) & 0xFF;
+    int c = bit_ops::popcount(byte);
+    if(remaining < c){
+      for(int bit = 7; ; --bit)
+        if(((byte >> bit) & 1) && (remaining-- == 0))
+          return (56 - shift) + (7 - bit);
+    }
+    remaining -= c;
+  }
+  return -1;
+#endif
+}
+
+unsigned long long bit_ops::reverse(const unsigned long long &x){
+#if defined(__clang__)
+  return __builtin_bitreverse64(x);
+#else
+  unsigned long long v = x;
+  v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+  v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+  v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+#if defined(__GNUC__)
+  return __builtin_bswap64(v);
+#else
+  v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+  v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+  return (v >> 32) | (v << 32);
+#endif
+#endif
+}
+
+unsigned long long bit_ops::load_big_endian(const unsigned char *buffer){
+  unsigned long long x = 0;
+  for(int i = 0; i < 8; ++i)
+    x = (x << 8) | buffer[i];
+  return x;
+}
+
+void bit_ops::store_big_endian(unsigned char *buffer, const unsigned long long &x){
+  for(int i = 0; i < 8; ++i)
+    buffer[i] = (unsigned char)(x >> (56 - (i << 3)));
+}
+
+#endif /* BIT_OPS_H_ */
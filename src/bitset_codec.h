@@ -0,0 +1,380 @@
+#ifndef BITSET_CODEC_H_
+#define BITSET_CODEC_H_
+
+#include <cstdlib>
+#include <string>
+#include <stdexcept>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include "bit_ops.h"
+#include "my_bitset.h"
+
+// text forms of a my_bitset, all in the bit order of the bitset (bit 0 is
+// written first):
+//   binary  one '0' or '1' character per bit
+//   hex     one digit per 4 bits, the last digit zero padded, lower case
+//           on output, either case on input
+//   base64  the bytes of the my_bitset byte constructor format (rfc 4648
+//           alphabet, '=' padded on output, padding optional on input)
+// a hex or base64 text holds whole digits or bytes, its bit count is
+// given separately when it is not a multiple of 4 or 8, the extra bits
+// are dropped.
+//
+// the encoders write into a caller buffer of at least the *_length
+// characters (no terminating zero) and go a byte of the bitset at a time
+// through tables, the binary decoder checks and packs 8 characters at a
+// time in a 64 bits word, the others use a table from character to digit.
+// the decoders resize the given bitset, its storage is reused when it is
+// large enough, and throw on a character outside the format. the texts
+// are int sized, a bitset of more than 2^31 - 1 bits is not encoded.
+
+class bitset_codec {
+private:
+  const static int block_size = 64;
+  const static unsigned char invalid = 0xFF;
+
+  struct tables {
+    // the 8 characters of a byte in binary, as a big-endian word
+    unsigned long long binary[256];
+    // the 2 digits of a byte
+    char hex[256][2];
+    // the 2 characters of 12 bits in base64
+    char base64[4096][2];
+    // the value of a character, invalid if it is not a digit of the format
+    unsigned char hex_value[256];
+    unsigned char base64_value[256];
+  };
+
+  const tables static & get_tables();
+  // byte i of the bitset storage, bit 0 is the top bit of byte 0
+  unsigned char static byte(const unsigned long long *arr, const int &index);
+  void static check_size(const char *function, const int &size, const int &digits, const int &digit_bits);
+  // the size of a bitset to encode, throws if it does not fit an int
+  int static encoded_size(const char *function, const my_bitset &_my_bitset);
+
+public:
+  int static binary_length(const int &size);
+  int static hex_length(const int &size);
+  int static base64_length(const int &size);
+
+  void static encode_binary(const my_bitset &_my_bitset, char *buffer);
+  void static encode_hex(const my_bitset &_my_bitset, char *buffer);
+  void static encode_base64(const my_bitset &_my_bitset, char *buffer);
+
+  // size -1 takes all the bits of the text
+  void static decode_binary(const char *text, const int &length, my_bitset &result);
+  void static decode_hex(const char *text, const int &length, my_bitset &result, const int &size = -1);
+  void static decode_base64(const char *text, const int &length, my_bitset &result, const int &size = -1);
+
+  std::string static to_binary(const my_bitset &_my_bitset);
+  std::string static to_hex(const my_bitset &_my_bitset);
+  std::string static to_base64(const my_bitset &_my_bitset);
+
+  my_bitset static from_binary(const std::string &text);
+  my_bitset static from_hex(const std::string &text, const int &size = -1);
+  my_bitset static from_base64(const std::string &text, const int &size = -1);
+
+#if __cplusplus >= 201703L
+  void static decode_binary(std::string_view text, my_bitset &result);
+  void static decode_hex(std::string_view text, my_bitset &result, const int &size = -1);
+  void static decode_base64(std::string_view text, my_bitset &result, const int &size = -1);
+#endif
+};
+
+///////////////////////////////////////
+
+const int bitset_codec::block_size;
+const unsigned char bitset_codec::invalid;
+
+const bitset_codec::tables& bitset_codec::get_tables(){
+  static const tables *result = [](){
+    static tables t;
+    const char *hex_digits = "0123456789abcdef";
+    const char *base64_digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for(int b = 0; b < 256; ++b){
+      unsigned long long chars = 0;
+      for(int k = 0; k < 8; ++k)
+        chars = (chars << 8) | (((b >> (7 - k)) & 1) ? '1' : '0');
+      t.binary[b] = chars;
+      t.hex[b][0] = hex_digits[b >> 4];
+      t.hex[b][1] = hex_digits[b & 15];
+    }
+    for(int v = 0; v < 4096; ++v){
+      t.base64[v][0] = base64_digits[v >> 6];
+      t.base64[v][1] = base64_digits[v & 63];
+    }
+
+    for(int c = 0; c < 256; ++c){
+      t.hex_value[c] = bitset_codec::invalid;
+      t.base64_value[c] = bitset_codec::invalid;
+    }
+    for(int d = 0; d < 16; ++d){
+      t.hex_value[(unsigned char)hex_digits[d]] = (unsigned char)d;
+      t.hex_value[(unsigned char)"0123456789ABCDEF"[d]] = (unsigned char)d;
+    }
+    for(int d = 0; d < 64; ++d)
+      t.base64_value[(unsigned char)base64_digits[d]] = (unsigned char)d;
+    return &t;
+  }();
+  return *result;
+}
+
+unsigned char bitset_codec::byte(const unsigned long long *arr, const int &index){
+  return (unsigned char)(arr[index >> 3] >> (56 - ((index & 7) << 3)));
+}
+
+void bitset_codec::check_size(const char *function, const int &size, const int &digits, const int &digit_bits){
+  if((size < 0) || (size > digits * digit_bits) || (size <= (digits - 1) * digit_bits))
+    throw std::runtime_error(std::string("bitset_codec::") + function + ": invalid_size");
+}
+
+int bitset_codec::encoded_size(const char *function, const my_bitset &_my_bitset){
+  if(_my_bitset.size() > 0x7FFFFFFFLL)
+    throw std::length_error(std::string("bitset_codec::") + function + ": size_too_large");
+  return (int)_my_bitset.size();
+}
+
+int bitset_codec::binary_length(const int &size){
+  return size;
+}
+
+int bitset_codec::hex_length(const int &size){
+  return (size + 3) / 4;
+}
+
+int bitset_codec::base64_length(const int &size){
+  return (((size + 7) / 8 + 2) / 3) * 4;
+}
+
+///////////////////////////////////////
+// encoding
+
+void bitset_codec::encode_binary(const my_bitset &_my_bitset, char *buffer){
+  const tables &t = bitset_codec::get_tables();
+  const unsigned long long *arr = _my_bitset.data();
+  int size = bitset_codec::encoded_size("encode_binary", _my_bitset);
+  int full_bytes = size / 8;
+
+  for(int i = 0; i < full_bytes; ++i)
+    bit_ops::store_big_endian((unsigned char*)(buffer + 8 * i), t.binary[bitset_codec::byte(arr, i)]);
+
+  if(size % 8 != 0) {
+    unsigned long long chars = t.binary[bitset_codec::byte(arr, full_bytes)];
+    for(int k = 0; k < size % 8; ++k)
+      buffer[8 * full_bytes + k] = (char)(chars >> (56 - 8 * k));
+  }
+}
+
+void bitset_codec::encode_hex(const my_bitset &_my_bitset, char *buffer){
+  const tables &t = bitset_codec::get_tables();
+  const unsigned long long *arr = _my_bitset.data();
+  int digits = bitset_codec::hex_length(bitset_codec::encoded_size("encode_hex", _my_bitset));
+
+  for(int i = 0; i < digits / 2; ++i){
+    const char *pair = t.hex[bitset_codec::byte(arr, i)];
+    buffer[2 * i] = pair[0];
+    buffer[2 * i + 1] = pair[1];
+  }
+  if(digits % 2 != 0)
+    buffer[digits - 1] = t.hex[bitset_codec::byte(arr, digits / 2)][0];
+}
+
+void bitset_codec::encode_base64(const my_bitset &_my_bitset, char *buffer){
+  const tables &t = bitset_codec::get_tables();
+  const unsigned long long *arr = _my_bitset.data();
+  int bytes = (int)((bitset_codec::encoded_size("encode_base64", _my_bitset) + 7LL) / 8);
+  int groups = bytes / 3;
+
+  for(int i = 0; i < groups; ++i){
+    unsigned int v = ((unsigned int)bitset_codec::byte(arr, 3 * i) << 16) |
+        ((unsigned int)bitset_codec::byte(arr, 3 * i + 1) << 8) | bitset_codec::byte(arr, 3 * i + 2);
+    const char *high = t.base64[v >> 12];
+    const char *low = t.base64[v & 4095];
+    buffer[4 * i] = high[0];
+    buffer[4 * i + 1] = high[1];
+    buffer[4 * i + 2] = low[0];
+    buffer[4 * i + 3] = low[1];
+  }
+
+  int rest = bytes - 3 * groups;
+  if(rest != 0) {
+    unsigned int v = (unsigned int)bitset_codec::byte(arr, 3 * groups) << 16;
+    if(rest == 2) v |= (unsigned int)bitset_codec::byte(arr, 3 * groups + 1) << 8;
+    char *out = buffer + 4 * groups;
+    out[0] = t.base64[v >> 12][0];
+    out[1] = t.base64[v >> 12][1];
+    out[2] = ((rest == 2) ? t.base64[(v >> 6) & 4095][1] : '=');
+    out[3] = '=';
+  }
+}
+
+std::string bitset_codec::to_binary(const my_bitset &_my_bitset){
+  std::string result(bitset_codec::binary_length(bitset_codec::encoded_size("to_binary", _my_bitset)), 0);
+  if(!result.empty()) bitset_codec::encode_binary(_my_bitset, &result[0]);
+  return result;
+}
+
+std::string bitset_codec::to_hex(const my_bitset &_my_bitset){
+  std::string result(bitset_codec::hex_length(bitset_codec::encoded_size("to_hex", _my_bitset)), 0);
+  if(!result.empty()) bitset_codec::encode_hex(_my_bitset, &result[0]);
+  return result;
+}
+
+std::string bitset_codec::to_base64(const my_bitset &_my_bitset){
+  std::string result(bitset_codec::base64_length(bitset_codec::encoded_size("to_base64", _my_bitset)), 0);
+  if(!result.empty()) bitset_codec::encode_base64(_my_bitset, &result[0]);
+  return result;
+}
+
+///////////////////////////////////////
+// decoding
+
+void bitset_codec::decode_binary(const char *text, const int &length, my_bitset &result){
+  if(length < 0)
+    throw std::runtime_error("bitset_codec::decode_binary: invalid_size");
+
+  result.resize(length, false);
+  unsigned long long *arr = result.data();
+  int full_blocks = length / bitset_codec::block_size;
+
+  for(int b = 0; b < full_blocks; ++b){
+    const unsigned char *chars = (const unsigned char*)text + b * bitset_codec::block_size;
+    unsigned long long value = 0;
+    for(int i = 0; i < 8; ++i){
+      // '0' and '1' differ from 0x30 in the low bit only, the low bits of
+      // the 8 characters are gathered in the top byte by the multiply
+      unsigned long long x = bit_ops::load_big_endian(chars + 8 * i);
+      if((x & 0xFEFEFEFEFEFEFEFEULL) != 0x3030303030303030ULL)
+        throw std::runtime_error("bitset_codec::decode_binary: invalid_character");
+      value = (value << 8) | (((x & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56);
+    }
+    arr[b] = value;
+  }
+
+  if(length % bitset_codec::block_size != 0) {
+    unsigned long long value = 0;
+    for(int i = full_blocks * bitset_codec::block_size; i < length; ++i){
+      if((text[i] != '0') && (text[i] != '1'))
+        throw std::runtime_error("bitset_codec::decode_binary: invalid_character");
+      value = (value << 1) | (unsigned long long)(text[i] - '0');
+    }
+    arr[full_blocks] = value << (bitset_codec::block_size - (length % bitset_codec::block_size));
+  }
+}
+
+void bitset_codec::decode_hex(const char *text, const int &length, my_bitset &result, const int &size){
+  if(length < 0)
+    throw std::runtime_error("bitset_codec::decode_hex: invalid_size");
+  int bits = ((size < 0) ? 4 * length : size);
+  bitset_codec::check_size("decode_hex", bits, length, 4);
+
+  const unsigned char *values = bitset_codec::get_tables().hex_value;
+  const unsigned char *chars = (const unsigned char*)text;
+  result.resize(bits, false);
+  unsigned long long *arr = result.data();
+
+  unsigned long long value = 0;
+  unsigned char bad = 0;
+  for(int i = 0; i < length; ++i){
+    unsigned char d = values[chars[i]];
+    bad |= d;
+    value = (value << 4) | (d & 15);
+    if((i & 15) == 15) arr[i >> 4] = value;
+  }
+  // invalid has its high bit set, no digit has
+  if(bad & 0x80)
+    throw std::runtime_error("bitset_codec::decode_hex: invalid_character");
+  if(length % 16 != 0)
+    arr[length >> 4] = value << (bitset_codec::block_size - 4 * (length % 16));
+
+  if(bits % bitset_codec::block_size != 0)
+    arr[result.blocks_count() - 1] &= ~(~0ULL >> (bits % bitset_codec::block_size));
+}
+
+void bitset_codec::decode_base64(const char *text, const int &length, my_bitset &result, const int &size){
+  if(length < 0)
+    throw std::runtime_error("bitset_codec::decode_base64: invalid_size");
+
+  int used = length;
+  if((used % 4 == 0) && (used > 0) && (text[used - 1] == '=')) --used;
+  if((used % 4 == 3) && (text[used - 1] == '=')) --used;
+  if(used % 4 == 1)
+    throw std::runtime_error("bitset_codec::decode_base64: invalid_size");
+
+  int bytes = (used / 4) * 3 + ((used % 4 == 0) ? 0 : (used % 4) - 1);
+  int bits = ((size < 0) ? 8 * bytes : size);
+  bitset_codec::check_size("decode_base64", bits, bytes, 8);
+
+  const unsigned char *values = bitset_codec::get_tables().base64_value;
+  const unsigned char *chars = (const unsigned char*)text;
+  result.resize(bits, false);
+  unsigned long long *arr = result.data();
+
+  unsigned long long value = 0;
+  int value_bits = 0, block = 0;
+  unsigned char bad = 0;
+  for(int i = 0; i < used; ++i){
+    unsigned char d = values[chars[i]];
+    bad |= d;
+    unsigned long long digit = d & 63;
+    int room = bitset_codec::block_size - value_bits;
+    if(room > 6) {
+      value = (value << 6) | digit;
+      value_bits += 6;
+    }
+    else {
+      // the digit completes a block, its low bits start the next one
+      arr[block++] = (value << room) | (digit >> (6 - room));
+      value_bits = 6 - room;
+      value = digit & ((1ULL << value_bits) - 1);
+    }
+  }
+  if(bad & 0x80)
+    throw std::runtime_error("bitset_codec::decode_base64: invalid_character");
+
+  // the bits of the last character past the last byte are dropped
+  value_bits -= value_bits % 8;
+  value >>= ((used * 6) % 8);
+  if(value_bits != 0)
+    arr[block] = value << (bitset_codec::block_size - value_bits);
+
+  if(bits % bitset_codec::block_size != 0)
+    arr[result.blocks_count() - 1] &= ~(~0ULL >> (bits % bitset_codec::block_size));
+}
+
+my_bitset bitset_codec::from_binary(const std::string &text){
+  my_bitset result;
+  bitset_codec::decode_binary(text.c_str(), (int)text.size(), result);
+  return result;
+}
+
+my_bitset bitset_codec::from_hex(const std::string &text, const int &size){
+  my_bitset result;
+  bitset_codec::decode_hex(text.c_str(), (int)text.size(), result, size);
+  return result;
+}
+
+my_bitset bitset_codec::from_base64(const std::string &text, const int &size){
+  my_bitset result;
+  bitset_codec::decode_base64(text.c_str(), (int)text.size(), result, size);
+  return result;
+}
+
+#if __cplusplus >= 201703L
+void bitset_codec::decode_binary(std::string_view text, my_bitset &result){
+  bitset_codec::decode_binary(text.data(), (int)text.size(), result);
+}
+
+void bitset_codec::decode_hex(std::string_view text, my_bitset &result, const int &size){
+  bitset_codec::decode_hex(text.data(), (int)text.size(), result, size);
+}
+
+void bitset_codec::decode_base64(std::string_view text, my_bitset &result, const int &size){
+  bitset_codec::decode_base64(text.data(), (int)text.size(), result, size);
+}
+#endif
+
+#endif /* BITSET_CODEC_H_ */
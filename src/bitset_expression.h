@@ -0,0 +1,331 @@
+#ifndef BITSET_EXPRESSION_H_
+#define BITSET_EXPRESSION_H_
+
+#include <cstdlib>
+#include <utility>
+
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+
+// lazy boolean expressions over my_bitset. the operators of my_bitset
+// build a full size temporary for every step, an expression like
+// (a & b) | (c & ~d) streams the data through memory four times. here the
+// operands are wrapped with bitset_eval::ref and the operators build a
+// small expression tree (expression templates) that is computed in a
+// single pass over the blocks, block i of the result only reads block i
+// of every operand:
+//
+//   my_bitset r = bitset_eval::evaluate((bitset_eval::ref(a) & bitset_eval::ref(b)) |
+//       (bitset_eval::ref(c) & ~bitset_eval::ref(d)));
+//   long long n = bitset_eval::count(bitset_eval::ref(a) & ~bitset_eval::ref(b));
+//
+// the results are the same as the ones of the eager operators: a binary
+// node has the size of its left operand, a shorter right operand is zero
+// extended, and a complement has the size of its operand.
+//
+// every node gives two accessors for block i, block_fast without any
+// bound or tail handling, valid below safe_blocks(), and block, valid
+// everywhere, the evaluation runs the inlined branch free loop over the
+// common part and finishes the few remaining blocks with the checked one.
+
+template<class derived>
+class bitset_expression;
+class bitset_leaf;
+
+class bitset_eval {
+public:
+  enum binary_op {
+    AND, OR, XOR
+  };
+
+private:
+  int static blocks_for(const long long &bits);
+  unsigned long long static tail_mask(const long long &bits);
+
+  template<class operand>
+  friend class bitset_not;
+  template<int op, class left_operand, class right_operand>
+  friend class bitset_binary;
+
+public:
+  // wraps a my_bitset as an expression operand, the bitset must outlive
+  // the evaluation of the expression
+  bitset_leaf static ref(const my_bitset &_my_bitset);
+
+  template<class expression>
+  my_bitset static evaluate(const bitset_expression<expression> &_expression);
+  // writes the result into an existing bitset, reusing its storage when
+  // the size matches, the bitset may be one of the operands
+  template<class expression>
+  void static evaluate_into(const bitset_expression<expression> &_expression, my_bitset &result);
+  // the number of set bits of the result, without building it
+  template<class expression>
+  long long static count(const bitset_expression<expression> &_expression);
+};
+
+template<class derived>
+class bitset_expression {
+public:
+  const derived& self() const;
+};
+
+class bitset_leaf : public bitset_expression<bitset_leaf> {
+private:
+  const unsigned long long *arr;
+  long long bits;
+  int blocks;
+public:
+  bitset_leaf(const my_bitset &_my_bitset);
+  long long size() const;
+  int safe_blocks() const;
+  unsigned long long block_fast(const int &index) const;
+  unsigned long long block(const int &index) const;
+};
+
+template<class operand>
+class bitset_not : public bitset_expression<bitset_not<operand> > {
+private:
+  operand child;
+  int blocks;
+  unsigned long long tail;
+public:
+  bitset_not(const operand &child);
+  long long size() const;
+  int safe_blocks() const;
+  unsigned long long block_fast(const int &index) const;
+  unsigned long long block(const int &index) const;
+};
+
+template<int op, class left_operand, class right_operand>
+class bitset_binary : public bitset_expression<bitset_binary<op, left_operand, right_operand> > {
+private:
+  left_operand left;
+  right_operand right;
+  int blocks;
+  unsigned long long tail;
+public:
+  bitset_binary(const left_operand &left, const right_operand &right);
+  long long size() const;
+  int safe_blocks() const;
+  unsigned long long block_fast(const int &index) const;
+  unsigned long long block(const int &index) const;
+};
+
+template<class left_operand, class right_operand>
+bitset_binary<bitset_eval::AND, left_operand, right_operand> operator & (
+    const bitset_expression<left_operand> &left, const bitset_expression<right_operand> &right);
+template<class left_operand, class right_operand>
+bitset_binary<bitset_eval::OR, left_operand, right_operand> operator | (
+    const bitset_expression<left_operand> &left, const bitset_expression<right_operand> &right);
+template<class left_operand, class right_operand>
+bitset_binary<bitset_eval::XOR, left_operand, right_operand> operator ^ (
+    const bitset_expression<left_operand> &left, const bitset_expression<right_operand> &right);
+template<class operand>
+bitset_not<operand> operator ~ (const bitset_expression<operand> &child);
+
+///////////////////////////////////////
+
+template<class derived>
+const derived& bitset_expression<derived>::self() const{
+  return *static_cast<const derived*>(this);
+}
+
+///////////////////////////////////////
+// leaf
+
+bitset_leaf::bitset_leaf(const my_bitset &_my_bitset){
+  this->arr = _my_bitset.data();
+  this->bits = _my_bitset.size();
+  this->blocks = _my_bitset.blocks_count();
+}
+
+long long bitset_leaf::size() const{
+  return this->bits;
+}
+
+// the tail of a my_bitset is already clear, all its blocks are exact
+int bitset_leaf::safe_blocks() const{
+  return this->blocks;
+}
+
+unsigned long long bitset_leaf::block_fast(const int &index) const{
+  return this->arr[index];
+}
+
+unsigned long long bitset_leaf::block(const int &index) const{
+  return ((index < this->blocks) ? this->arr[index] : 0);
+}
+
+///////////////////////////////////////
+// complement
+
+template<class operand>
+bitset_not<operand>::bitset_not(const operand &child) : child(child){
+  this->blocks = bitset_eval::blocks_for(child.size());
+  this->tail = bitset_eval::tail_mask(child.size());
+}
+
+template<class operand>
+long long bitset_not<operand>::size() const{
+  return this->child.size();
+}
+
+// the last block needs its tail cleared unless it is full
+template<class operand>
+int bitset_not<operand>::safe_blocks() const{
+  int full = ((this->tail == ~0ULL) ? this->blocks : (this->blocks - 1));
+  int below = this->child.safe_blocks();
+  return ((full < below) ? full : below);
+}
+
+template<class operand>
+unsigned long long bitset_not<operand>::block_fast(const int &index) const{
+  return ~this->child.block_fast(index);
+}
+
+template<class operand>
+unsigned long long bitset_not<operand>::block(const int &index) const{
+  if(index >= this->blocks) return 0;
+  unsigned long long value = ~this->child.block(index);
+  return ((index == this->blocks - 1) ? (value & this->tail) : value);
+}
+
+///////////////////////////////////////
+// binary operators
+
+template<int op, class left_operand, class right_operand>
+bitset_binary<op, left_operand, right_operand>::bitset_binary(const left_operand &left, const right_operand &right) :
+    left(left), right(right){
+  this->blocks = bitset_eval::blocks_for(left.size());
+  this->tail = bitset_eval::tail_mask(left.size());
+}
+
+template<int op, class left_operand, class right_operand>
+long long bitset_binary<op, left_operand, right_operand>::size() const{
+  return this->left.size();
+}
+
+template<int op, class left_operand, class right_operand>
+int bitset_binary<op, left_operand, right_operand>::safe_blocks() const{
+  int result = ((this->tail == ~0ULL) ? this->blocks : (this->blocks - 1));
+  int below = this->left.safe_blocks();
+  if(below < result) result = below;
+  below = this->right.safe_blocks();
+  if(below < result) result = below;
+  return result;
+}
+
+template<int op, class left_operand, class right_operand>
+unsigned long long bitset_binary<op, left_operand, right_operand>::block_fast(const int &index) const{
+  unsigned long long l = this->left.block_fast(index);
+  unsigned long long r = this->right.block_fast(index);
+  return ((op == bitset_eval::AND) ? (l & r) : ((op == bitset_eval::OR) ? (l | r) : (l ^ r)));
+}
+
+template<int op, class left_operand, class right_operand>
+unsigned long long bitset_binary<op, left_operand, right_operand>::block(const int &index) const{
+  if(index >= this->blocks) return 0;
+  unsigned long long l = this->left.block(index);
+  unsigned long long r = this->right.block(index);
+  unsigned long long value = ((op == bitset_eval::AND) ? (l & r) : ((op == bitset_eval::OR) ? (l | r) : (l ^ r)));
+  return ((index == this->blocks - 1) ? (value & this->tail) : value);
+}
+
+template<class left_operand, class right_operand>
+bitset_binary<bitset_eval::AND, left_operand, right_operand> operator & (
+    const bitset_expression<left_operand> &left, const bitset_expression<right_operand> &right){
+  return bitset_binary<bitset_eval::AND, left_operand, right_operand>(left.self(), right.self());
+}
+
+template<class left_operand, class right_operand>
+bitset_binary<bitset_eval::OR, left_operand, right_operand> operator | (
+    const bitset_expression<left_operand> &left, const bitset_expression<right_operand> &right){
+  return bitset_binary<bitset_eval::OR, left_operand, right_operand>(left.self(), right.self());
+}
+
+template<class left_operand, class right_operand>
+bitset_binary<bitset_eval::XOR, left_operand, right_operand> operator ^ (
+    const bitset_expression<left_operand> &left, const bitset_expression<right_operand> &right){
+  return bitset_binary<bitset_eval::XOR, left_operand, right_operand>(left.self(), right.self());
+}
+
+template<class operand>
+bitset_not<operand> operator ~ (const bitset_expression<operand> &child){
+  return bitset_not<operand>(child.self());
+}
+
+///////////////////////////////////////
+// evaluation
+
+int bitset_eval::blocks_for(const long long &bits){
+  return (int)((bits + 63) / 64);
+}
+
+// the used bits of the last block
+unsigned long long bitset_eval::tail_mask(const long long &bits){
+  int used = (int)(bits % 64);
+  return ((used == 0) ? ~0ULL : ~(~0ULL >> used));
+}
+
+bitset_leaf bitset_eval::ref(const my_bitset &_my_bitset){
+  return bitset_leaf(_my_bitset);
+}
+
+template<class expression>
+my_bitset bitset_eval::evaluate(const bitset_expression<expression> &_expression){
+  my_bitset result;
+  bitset_eval::evaluate_into(_expression, result);
+  return result;
+}
+
+template<class expression>
+void bitset_eval::evaluate_into(const bitset_expression<expression> &_expression, my_bitset &result){
+  const expression &e = _expression.self();
+  long long size = e.size();
+
+  // a new storage would invalidate the operand pointers
+  // if the result is one of the operands
+  if(result.size() != size) {
+    my_bitset fresh(size, 0);
+    bitset_eval::evaluate_into(_expression, fresh);
+    result = std::move(fresh);
+    return;
+  }
+
+  unsigned long long *out = result.data();
+  int blocks = bitset_eval::blocks_for(size);
+  int safe = e.safe_blocks();
+  if(safe > blocks) safe = blocks;
+
+  int i = 0;
+  for(; i < safe; ++i)
+    out[i] = e.block_fast(i);
+  for(; i < blocks; ++i)
+    out[i] = e.block(i);
+}
+
+template<class expression>
+long long bitset_eval::count(const bitset_expression<expression> &_expression){
+  const expression &e = _expression.self();
+  int blocks = bitset_eval::blocks_for(e.size());
+  int safe = e.safe_blocks();
+  if(safe > blocks) safe = blocks;
+
+  // the blocks are computed into a small buffer that stays in the l1
+  // cache and counted with the vectorized popcount kernel
+  const int chunk = 64;
+  unsigned long long buffer[chunk];
+  long long result = 0;
+  int i = 0;
+  for(; i + chunk <= safe; i += chunk){
+    for(int j = 0; j < chunk; ++j)
+      buffer[j] = e.block_fast(i + j);
+    result += bitset_kernels::count_blocks(buffer, chunk);
+  }
+  for(; i < blocks; ++i)
+    result += bit_ops::popcount(e.block(i));
+  return result;
+}
+
+#endif /* BITSET_EXPRESSION_H_ */
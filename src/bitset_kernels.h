@@ -0,0 +1,647 @@
+#ifndef BITSET_KERNELS_H_
+#define BITSET_KERNELS_H_
+
+#include <cstdlib>
+#include <atomic>
+
+#include "bit_ops.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BITSET_KERNELS_X86 1
+#include <immintrin.h>
+#define BITSET_KERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BITSET_KERNELS_TARGET(isa)
+#endif
+
+// bulk kernels over arrays of 64 bits blocks, used by my_bitset for its
+// boolean operators, counting and equality. every kernel has an avx-512,
+// an avx2, an sse2 and a portable version, the best one supported by the
+// cpu is selected at runtime the first time any kernel is called, so the
+// same binary runs on every x86 host without -march flags, and on other
+// architectures only the portable versions are compiled.
+// all the kernels accept unaligned arrays, dst may be the same array as
+// one of the sources.
+
+class bitset_kernels {
+public:
+  enum isa {
+    SCALAR, SSE2, AVX2, AVX512
+  };
+
+  void static and_blocks(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, const int &n);
+  void static or_blocks(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, const int &n);
+  void static xor_blocks(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, const int &n);
+  void static not_blocks(unsigned long long *dst, const unsigned long long *a, const int &n);
+  // the number of set bits in a, in (a & b), and in (a ^ b) (the
+  // hamming distance)
+  long long static count_blocks(const unsigned long long *a, const int &n);
+  long long static count_and_blocks(const unsigned long long *a, const unsigned long long *b, const int &n);
+  long long static count_xor_blocks(const unsigned long long *a, const unsigned long long *b, const int &n);
+  // the hamming distances of b to count rows of stride blocks stored one
+  // after the other, out[i] for the row at rows + i * stride, one call for
+  // many short rows instead of one count_xor_blocks per row
+  void static count_xor_rows(int *out, const unsigned long long *rows, const int &stride, const int &count,
+      const unsigned long long *b);
+  bool static equal_blocks(const unsigned long long *a, const unsigned long long *b, const int &n);
+
+  // the best instruction set supported by the cpu, the one in use, and
+  // a way to force a lower one (for testing and benchmarking), set_isa
+  // returns false if the cpu does not support the requested one. it may
+  // run while other threads call the kernels, each call goes through the
+  // table in use when it starts
+  isa static best_isa();
+  isa static get_isa();
+  bool static set_isa(const isa &_isa);
+  const char static * isa_name(const isa &_isa);
+
+private:
+  enum binary_op {
+    AND, OR, XOR
+  };
+
+  struct table {
+    isa level;
+    void (*and_blocks)(unsigned long long*, const unsigned long long*, const unsigned long long*, int);
+    void (*or_blocks)(unsigned long long*, const unsigned long long*, const unsigned long long*, int);
+    void (*xor_blocks)(unsigned long long*, const unsigned long long*, const unsigned long long*, int);
+    void (*not_blocks)(unsigned long long*, const unsigned long long*, int);
+    long long (*count_blocks)(const unsigned long long*, int);
+    long long (*count_and_blocks)(const unsigned long long*, const unsigned long long*, int);
+    long long (*count_xor_blocks)(const unsigned long long*, const unsigned long long*, int);
+    void (*count_xor_rows)(int*, const unsigned long long*, int, int, const unsigned long long*);
+    bool (*equal_blocks)(const unsigned long long*, const unsigned long long*, int);
+  };
+
+  // the kernels of the selected isa, one of the prebuilt tables
+  const table static & active();
+  std::atomic<const table*> static & selected();
+  // one table per isa, built once, the ones above best_isa are never
+  // selected
+  const table static * tables();
+  table static make_table(const isa &_isa);
+
+  template<int op>
+  void static binary_scalar(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n);
+  void static not_scalar(unsigned long long *dst, const unsigned long long *a, int n);
+  long long static count_scalar(const unsigned long long *a, int n);
+  long long static count_and_scalar(const unsigned long long *a, const unsigned long long *b, int n);
+  long long static count_xor_scalar(const unsigned long long *a, const unsigned long long *b, int n);
+  void static count_xor_rows_scalar(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b);
+  bool static equal_scalar(const unsigned long long *a, const unsigned long long *b, int n);
+
+#ifdef BITSET_KERNELS_X86
+  template<int op>
+  BITSET_KERNELS_TARGET("sse2") void static binary_sse2(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("sse2") void static not_sse2(unsigned long long *dst, const unsigned long long *a, int n);
+  BITSET_KERNELS_TARGET("popcnt") long long static count_popcnt(const unsigned long long *a, int n);
+  BITSET_KERNELS_TARGET("popcnt") long long static count_and_popcnt(const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("popcnt") long long static count_xor_popcnt(const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("popcnt") void static count_xor_rows_popcnt(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b);
+  BITSET_KERNELS_TARGET("sse2") bool static equal_sse2(const unsigned long long *a, const unsigned long long *b, int n);
+
+  template<int op>
+  BITSET_KERNELS_TARGET("avx2") void static binary_avx2(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("avx2") void static not_avx2(unsigned long long *dst, const unsigned long long *a, int n);
+  BITSET_KERNELS_TARGET("avx2") long long static count_avx2(const unsigned long long *a, int n);
+  BITSET_KERNELS_TARGET("avx2") long long static count_and_avx2(const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("avx2") long long static count_xor_avx2(const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("avx2,popcnt") void static count_xor_rows_avx2(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b);
+  BITSET_KERNELS_TARGET("avx2") bool static equal_avx2(const unsigned long long *a, const unsigned long long *b, int n);
+
+  template<int op>
+  BITSET_KERNELS_TARGET("avx512f") void static binary_avx512(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("avx512f") void static not_avx512(unsigned long long *dst, const unsigned long long *a, int n);
+  BITSET_KERNELS_TARGET("avx512f,avx512bw") long long static count_avx512(const unsigned long long *a, int n);
+  BITSET_KERNELS_TARGET("avx512f,avx512bw") long long static count_and_avx512(const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("avx512f,avx512bw") long long static count_xor_avx512(const unsigned long long *a, const unsigned long long *b, int n);
+  BITSET_KERNELS_TARGET("avx512f,avx512bw,popcnt") void static count_xor_rows_avx512(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b);
+  BITSET_KERNELS_TARGET("avx512f") bool static equal_avx512(const unsigned long long *a, const unsigned long long *b, int n);
+#endif
+};
+
+///////////////////////////////////////
+// public interface
+
+void bitset_kernels::and_blocks(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, const int &n){
+  bitset_kernels::active().and_blocks(dst, a, b, n);
+}
+
+void bitset_kernels::or_blocks(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, const int &n){
+  bitset_kernels::active().or_blocks(dst, a, b, n);
+}
+
+void bitset_kernels::xor_blocks(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, const int &n){
+  bitset_kernels::active().xor_blocks(dst, a, b, n);
+}
+
+void bitset_kernels::not_blocks(unsigned long long *dst, const unsigned long long *a, const int &n){
+  bitset_kernels::active().not_blocks(dst, a, n);
+}
+
+long long bitset_kernels::count_blocks(const unsigned long long *a, const int &n){
+  return bitset_kernels::active().count_blocks(a, n);
+}
+
+long long bitset_kernels::count_and_blocks(const unsigned long long *a, const unsigned long long *b, const int &n){
+  return bitset_kernels::active().count_and_blocks(a, b, n);
+}
+
+long long bitset_kernels::count_xor_blocks(const unsigned long long *a, const unsigned long long *b, const int &n){
+  return bitset_kernels::active().count_xor_blocks(a, b, n);
+}
+
+void bitset_kernels::count_xor_rows(int *out, const unsigned long long *rows, const int &stride, const int &count,
+    const unsigned long long *b){
+  bitset_kernels::active().count_xor_rows(out, rows, stride, count, b);
+}
+
+bool bitset_kernels::equal_blocks(const unsigned long long *a, const unsigned long long *b, const int &n){
+  return bitset_kernels::active().equal_blocks(a, b, n);
+}
+
+bitset_kernels::isa bitset_kernels::best_isa(){
+#ifdef BITSET_KERNELS_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return bitset_kernels::AVX512;
+  if(__builtin_cpu_supports("avx2"))
+    return bitset_kernels::AVX2;
+  if(__builtin_cpu_supports("sse2"))
+    return bitset_kernels::SSE2;
+#endif
+  return bitset_kernels::SCALAR;
+}
+
+bitset_kernels::isa bitset_kernels::get_isa(){
+  return bitset_kernels::active().level;
+}
+
+bool bitset_kernels::set_isa(const isa &_isa){
+  if(_isa > bitset_kernels::best_isa())
+    return false;
+  bitset_kernels::selected().store(bitset_kernels::tables() + _isa, std::memory_order_release);
+  return true;
+}
+
+const char* bitset_kernels::isa_name(const isa &_isa){
+  switch(_isa){
+  case bitset_kernels::AVX512: return "avx512";
+  case bitset_kernels::AVX2: return "avx2";
+  case bitset_kernels::SSE2: return "sse2";
+  default: return "scalar";
+  }
+}
+
+///////////////////////////////////////
+// dispatch
+
+// the tables are built and the isa is detected once, on first use,
+// function local statics are initialized in a thread safe way since c++11,
+// set_isa then only swaps a pointer, no table is ever written while in use
+const bitset_kernels::table& bitset_kernels::active(){
+  return *bitset_kernels::selected().load(std::memory_order_acquire);
+}
+
+std::atomic<const bitset_kernels::table*>& bitset_kernels::selected(){
+  static std::atomic<const table*> instance(bitset_kernels::tables() + bitset_kernels::best_isa());
+  return instance;
+}
+
+const bitset_kernels::table* bitset_kernels::tables(){
+  static const table instances[4] = {
+    bitset_kernels::make_table(bitset_kernels::SCALAR),
+    bitset_kernels::make_table(bitset_kernels::SSE2),
+    bitset_kernels::make_table(bitset_kernels::AVX2),
+    bitset_kernels::make_table(bitset_kernels::AVX512)
+  };
+  return instances;
+}
+
+bitset_kernels::table bitset_kernels::make_table(const isa &_isa){
+  table t;
+  t.level = bitset_kernels::SCALAR;
+  t.and_blocks = &bitset_kernels::binary_scalar<AND>;
+  t.or_blocks = &bitset_kernels::binary_scalar<OR>;
+  t.xor_blocks = &bitset_kernels::binary_scalar<XOR>;
+  t.not_blocks = &bitset_kernels::not_scalar;
+  t.count_blocks = &bitset_kernels::count_scalar;
+  t.count_and_blocks = &bitset_kernels::count_and_scalar;
+  t.count_xor_blocks = &bitset_kernels::count_xor_scalar;
+  t.count_xor_rows = &bitset_kernels::count_xor_rows_scalar;
+  t.equal_blocks = &bitset_kernels::equal_scalar;
+
+#ifdef BITSET_KERNELS_X86
+  if(_isa >= bitset_kernels::SSE2) {
+    t.level = bitset_kernels::SSE2;
+    t.and_blocks = &bitset_kernels::binary_sse2<AND>;
+    t.or_blocks = &bitset_kernels::binary_sse2<OR>;
+    t.xor_blocks = &bitset_kernels::binary_sse2<XOR>;
+    t.not_blocks = &bitset_kernels::not_sse2;
+    t.equal_blocks = &bitset_kernels::equal_sse2;
+    // sse2 has no byte shuffle, the hardware popcnt is the fastest
+    // counter available there when the cpu has it
+    if(__builtin_cpu_supports("popcnt")) {
+      t.count_blocks = &bitset_kernels::count_popcnt;
+      t.count_and_blocks = &bitset_kernels::count_and_popcnt;
+      t.count_xor_blocks = &bitset_kernels::count_xor_popcnt;
+      t.count_xor_rows = &bitset_kernels::count_xor_rows_popcnt;
+    }
+  }
+
+  if(_isa >= bitset_kernels::AVX2) {
+    t.level = bitset_kernels::AVX2;
+    t.and_blocks = &bitset_kernels::binary_avx2<AND>;
+    t.or_blocks = &bitset_kernels::binary_avx2<OR>;
+    t.xor_blocks = &bitset_kernels::binary_avx2<XOR>;
+    t.not_blocks = &bitset_kernels::not_avx2;
+    t.count_blocks = &bitset_kernels::count_avx2;
+    t.count_and_blocks = &bitset_kernels::count_and_avx2;
+    t.count_xor_blocks = &bitset_kernels::count_xor_avx2;
+    t.count_xor_rows = &bitset_kernels::count_xor_rows_avx2;
+    t.equal_blocks = &bitset_kernels::equal_avx2;
+  }
+
+  if(_isa >= bitset_kernels::AVX512) {
+    t.level = bitset_kernels::AVX512;
+    t.and_blocks = &bitset_kernels::binary_avx512<AND>;
+    t.or_blocks = &bitset_kernels::binary_avx512<OR>;
+    t.xor_blocks = &bitset_kernels::binary_avx512<XOR>;
+    t.not_blocks = &bitset_kernels::not_avx512;
+    t.count_blocks = &bitset_kernels::count_avx512;
+    t.count_and_blocks = &bitset_kernels::count_and_avx512;
+    t.count_xor_blocks = &bitset_kernels::count_xor_avx512;
+    t.count_xor_rows = &bitset_kernels::count_xor_rows_avx512;
+    t.equal_blocks = &bitset_kernels::equal_avx512;
+  }
+#endif
+
+  return t;
+}
+
+///////////////////////////////////////
+// portable kernels
+
+template<int op>
+void bitset_kernels::binary_scalar(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n){
+  for(int i = 0; i < n; ++i)
+    dst[i] = ((op == AND) ? (a[i] & b[i]) : ((op == OR) ? (a[i] | b[i]) : (a[i] ^ b[i])));
+}
+
+void bitset_kernels::not_scalar(unsigned long long *dst, const unsigned long long *a, int n){
+  for(int i = 0; i < n; ++i)
+    dst[i] = ~a[i];
+}
+
+long long bitset_kernels::count_scalar(const unsigned long long *a, int n){
+  long long result = 0;
+  for(int i = 0; i < n; ++i)
+    result += bit_ops::popcount(a[i]);
+  return result;
+}
+
+long long bitset_kernels::count_and_scalar(const unsigned long long *a, const unsigned long long *b, int n){
+  long long result = 0;
+  for(int i = 0; i < n; ++i)
+    result += bit_ops::popcount(a[i] & b[i]);
+  return result;
+}
+
+long long bitset_kernels::count_xor_scalar(const unsigned long long *a, const unsigned long long *b, int n){
+  long long result = 0;
+  for(int i = 0; i < n; ++i)
+    result += bit_ops::popcount(a[i] ^ b[i]);
+  return result;
+}
+
+void bitset_kernels::count_xor_rows_scalar(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b){
+  for(int i = 0; i < count; ++i, rows += stride)
+    out[i] = (int)bitset_kernels::count_xor_scalar(rows, b, stride);
+}
+
+bool bitset_kernels::equal_scalar(const unsigned long long *a, const unsigned long long *b, int n){
+  for(int i = 0; i < n; ++i)
+    if(a[i] != b[i]) return false;
+  return true;
+}
+
+#ifdef BITSET_KERNELS_X86
+
+///////////////////////////////////////
+// sse2 kernels, 2 blocks per step
+
+template<int op>
+BITSET_KERNELS_TARGET("sse2")
+void bitset_kernels::binary_sse2(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n){
+  int i = 0;
+  for(; i + 2 <= n; i += 2){
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i r = ((op == AND) ? _mm_and_si128(x, y) : ((op == OR) ? _mm_or_si128(x, y) : _mm_xor_si128(x, y)));
+    _mm_storeu_si128((__m128i*)(dst + i), r);
+  }
+  bitset_kernels::binary_scalar<op>(dst + i, a + i, b + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("sse2")
+void bitset_kernels::not_sse2(unsigned long long *dst, const unsigned long long *a, int n){
+  const __m128i ones = _mm_set1_epi32(-1);
+  int i = 0;
+  for(; i + 2 <= n; i += 2)
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i)), ones));
+  bitset_kernels::not_scalar(dst + i, a + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("popcnt")
+long long bitset_kernels::count_popcnt(const unsigned long long *a, int n){
+  long long result = 0;
+  for(int i = 0; i < n; ++i)
+    result += __builtin_popcountll(a[i]);
+  return result;
+}
+
+BITSET_KERNELS_TARGET("popcnt")
+long long bitset_kernels::count_and_popcnt(const unsigned long long *a, const unsigned long long *b, int n){
+  long long result = 0;
+  for(int i = 0; i < n; ++i)
+    result += __builtin_popcountll(a[i] & b[i]);
+  return result;
+}
+
+BITSET_KERNELS_TARGET("popcnt")
+long long bitset_kernels::count_xor_popcnt(const unsigned long long *a, const unsigned long long *b, int n){
+  long long result = 0;
+  for(int i = 0; i < n; ++i)
+    result += __builtin_popcountll(a[i] ^ b[i]);
+  return result;
+}
+
+BITSET_KERNELS_TARGET("popcnt")
+void bitset_kernels::count_xor_rows_popcnt(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b){
+  for(int i = 0; i < count; ++i, rows += stride){
+    long long result = 0;
+    for(int j = 0; j < stride; ++j)
+      result += __builtin_popcountll(rows[j] ^ b[j]);
+    out[i] = (int)result;
+  }
+}
+
+BITSET_KERNELS_TARGET("sse2")
+bool bitset_kernels::equal_sse2(const unsigned long long *a, const unsigned long long *b, int n){
+  int i = 0;
+  for(; i + 2 <= n; i += 2){
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+    if(_mm_movemask_epi8(eq) != 0xFFFF) return false;
+  }
+  return bitset_kernels::equal_scalar(a + i, b + i, n - i);
+}
+
+///////////////////////////////////////
+// avx2 kernels, 4 blocks per step, the counters use the nibble lookup
+// popcount (pshufb) with the byte sums accumulated by psadbw
+
+template<int op>
+BITSET_KERNELS_TARGET("avx2")
+void bitset_kernels::binary_avx2(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n){
+  int i = 0;
+  for(; i + 4 <= n; i += 4){
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+    __m256i r = ((op == AND) ? _mm256_and_si256(x, y) : ((op == OR) ? _mm256_or_si256(x, y) : _mm256_xor_si256(x, y)));
+    _mm256_storeu_si256((__m256i*)(dst + i), r);
+  }
+  bitset_kernels::binary_scalar<op>(dst + i, a + i, b + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx2")
+void bitset_kernels::not_avx2(unsigned long long *dst, const unsigned long long *a, int n){
+  const __m256i ones = _mm256_set1_epi32(-1);
+  int i = 0;
+  for(; i + 4 <= n; i += 4)
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)), ones));
+  bitset_kernels::not_scalar(dst + i, a + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx2")
+long long bitset_kernels::count_avx2(const unsigned long long *a, int n){
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0F);
+  __m256i sums = _mm256_setzero_si256();
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i low = _mm256_and_si256(v, low_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    sums = _mm256_add_epi64(sums, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+
+  long long result = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+      _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+  return result + bitset_kernels::count_scalar(a + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx2")
+long long bitset_kernels::count_and_avx2(const unsigned long long *a, const unsigned long long *b, int n){
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0F);
+  __m256i sums = _mm256_setzero_si256();
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4){
+    __m256i v = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i*)(a + i)),
+        _mm256_loadu_si256((const __m256i*)(b + i)));
+    __m256i low = _mm256_and_si256(v, low_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    sums = _mm256_add_epi64(sums, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+
+  long long result = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+      _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+  return result + bitset_kernels::count_and_scalar(a + i, b + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx2")
+long long bitset_kernels::count_xor_avx2(const unsigned long long *a, const unsigned long long *b, int n){
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0F);
+  __m256i sums = _mm256_setzero_si256();
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4){
+    __m256i v = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i*)(a + i)),
+        _mm256_loadu_si256((const __m256i*)(b + i)));
+    __m256i low = _mm256_and_si256(v, low_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low), _mm256_shuffle_epi8(lookup, high));
+    sums = _mm256_add_epi64(sums, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+  }
+
+  long long result = _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+      _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+  return result + bitset_kernels::count_xor_scalar(a + i, b + i, n - i);
+}
+
+// the lookup popcount only pays off on long rows, every avx2 cpu has
+// the hardware popcnt for the short ones
+BITSET_KERNELS_TARGET("avx2,popcnt")
+void bitset_kernels::count_xor_rows_avx2(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b){
+  if(stride < 8) {
+    bitset_kernels::count_xor_rows_popcnt(out, rows, stride, count, b);
+    return;
+  }
+  for(int i = 0; i < count; ++i, rows += stride)
+    out[i] = (int)bitset_kernels::count_xor_avx2(rows, b, stride);
+}
+
+BITSET_KERNELS_TARGET("avx2")
+bool bitset_kernels::equal_avx2(const unsigned long long *a, const unsigned long long *b, int n){
+  int i = 0;
+  for(; i + 4 <= n; i += 4){
+    __m256i diff = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i*)(a + i)),
+        _mm256_loadu_si256((const __m256i*)(b + i)));
+    if(!_mm256_testz_si256(diff, diff)) return false;
+  }
+  return bitset_kernels::equal_scalar(a + i, b + i, n - i);
+}
+
+///////////////////////////////////////
+// avx-512 kernels, 8 blocks per step
+
+template<int op>
+BITSET_KERNELS_TARGET("avx512f")
+void bitset_kernels::binary_avx512(unsigned long long *dst, const unsigned long long *a, const unsigned long long *b, int n){
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m512i x = _mm512_loadu_si512((const void*)(a + i));
+    __m512i y = _mm512_loadu_si512((const void*)(b + i));
+    __m512i r = ((op == AND) ? _mm512_and_si512(x, y) : ((op == OR) ? _mm512_or_si512(x, y) : _mm512_xor_si512(x, y)));
+    _mm512_storeu_si512((void*)(dst + i), r);
+  }
+  bitset_kernels::binary_scalar<op>(dst + i, a + i, b + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx512f")
+void bitset_kernels::not_avx512(unsigned long long *dst, const unsigned long long *a, int n){
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m512i x = _mm512_loadu_si512((const void*)(a + i));
+    _mm512_storeu_si512((void*)(dst + i), _mm512_ternarylogic_epi64(x, x, x, 0x55));
+  }
+  bitset_kernels::not_scalar(dst + i, a + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx512f,avx512bw")
+long long bitset_kernels::count_avx512(const unsigned long long *a, int n){
+  // the 16 bytes nibble table (0 1 1 2 1 2 2 3 1 2 2 3 2 3 3 4) in every lane
+  const __m512i lookup = _mm512_set_epi64(
+      0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL,
+      0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL);
+  const __m512i low_mask = _mm512_set1_epi8(0x0F);
+  __m512i sums = _mm512_setzero_si512();
+
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m512i v = _mm512_loadu_si512((const void*)(a + i));
+    __m512i low = _mm512_and_si512(v, low_mask);
+    __m512i high = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+    __m512i bytes = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, low), _mm512_shuffle_epi8(lookup, high));
+    sums = _mm512_add_epi64(sums, _mm512_sad_epu8(bytes, _mm512_setzero_si512()));
+  }
+
+  unsigned long long lanes[8];
+  _mm512_storeu_si512((void*)lanes, sums);
+  long long result = 0;
+  for(int j = 0; j < 8; ++j) result += lanes[j];
+  return result + bitset_kernels::count_scalar(a + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx512f,avx512bw")
+long long bitset_kernels::count_and_avx512(const unsigned long long *a, const unsigned long long *b, int n){
+  // the 16 bytes nibble table (0 1 1 2 1 2 2 3 1 2 2 3 2 3 3 4) in every lane
+  const __m512i lookup = _mm512_set_epi64(
+      0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL,
+      0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL);
+  const __m512i low_mask = _mm512_set1_epi8(0x0F);
+  __m512i sums = _mm512_setzero_si512();
+
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m512i v = _mm512_and_si512(
+        _mm512_loadu_si512((const void*)(a + i)),
+        _mm512_loadu_si512((const void*)(b + i)));
+    __m512i low = _mm512_and_si512(v, low_mask);
+    __m512i high = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+    __m512i bytes = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, low), _mm512_shuffle_epi8(lookup, high));
+    sums = _mm512_add_epi64(sums, _mm512_sad_epu8(bytes, _mm512_setzero_si512()));
+  }
+
+  unsigned long long lanes[8];
+  _mm512_storeu_si512((void*)lanes, sums);
+  long long result = 0;
+  for(int j = 0; j < 8; ++j) result += lanes[j];
+  return result + bitset_kernels::count_and_scalar(a + i, b + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx512f,avx512bw")
+long long bitset_kernels::count_xor_avx512(const unsigned long long *a, const unsigned long long *b, int n){
+  // the 16 bytes nibble table (0 1 1 2 1 2 2 3 1 2 2 3 2 3 3 4) in every lane
+  const __m512i lookup = _mm512_set_epi64(
+      0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL,
+      0x0403030203020201LL, 0x0302020102010100LL, 0x0403030203020201LL, 0x0302020102010100LL);
+  const __m512i low_mask = _mm512_set1_epi8(0x0F);
+  __m512i sums = _mm512_setzero_si512();
+
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m512i v = _mm512_xor_si512(
+        _mm512_loadu_si512((const void*)(a + i)),
+        _mm512_loadu_si512((const void*)(b + i)));
+    __m512i low = _mm512_and_si512(v, low_mask);
+    __m512i high = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+    __m512i bytes = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, low), _mm512_shuffle_epi8(lookup, high));
+    sums = _mm512_add_epi64(sums, _mm512_sad_epu8(bytes, _mm512_setzero_si512()));
+  }
+
+  unsigned long long lanes[8];
+  _mm512_storeu_si512((void*)lanes, sums);
+  long long result = 0;
+  for(int j = 0; j < 8; ++j) result += lanes[j];
+  return result + bitset_kernels::count_xor_scalar(a + i, b + i, n - i);
+}
+
+BITSET_KERNELS_TARGET("avx512f,avx512bw,popcnt")
+void bitset_kernels::count_xor_rows_avx512(int *out, const unsigned long long *rows, int stride, int count, const unsigned long long *b){
+  if(stride < 8) {
+    bitset_kernels::count_xor_rows_popcnt(out, rows, stride, count, b);
+    return;
+  }
+  for(int i = 0; i < count; ++i, rows += stride)
+    out[i] = (int)bitset_kernels::count_xor_avx512(rows, b, stride);
+}
+
+BITSET_KERNELS_TARGET("avx512f")
+bool bitset_kernels::equal_avx512(const unsigned long long *a, const unsigned long long *b, int n){
+  int i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m512i x = _mm512_loadu_si512((const void*)(a + i));
+    __m512i y = _mm512_loadu_si512((const void*)(b + i));
+    if(_mm512_cmpneq_epi64_mask(x, y) != 0) return false;
+  }
+  return bitset_kernels::equal_scalar(a + i, b + i, n - i);
+}
+
+#endif /* BITSET_KERNELS_X86 */
+
+#endif /* BITSET_KERNELS_H_ */
@@ -0,0 +1,460 @@
+#ifndef BITSET_VIEW_H_
+#define BITSET_VIEW_H_
+
+#include <cstdlib>
+#include <stdexcept>
+
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+
+// non owning views over bits that live in someone else's memory, with the
+// same bit order as my_bitset (bit 0 is the most significant bit). two
+// memory layouts are understood:
+//   BYTES   a byte buffer in the my_bitset byte constructor format (network
+//           order, bit 0 is the top bit of byte 0), any alignment
+//   BLOCKS  native 64 bits blocks, the my_bitset and file storage format
+// nothing is copied, a block of a BYTES view is a big-endian 8 bytes load.
+// the bits past the size in the last byte or block of the memory are
+// ignored on reads and left untouched on writes.
+//
+// the combine functions write into a mutable_bitset_view, which can wrap
+// caller storage of either layout (or a my_bitset), the result must have
+// the size of the left operand, the right one is zero extended as with the
+// my_bitset operators. the result may be one of the operands. when all the
+// views are BLOCKS views the whole blocks go through the simd kernels.
+//
+// the viewed memory must outlive the view.
+
+class mutable_bitset_view;
+
+class bitset_view {
+public:
+  enum layout {
+    BYTES, BLOCKS
+  };
+
+protected:
+  const static int block_size = 64;
+  const unsigned char *bytes;
+  const unsigned long long *arr;
+  int bits;
+  int blocks;
+  bitset_view::layout kind;
+  // the used bits of the last block
+  unsigned long long tail;
+
+  bitset_view();
+  void init(const int &bits, const bitset_view::layout &kind);
+  // the bits of a buffer of buffer_size bytes, throws when they do not
+  // fit an int index
+  int static buffer_bits(const int &buffer_size, const char *where);
+  // whole blocks that need no tail masking
+  int full_blocks() const;
+  unsigned long long load_block(const int &index) const;
+
+  template<int op>
+  void static combine(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2,
+      mutable_bitset_view &result, const char *where);
+
+public:
+  bitset_view(const my_bitset &_my_bitset);
+  // buffer_size in bytes, the size is buffer_size * 8 bits, at most
+  // 0x7FFFFFFF / 8 bytes
+  bitset_view static from_bytes(const unsigned char *buffer, const int &buffer_size);
+  bitset_view static from_bytes(const char *buffer, const int &buffer_size);
+  // size in bits, the blocks are (size + 63) / 64
+  bitset_view static from_blocks(const unsigned long long *blocks, const int &size);
+
+  int size() const;
+  bitset_view::layout get_layout() const;
+  bool get(const int &index) const;
+  // block access in the my_bitset block format, zero past the end
+  int blocks_count() const;
+  unsigned long long get_block(const int &index) const;
+
+  int count() const;
+  int count_and(const bitset_view &_bitset_view) const;
+  bool any() const;
+  bool none() const;
+  int find_first() const;
+  // the first set bit at or after the given index, -1 if there is none
+  int find_next_set(const int &from) const;
+  template<typename function>
+  void for_each_set_bit(function f) const;
+
+  // same size and same bits
+  bool operator == (const bitset_view &_bitset_view) const;
+  bool operator != (const bitset_view &_bitset_view) const;
+
+  // the only copying function, an owning copy of the bits
+  my_bitset to_my_bitset() const;
+
+  void static and_into(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2, mutable_bitset_view &result);
+  void static or_into(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2, mutable_bitset_view &result);
+  void static xor_into(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2, mutable_bitset_view &result);
+  void static not_into(const bitset_view &_bitset_view, mutable_bitset_view &result);
+  void static copy_into(const bitset_view &_bitset_view, mutable_bitset_view &result);
+};
+
+class mutable_bitset_view : public bitset_view {
+private:
+  unsigned char *mutable_bytes;
+  unsigned long long *mutable_arr;
+
+  mutable_bitset_view();
+  void store_block(const int &index, const unsigned long long &value);
+
+  friend class bitset_view;
+
+public:
+  mutable_bitset_view(my_bitset &_my_bitset);
+  mutable_bitset_view static from_bytes(unsigned char *buffer, const int &buffer_size);
+  mutable_bitset_view static from_bytes(char *buffer, const int &buffer_size);
+  mutable_bitset_view static from_blocks(unsigned long long *blocks, const int &size);
+
+  void set(const int &index, const bool &value);
+  void set_block(const int &index, const unsigned long long &value);
+  void clear();
+};
+
+///////////////////////////////////////
+
+const int bitset_view::block_size;
+
+bitset_view::bitset_view(){
+  this->bytes = NULL;
+  this->arr = NULL;
+  this->init(0, bitset_view::BLOCKS);
+}
+
+void bitset_view::init(const int &bits, const bitset_view::layout &kind){
+  if(bits < 0)
+    throw std::runtime_error("bitset_view::bitset_view: invalid_size");
+  this->bits = bits;
+  this->blocks = (int)(((long long)bits + bitset_view::block_size - 1) / bitset_view::block_size);
+  this->kind = kind;
+  int used = bits % bitset_view::block_size;
+  this->tail = ((used == 0) ? ~0ULL : ~(~0ULL >> used));
+}
+
+int bitset_view::buffer_bits(const int &buffer_size, const char *where){
+  if((buffer_size < 0) || (buffer_size > 0x7FFFFFFF / 8))
+    throw std::length_error(where);
+  return buffer_size * 8;
+}
+
+int bitset_view::full_blocks() const{
+  return ((this->tail == ~0ULL) ? this->blocks : (this->blocks - 1));
+}
+
+// the raw block, not masked, index must be in range
+unsigned long long bitset_view::load_block(const int &index) const{
+  if(this->kind == bitset_view::BLOCKS)
+    return this->arr[index];
+
+  int first = index * 8;
+  int bytes_count = (this->bits + 7) / 8;
+  if(first + 8 <= bytes_count)
+    return bit_ops::load_big_endian(this->bytes + first);
+
+  unsigned long long value = 0;
+  for(int i = 0; i < 8; ++i)
+    value = (value << 8) | ((first + i < bytes_count) ? this->bytes[first + i] : 0);
+  return value;
+}
+
+bitset_view::bitset_view(const my_bitset &_my_bitset){
+  // the views are int indexed, unlike my_bitset
+  if(_my_bitset.size() > 0x7FFFFFFFLL)
+    throw std::length_error("bitset_view::bitset_view: size_too_large");
+  this->bytes = NULL;
+  this->arr = _my_bitset.data();
+  this->init(_my_bitset.size(), bitset_view::BLOCKS);
+}
+
+bitset_view bitset_view::from_bytes(const unsigned char *buffer, const int &buffer_size){
+  bitset_view result;
+  result.bytes = buffer;
+  result.init(bitset_view::buffer_bits(buffer_size, "bitset_view::from_bytes: size_too_large"), bitset_view::BYTES);
+  return result;
+}
+
+bitset_view bitset_view::from_bytes(const char *buffer, const int &buffer_size){
+  return bitset_view::from_bytes((const unsigned char*)buffer, buffer_size);
+}
+
+bitset_view bitset_view::from_blocks(const unsigned long long *blocks, const int &size){
+  bitset_view result;
+  result.arr = blocks;
+  result.init(size, bitset_view::BLOCKS);
+  return result;
+}
+
+int bitset_view::size() const{
+  return this->bits;
+}
+
+bitset_view::layout bitset_view::get_layout() const{
+  return this->kind;
+}
+
+bool bitset_view::get(const int &index) const{
+  if((index < 0) || (index >= this->bits))
+    throw std::out_of_range("bitset_view::get: index_out_of_bound");
+
+  if(this->kind == bitset_view::BYTES)
+    return (bool)((this->bytes[index / 8] >> (7 - (index % 8))) & 1);
+  return (bool)((this->arr[index / bitset_view::block_size] >>
+      (bitset_view::block_size - (index % bitset_view::block_size) - 1)) & 1);
+}
+
+int bitset_view::blocks_count() const{
+  return this->blocks;
+}
+
+unsigned long long bitset_view::get_block(const int &index) const{
+  if((index < 0) || (index >= this->blocks)) return 0;
+  unsigned long long value = this->load_block(index);
+  return ((index == this->blocks - 1) ? (value & this->tail) : value);
+}
+
+int bitset_view::count() const{
+  long long result = 0;
+  int full = this->full_blocks();
+  if(this->kind == bitset_view::BLOCKS) {
+    result = bitset_kernels::count_blocks(this->arr, full);
+  }
+  else {
+    for(int i = 0; i < full; ++i)
+      result += bit_ops::popcount(this->load_block(i));
+  }
+  if(full < this->blocks)
+    result += bit_ops::popcount(this->get_block(this->blocks - 1));
+  return (int)result;
+}
+
+int bitset_view::count_and(const bitset_view &_bitset_view) const{
+  int common = ((this->blocks <= _bitset_view.blocks) ? this->blocks : _bitset_view.blocks);
+  int fast = ((this->full_blocks() <= _bitset_view.full_blocks()) ?
+      this->full_blocks() : _bitset_view.full_blocks());
+  long long result = 0;
+  int i = 0;
+  if((this->kind == bitset_view::BLOCKS) && (_bitset_view.kind == bitset_view::BLOCKS)) {
+    result = bitset_kernels::count_and_blocks(this->arr, _bitset_view.arr, fast);
+    i = fast;
+  }
+  for(; i < common; ++i)
+    result += bit_ops::popcount(this->get_block(i) & _bitset_view.get_block(i));
+  return (int)result;
+}
+
+bool bitset_view::any() const{
+  for(int i = 0; i < this->blocks; ++i)
+    if(this->get_block(i) != 0) return true;
+  return false;
+}
+
+bool bitset_view::none() const{
+  return !(this->any());
+}
+
+int bitset_view::find_first() const{
+  return this->find_next_set(0);
+}
+
+int bitset_view::find_next_set(const int &from) const{
+  int start = ((from < 0) ? 0 : from);
+  if(start >= this->bits) return -1;
+
+  int block_index = start / bitset_view::block_size;
+  unsigned long long block = this->get_block(block_index) & (~0ULL >> (start % bitset_view::block_size));
+  while(true){
+    if(block != 0)
+      return (block_index * bitset_view::block_size) + bit_ops::count_leading_zeros(block);
+    if(++block_index >= this->blocks)
+      return -1;
+    block = this->get_block(block_index);
+  }
+}
+
+template<typename function>
+void bitset_view::for_each_set_bit(function f) const{
+  for(int i = 0; i < this->blocks; ++i){
+    unsigned long long block = this->get_block(i);
+    int base = i * bitset_view::block_size;
+    while(block != 0){
+      int bit = bit_ops::count_leading_zeros(block);
+      f(base + bit);
+      block ^= (1ULL << (bitset_view::block_size - 1 - bit));
+    }
+  }
+}
+
+bool bitset_view::operator == (const bitset_view &_bitset_view) const{
+  if(this->bits != _bitset_view.bits) return false;
+  int i = 0;
+  if((this->kind == bitset_view::BLOCKS) && (_bitset_view.kind == bitset_view::BLOCKS)) {
+    if(!bitset_kernels::equal_blocks(this->arr, _bitset_view.arr, this->full_blocks())) return false;
+    i = this->full_blocks();
+  }
+  for(; i < this->blocks; ++i)
+    if(this->get_block(i) != _bitset_view.get_block(i)) return false;
+  return true;
+}
+
+bool bitset_view::operator != (const bitset_view &_bitset_view) const{
+  return !(this->operator == (_bitset_view));
+}
+
+my_bitset bitset_view::to_my_bitset() const{
+  my_bitset result(this->bits, 0);
+  unsigned long long *out = result.data();
+  for(int i = 0; i < this->blocks; ++i)
+    out[i] = this->get_block(i);
+  return result;
+}
+
+///////////////////////////////////////
+// combine
+
+template<int op>
+void bitset_view::combine(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2,
+    mutable_bitset_view &result, const char *where){
+  if(result.bits != _bitset_view1.bits)
+    throw std::runtime_error(where);
+
+  int i = 0;
+  if((_bitset_view1.kind == bitset_view::BLOCKS) && (_bitset_view2.kind == bitset_view::BLOCKS) &&
+      (result.kind == bitset_view::BLOCKS)) {
+    int fast = ((_bitset_view1.full_blocks() <= _bitset_view2.full_blocks()) ?
+        _bitset_view1.full_blocks() : _bitset_view2.full_blocks());
+    if(op == 0) bitset_kernels::and_blocks(result.mutable_arr, _bitset_view1.arr, _bitset_view2.arr, fast);
+    else if(op == 1) bitset_kernels::or_blocks(result.mutable_arr, _bitset_view1.arr, _bitset_view2.arr, fast);
+    else if(op == 2) bitset_kernels::xor_blocks(result.mutable_arr, _bitset_view1.arr, _bitset_view2.arr, fast);
+    i = fast;
+  }
+
+  for(; i < _bitset_view1.blocks; ++i){
+    unsigned long long a = _bitset_view1.get_block(i);
+    unsigned long long b = _bitset_view2.get_block(i);
+    result.store_block(i, ((op == 0) ? (a & b) : ((op == 1) ? (a | b) : (a ^ b))));
+  }
+}
+
+void bitset_view::and_into(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2, mutable_bitset_view &result){
+  bitset_view::combine<0>(_bitset_view1, _bitset_view2, result, "bitset_view::and_into: size_mismatch");
+}
+
+void bitset_view::or_into(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2, mutable_bitset_view &result){
+  bitset_view::combine<1>(_bitset_view1, _bitset_view2, result, "bitset_view::or_into: size_mismatch");
+}
+
+void bitset_view::xor_into(const bitset_view &_bitset_view1, const bitset_view &_bitset_view2, mutable_bitset_view &result){
+  bitset_view::combine<2>(_bitset_view1, _bitset_view2, result, "bitset_view::xor_into: size_mismatch");
+}
+
+void bitset_view::not_into(const bitset_view &_bitset_view, mutable_bitset_view &result){
+  if(result.bits != _bitset_view.bits)
+    throw std::runtime_error("bitset_view::not_into: size_mismatch");
+
+  int i = 0;
+  if((_bitset_view.kind == bitset_view::BLOCKS) && (result.kind == bitset_view::BLOCKS)) {
+    i = _bitset_view.full_blocks();
+    bitset_kernels::not_blocks(result.mutable_arr, _bitset_view.arr, i);
+  }
+  for(; i < _bitset_view.blocks; ++i)
+    result.store_block(i, ~_bitset_view.get_block(i));
+}
+
+void bitset_view::copy_into(const bitset_view &_bitset_view, mutable_bitset_view &result){
+  if(result.bits != _bitset_view.bits)
+    throw std::runtime_error("bitset_view::copy_into: size_mismatch");
+
+  for(int i = 0; i < _bitset_view.blocks; ++i)
+    result.store_block(i, _bitset_view.get_block(i));
+}
+
+///////////////////////////////////////
+// mutable view
+
+mutable_bitset_view::mutable_bitset_view(){
+  this->mutable_bytes = NULL;
+  this->mutable_arr = NULL;
+}
+
+// writes a block, the bits past the size keep their value
+void mutable_bitset_view::store_block(const int &index, const unsigned long long &value){
+  unsigned long long mask = ((index == this->blocks - 1) ? this->tail : ~0ULL);
+
+  if(this->kind == bitset_view::BLOCKS) {
+    if(mask == ~0ULL) this->mutable_arr[index] = value;
+    else this->mutable_arr[index] = (this->mutable_arr[index] & ~mask) | (value & mask);
+    return;
+  }
+
+  int first = index * 8;
+  int bytes_count = (this->bits + 7) / 8;
+  if((mask == ~0ULL) && (first + 8 <= bytes_count)) {
+    bit_ops::store_big_endian(this->mutable_bytes + first, value);
+    return;
+  }
+
+  for(int i = 0; (i < 8) && (first + i < bytes_count); ++i){
+    unsigned char byte_mask = (unsigned char)(mask >> (56 - 8 * i));
+    unsigned char byte = (unsigned char)(value >> (56 - 8 * i));
+    this->mutable_bytes[first + i] = (unsigned char)((this->mutable_bytes[first + i] & ~byte_mask) | (byte & byte_mask));
+  }
+}
+
+mutable_bitset_view::mutable_bitset_view(my_bitset &_my_bitset) : bitset_view(_my_bitset){
+  this->mutable_bytes = NULL;
+  this->mutable_arr = _my_bitset.data();
+}
+
+mutable_bitset_view mutable_bitset_view::from_bytes(unsigned char *buffer, const int &buffer_size){
+  mutable_bitset_view result;
+  result.bytes = result.mutable_bytes = buffer;
+  result.init(bitset_view::buffer_bits(buffer_size, "mutable_bitset_view::from_bytes: size_too_large"), bitset_view::BYTES);
+  return result;
+}
+
+mutable_bitset_view mutable_bitset_view::from_bytes(char *buffer, const int &buffer_size){
+  return mutable_bitset_view::from_bytes((unsigned char*)buffer, buffer_size);
+}
+
+mutable_bitset_view mutable_bitset_view::from_blocks(unsigned long long *blocks, const int &size){
+  mutable_bitset_view result;
+  result.arr = result.mutable_arr = blocks;
+  result.init(size, bitset_view::BLOCKS);
+  return result;
+}
+
+void mutable_bitset_view::set(const int &index, const bool &value){
+  if((index < 0) || (index >= this->bits))
+    throw std::out_of_range("mutable_bitset_view::set: index_out_of_bound");
+
+  if(this->kind == bitset_view::BYTES) {
+    unsigned char mask = (unsigned char)(1 << (7 - (index % 8)));
+    if(value) this->mutable_bytes[index / 8] |= mask;
+    else this->mutable_bytes[index / 8] &= (unsigned char)~mask;
+    return;
+  }
+
+  unsigned long long mask = 1ULL << (bitset_view::block_size - (index % bitset_view::block_size) - 1);
+  if(value) this->mutable_arr[index / bitset_view::block_size] |= mask;
+  else this->mutable_arr[index / bitset_view::block_size] &= ~mask;
+}
+
+void mutable_bitset_view::set_block(const int &index, const unsigned long long &value){
+  if((index < 0) || (index >= this->blocks))
+    throw std::out_of_range("mutable_bitset_view::set_block: index_out_of_bound");
+  this->store_block(index, value);
+}
+
+void mutable_bitset_view::clear(){
+  for(int i = 0; i < this->blocks; ++i)
+    this->store_block(i, 0);
+}
+
+#endif /* BITSET_VIEW_H_ */
@@ -0,0 +1,339 @@
+#ifndef BLOOM_FILTER_H_
+#define BLOOM_FILTER_H_
+
+#include <cstdlib>
+#include <cmath>
+#include <stdexcept>
+
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+
+// cache line blocked bloom filter over a my_bitset. a key selects one 512
+// bits line (a 64 bytes cache line) and all its k probes are bits of that
+// line, so a query costs one cache miss whatever k is. the line base is
+// aligned to 64 bytes inside the bitset storage, one extra line is kept
+// for that.
+//
+// blocking makes the false positive rate higher than the one of a classic
+// filter of the same size, the constructor grows the size until the
+// expected rate of the blocked layout (keys per line are poisson
+// distributed) meets the target.
+//
+// the keys are 64 bits values that are mixed before use, so plain ids
+// are fine, other keys go through the byte overloads.
+
+class bloom_filter {
+private:
+  const static int line_bits = 512;
+  const static int line_blocks = 8;
+  // the batches hash and prefetch a group of keys while the previous
+  // group is processed
+  const static int batch_group = 8;
+
+  my_bitset bits;
+  int lines;
+  int hashes;
+  // the first block of line 0 inside the bitset storage
+  int offset;
+
+  unsigned long long static mix(const unsigned long long &key);
+  unsigned long long static hash_bytes(const char *data, const int &size);
+  int line_of(const unsigned long long &line_hash) const;
+  const unsigned long long* line_address(const unsigned long long &h) const;
+  // the work of insert and contains once the key is mixed
+  void insert_hash(const unsigned long long &h);
+  bool contains_hash(const unsigned long long &h) const;
+  unsigned long long* base();
+  const unsigned long long* base() const;
+  void align();
+
+  double static blocked_rate(const double &items, const double &lines, const int &hashes);
+  void init(const int &lines, const int &hashes);
+  bloom_filter();
+
+public:
+  // sized for the expected number of items and the target false positive rate
+  bloom_filter(const long long &expected_items, const double &false_positive_rate);
+  // explicit number of 512 bits lines and probes per key, a
+  // factory so it is not confused with the sizing constructor
+  bloom_filter static with_shape(const int &lines, const int &hashes);
+  bloom_filter(const bloom_filter &_bloom_filter);
+  bloom_filter& operator = (const bloom_filter &_bloom_filter);
+
+  void insert(const unsigned long long &key);
+  bool contains(const unsigned long long &key) const;
+  void insert(const char *data, const int &size);
+  bool contains(const char *data, const int &size) const;
+
+  // batches, the lines of the next group of keys are prefetched while
+  // the current group is processed, each key is mixed once
+  void insert_batch(const unsigned long long *keys, const int &count);
+  void contains_batch(const unsigned long long *keys, const int &count, bool *results) const;
+
+  // the union of two filters of the same shape (lines and hashes),
+  // throws if the shapes differ
+  bloom_filter& operator |= (const bloom_filter &_bloom_filter);
+  void clear();
+
+  int lines_count() const;
+  int hashes_count() const;
+  long long size_bits() const;
+  // the false positive rate expected from the current fill ratio
+  double estimated_false_positive_rate() const;
+};
+
+///////////////////////////////////////
+
+const int bloom_filter::line_bits;
+const int bloom_filter::line_blocks;
+const int bloom_filter::batch_group;
+
+// splitmix64 step, the first value picks the line and the next ones give
+// the probes, 9 bits each, 7 probes per value
+unsigned long long bloom_filter::mix(const unsigned long long &key){
+  unsigned long long z = key + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// 64 bits fnv-1a
+unsigned long long bloom_filter::hash_bytes(const char *data, const int &size){
+  unsigned long long h = 0xCBF29CE484222325ULL;
+  for(int i = 0; i < size; ++i)
+    h = (h ^ (unsigned char)data[i]) * 0x100000001B3ULL;
+  return h;
+}
+
+// multiply and keep the high half, a modulo without a division
+int bloom_filter::line_of(const unsigned long long &line_hash) const{
+#if defined(__SIZEOF_INT128__)
+  // __extension__ keeps -pedantic quiet about the non standard type
+  __extension__ typedef unsigned __int128 wide;
+  return (int)(((wide)line_hash * (unsigned long long)this->lines) >> 64);
+#else
+  return (int)(line_hash % (unsigned long long)this->lines);
+#endif
+}
+
+const unsigned long long* bloom_filter::line_address(const unsigned long long &h) const{
+  return this->base() + this->line_of(h) * bloom_filter::line_blocks;
+}
+
+unsigned long long* bloom_filter::base(){
+  return this->bits.data() + this->offset;
+}
+
+const unsigned long long* bloom_filter::base() const{
+  return this->bits.data() + this->offset;
+}
+
+void bloom_filter::align(){
+  size_t address = (size_t)this->bits.data();
+  this->offset = (int)(((64 - (address % 64)) % 64) / sizeof(unsigned long long));
+}
+
+// the expected false positive rate of a blocked filter, averaged over
+// the poisson distributed number of keys in a line
+double bloom_filter::blocked_rate(const double &items, const double &lines, const int &hashes){
+  double mean = items / lines;
+  double miss = 1.0 - (1.0 / bloom_filter::line_bits);
+  double result = 0, probability = std::exp(-mean);
+  int limit = (int)(mean + 10 * std::sqrt(mean) + 20);
+  for(int i = 0; i <= limit; ++i){
+    result += probability * std::pow(1.0 - std::pow(miss, (double)hashes * i), (double)hashes);
+    probability *= mean / (i + 1);
+  }
+  return result;
+}
+
+bloom_filter::bloom_filter(const long long &expected_items, const double &false_positive_rate){
+  if((expected_items <= 0) || (false_positive_rate <= 0) || (false_positive_rate >= 1))
+    throw std::runtime_error("bloom_filter::bloom_filter: invalid_parameters");
+
+  // the classic optimum, m = -n ln(p) / ln(2)^2 and k = (m / n) ln(2),
+  // then grown by 5% steps for the blocking
+  double ln2 = std::log(2.0);
+  double items = (double)expected_items;
+  double m = -items * std::log(false_positive_rate) / (ln2 * ln2);
+  int k = (int)std::floor((m / items) * ln2 + 0.5);
+  if(k < 1) k = 1;
+  if(k > 16) k = 16;
+
+  double l = std::ceil(m / bloom_filter::line_bits);
+  if(l < 1) l = 1;
+  while((bloom_filter::blocked_rate(items, l, k) > false_positive_rate) && (l < 1e9))
+    l = std::ceil(l * 1.05);
+  if(l * bloom_filter::line_bits > 2147483647.0 - 2 * bloom_filter::line_bits)
+    throw std::overflow_error("bloom_filter::bloom_filter: overflow_error");
+
+  this->init((int)l, k);
+}
+
+bloom_filter::bloom_filter(){
+  this->lines = this->hashes = this->offset = 0;
+}
+
+bloom_filter bloom_filter::with_shape(const int &lines, const int &hashes){
+  if((lines <= 0) || (hashes <= 0) || (lines > (2147483647 / bloom_filter::line_bits) - 2))
+    throw std::runtime_error("bloom_filter::with_shape: invalid_parameters");
+
+  bloom_filter result;
+  result.init(lines, hashes);
+  return result;
+}
+
+// one extra line leaves room to align line 0 to 64 bytes
+void bloom_filter::init(const int &lines, const int &hashes){
+  this->lines = lines;
+  this->hashes = hashes;
+  this->bits = my_bitset((this->lines + 1) * bloom_filter::line_bits, 0);
+  this->align();
+}
+
+// the copy has its own storage address, so its own alignment offset
+bloom_filter::bloom_filter(const bloom_filter &_bloom_filter) :
+    bits(_bloom_filter.bits.size(), 0){
+  this->lines = _bloom_filter.lines;
+  this->hashes = _bloom_filter.hashes;
+  this->align();
+  memcpy(this->base(), _bloom_filter.base(),
+      this->lines * bloom_filter::line_blocks * sizeof(unsigned long long));
+}
+
+bloom_filter& bloom_filter::operator = (const bloom_filter &_bloom_filter){
+  if(this == &_bloom_filter) return (*this);
+
+  this->init(_bloom_filter.lines, _bloom_filter.hashes);
+  memcpy(this->base(), _bloom_filter.base(),
+      this->lines * bloom_filter::line_blocks * sizeof(unsigned long long));
+  return (*this);
+}
+
+void bloom_filter::insert_hash(const unsigned long long &h){
+  unsigned long long *line = this->base() + this->line_of(h) * bloom_filter::line_blocks;
+
+  unsigned long long seed = h, probes = 0;
+  for(int i = 0; i < this->hashes; ++i){
+    if(i % 7 == 0) probes = seed = bloom_filter::mix(seed);
+    unsigned int position = (unsigned int)(probes & (bloom_filter::line_bits - 1));
+    probes >>= 9;
+    line[position >> 6] |= 1ULL << (position & 63);
+  }
+}
+
+bool bloom_filter::contains_hash(const unsigned long long &h) const{
+  const unsigned long long *line = this->line_address(h);
+
+  unsigned long long seed = h, probes = 0;
+  for(int i = 0; i < this->hashes; ++i){
+    if(i % 7 == 0) probes = seed = bloom_filter::mix(seed);
+    unsigned int position = (unsigned int)(probes & (bloom_filter::line_bits - 1));
+    probes >>= 9;
+    if(!((line[position >> 6] >> (position & 63)) & 1)) return false;
+  }
+  return true;
+}
+
+void bloom_filter::insert(const unsigned long long &key){
+  this->insert_hash(bloom_filter::mix(key));
+}
+
+bool bloom_filter::contains(const unsigned long long &key) const{
+  return this->contains_hash(bloom_filter::mix(key));
+}
+
+void bloom_filter::insert(const char *data, const int &size){
+  this->insert(bloom_filter::hash_bytes(data, size));
+}
+
+bool bloom_filter::contains(const char *data, const int &size) const{
+  return this->contains(bloom_filter::hash_bytes(data, size));
+}
+
+// the hashes of two groups of keys are kept, the group being processed
+// and the next one, whose lines are prefetched first. a ring of one hash
+// per key in flight measured slower than this, and than hashing twice
+void bloom_filter::insert_batch(const unsigned long long *keys, const int &count){
+  unsigned long long hashes[2][bloom_filter::batch_group];
+  for(int j = 0; (j < bloom_filter::batch_group) && (j < count); ++j){
+    hashes[0][j] = bloom_filter::mix(keys[j]);
+#if defined(__GNUC__)
+    __builtin_prefetch(this->line_address(hashes[0][j]), 1);
+#endif
+  }
+
+  for(int start = 0, g = 0; start < count; start += bloom_filter::batch_group, g ^= 1){
+    int next = start + bloom_filter::batch_group;
+    for(int j = 0; (j < bloom_filter::batch_group) && (next + j < count); ++j){
+      hashes[g ^ 1][j] = bloom_filter::mix(keys[next + j]);
+#if defined(__GNUC__)
+      __builtin_prefetch(this->line_address(hashes[g ^ 1][j]), 1);
+#endif
+    }
+    for(int j = 0; (j < bloom_filter::batch_group) && (start + j < count); ++j)
+      this->insert_hash(hashes[g][j]);
+  }
+}
+
+void bloom_filter::contains_batch(const unsigned long long *keys, const int &count, bool *results) const{
+  unsigned long long hashes[2][bloom_filter::batch_group];
+  for(int j = 0; (j < bloom_filter::batch_group) && (j < count); ++j){
+    hashes[0][j] = bloom_filter::mix(keys[j]);
+#if defined(__GNUC__)
+    __builtin_prefetch(this->line_address(hashes[0][j]), 0);
+#endif
+  }
+
+  for(int start = 0, g = 0; start < count; start += bloom_filter::batch_group, g ^= 1){
+    int next = start + bloom_filter::batch_group;
+    for(int j = 0; (j < bloom_filter::batch_group) && (next + j < count); ++j){
+      hashes[g ^ 1][j] = bloom_filter::mix(keys[next + j]);
+#if defined(__GNUC__)
+      __builtin_prefetch(this->line_address(hashes[g ^ 1][j]), 0);
+#endif
+    }
+    for(int j = 0; (j < bloom_filter::batch_group) && (start + j < count); ++j)
+      results[start + j] = this->contains_hash(hashes[g][j]);
+  }
+}
+
+bloom_filter& bloom_filter::operator |= (const bloom_filter &_bloom_filter){
+  if((this->lines != _bloom_filter.lines) || (this->hashes != _bloom_filter.hashes))
+    throw std::runtime_error("bloom_filter::operator|=: incompatible_filters");
+
+  bitset_kernels::or_blocks(this->base(), this->base(), _bloom_filter.base(),
+      this->lines * bloom_filter::line_blocks);
+  return (*this);
+}
+
+void bloom_filter::clear(){
+  memset(this->bits.data(), 0, this->bits.blocks_count() * sizeof(unsigned long long));
+}
+
+int bloom_filter::lines_count() const{
+  return this->lines;
+}
+
+int bloom_filter::hashes_count() const{
+  return this->hashes;
+}
+
+long long bloom_filter::size_bits() const{
+  return (long long)this->lines * bloom_filter::line_bits;
+}
+
+// the probability that k random bits of a line are all set,
+// averaged over the lines
+double bloom_filter::estimated_false_positive_rate() const{
+  const unsigned long long *line = this->base();
+  double result = 0;
+  for(int i = 0; i < this->lines; ++i, line += bloom_filter::line_blocks){
+    double fill = (double)bitset_kernels::count_blocks(line, bloom_filter::line_blocks) / bloom_filter::line_bits;
+    result += std::pow(fill, (double)this->hashes);
+  }
+  return result / this->lines;
+}
+
+#endif /* BLOOM_FILTER_H_ */
@@ -0,0 +1,414 @@
+#ifndef FINGERPRINT_STORE_H_
+#define FINGERPRINT_STORE_H_
+
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+#include "worker_threads.h"
+
+// fixed length binary fingerprints stored one after the other in a single
+// array (in the my_bitset block format) and searched by hamming distance,
+// the distance of two fingerprints is the xor + popcount simd kernel over
+// their blocks, nothing is allocated per pair.
+//
+// search gives the k nearest fingerprints of a query, ordered by distance
+// then by id. the batch search walks the store in tiles that stay in the
+// cache and runs all the queries of a thread against a tile before moving
+// to the next one. with threads > 1 each thread takes its own share of the
+// queries and walks the whole store for it, threads = 0 asks for as many
+// threads as the machine has cores.
+//
+// build_index adds a multi-index hashing index: the fingerprints are cut
+// into m substrings, each one a sorted table, a fingerprint within
+// distance d of the query has a substring within distance d / m of the
+// same substring of the query (pigeonhole), so the search probes the
+// substrings at distance 0, 1, 2, ... of the query and stops as soon as
+// no unseen fingerprint can beat the current k-th one. the results are
+// the same as without the index, it only helps when the neighbours are
+// close, when the probes would cost more than a scan the search falls
+// back to the scan. fingerprints added after build_index are scanned.
+
+class fingerprint_store {
+public:
+  struct match {
+    int id;
+    int distance;
+    // by distance, then by id
+    bool operator < (const match &_match) const;
+  };
+
+private:
+  const static int block_size = 64;
+  // the size of a tile of the batch scan
+  const static int tile_bytes = (1 << 18);
+  // a thread walks every tile of the store whatever its number of
+  // queries, so each one is given at least this many
+  const static int queries_per_thread = 16;
+
+  struct substring_table {
+    int start;
+    int length;
+    // (substring, id) sorted
+    std::vector<std::pair<unsigned long long, int> > entries;
+  };
+
+  int bits;
+  int stride;
+  int count;
+  std::vector<unsigned long long> arr;
+  std::vector<substring_table> tables;
+  // the fingerprints covered by the tables
+  int indexed;
+
+  const unsigned long long* row(const int &id) const;
+  int distance_blocks(const unsigned long long *a, const unsigned long long *b) const;
+  void check_query(const my_bitset &query, const char *where) const;
+  unsigned long long static substring(const unsigned long long *blocks, const int &start, const int &length);
+  void static offer(std::vector<match> &heap, const int &k, const match &candidate);
+
+  void scan(const std::vector<my_bitset> &queries, const int &first, const int &last, const int &k,
+      std::vector<std::vector<match> > &results) const;
+  std::vector<match> search_indexed(const my_bitset &query, const int &k) const;
+  void search_range(const std::vector<my_bitset> &queries, const int &first, const int &last, const int &k,
+      std::vector<std::vector<match> > &results) const;
+
+public:
+  // fingerprints of the given number of bits
+  fingerprint_store(const int &bits);
+
+  // returns the id of the fingerprint, ids are given in order from 0
+  int add(const my_bitset &fingerprint);
+  // the blocks of a fingerprint in the my_bitset format
+  int add(const unsigned long long *blocks);
+  void reserve(const int &count);
+
+  int size() const;
+  int fingerprint_bits() const;
+  my_bitset get(const int &id) const;
+  const unsigned long long* data(const int &id) const;
+  int distance(const int &id, const my_bitset &query) const;
+
+  // the k nearest fingerprints, fewer if the store is smaller
+  std::vector<match> search(const my_bitset &query, const int &k) const;
+  std::vector<std::vector<match> > search_batch(const std::vector<my_bitset> &queries, const int &k,
+      const int &threads) const;
+  // all the fingerprints within the given distance, ordered
+  std::vector<match> search_radius(const my_bitset &query, const int &radius) const;
+
+  // substrings of at most 64 bits, so at least fingerprint_bits() / 64
+  void build_index(const int &substrings);
+  void clear_index();
+  bool is_indexed() const;
+};
+
+///////////////////////////////////////
+
+const int fingerprint_store::block_size;
+const int fingerprint_store::tile_bytes;
+const int fingerprint_store::queries_per_thread;
+
+bool fingerprint_store::match::operator < (const match &_match) const{
+  if(this->distance != _match.distance) return (this->distance < _match.distance);
+  return (this->id < _match.id);
+}
+
+const unsigned long long* fingerprint_store::row(const int &id) const{
+  return this->arr.data() + ((size_t)id * this->stride);
+}
+
+// short fingerprints are counted inline, the kernel call costs more
+// than one or two popcounts
+int fingerprint_store::distance_blocks(const unsigned long long *a, const unsigned long long *b) const{
+  if(this->stride == 1) return bit_ops::popcount(a[0] ^ b[0]);
+  if(this->stride == 2) return bit_ops::popcount(a[0] ^ b[0]) + bit_ops::popcount(a[1] ^ b[1]);
+  return (int)bitset_kernels::count_xor_blocks(a, b, this->stride);
+}
+
+void fingerprint_store::check_query(const my_bitset &query, const char *where) const{
+  if(query.size() != this->bits)
+    throw std::runtime_error(where);
+}
+
+// the length bits (1 to 64) from start, as the low bits of the result
+unsigned long long fingerprint_store::substring(const unsigned long long *blocks, const int &start, const int &length){
+  int block = start / fingerprint_store::block_size;
+  int offset = start % fingerprint_store::block_size;
+  unsigned long long value = blocks[block] << offset;
+  if((offset != 0) && (offset + length > fingerprint_store::block_size))
+    value |= blocks[block + 1] >> (fingerprint_store::block_size - offset);
+  return value >> (fingerprint_store::block_size - length);
+}
+
+// keeps the k best candidates in a max heap, the worst one on top
+void fingerprint_store::offer(std::vector<match> &heap, const int &k, const match &candidate){
+  if((int)heap.size() < k) {
+    heap.push_back(candidate);
+    std::push_heap(heap.begin(), heap.end());
+  }
+  else if((k > 0) && (candidate < heap.front())) {
+    std::pop_heap(heap.begin(), heap.end());
+    heap.back() = candidate;
+    std::push_heap(heap.begin(), heap.end());
+  }
+}
+
+fingerprint_store::fingerprint_store(const int &bits){
+  if(bits <= 0)
+    throw std::runtime_error("fingerprint_store::fingerprint_store: invalid_size");
+
+  this->bits = bits;
+  this->stride = (bits + fingerprint_store::block_size - 1) / fingerprint_store::block_size;
+  this->count = 0;
+  this->indexed = 0;
+}
+
+int fingerprint_store::add(const my_bitset &fingerprint){
+  this->check_query(fingerprint, "fingerprint_store::add: size_mismatch");
+  return this->add(fingerprint.data());
+}
+
+int fingerprint_store::add(const unsigned long long *blocks){
+  this->arr.insert(this->arr.end(), blocks, blocks + this->stride);
+  // the unused low bits of the last block must not count in the distances
+  int used = this->bits % fingerprint_store::block_size;
+  if(used != 0) this->arr.back() &= ~(~0ULL >> used);
+  return this->count++;
+}
+
+void fingerprint_store::reserve(const int &count){
+  if(count > 0) this->arr.reserve((size_t)count * this->stride);
+}
+
+int fingerprint_store::size() const{
+  return this->count;
+}
+
+int fingerprint_store::fingerprint_bits() const{
+  return this->bits;
+}
+
+my_bitset fingerprint_store::get(const int &id) const{
+  my_bitset result(this->bits, 0);
+  memcpy(result.data(), this->data(id), this->stride * sizeof(unsigned long long));
+  return result;
+}
+
+const unsigned long long* fingerprint_store::data(const int &id) const{
+  if((id < 0) || (id >= this->count))
+    throw std::out_of_range("fingerprint_store::data: index_out_of_bound");
+  return this->row(id);
+}
+
+int fingerprint_store::distance(const int &id, const my_bitset &query) const{
+  this->check_query(query, "fingerprint_store::distance: size_mismatch");
+  return this->distance_blocks(this->data(id), query.data());
+}
+
+///////////////////////////////////////
+// scan
+
+void fingerprint_store::scan(const std::vector<my_bitset> &queries, const int &first, const int &last, const int &k,
+    std::vector<std::vector<match> > &results) const{
+  int tile = fingerprint_store::tile_bytes / (this->stride * (int)sizeof(unsigned long long));
+  if(tile < 1) tile = 1;
+
+  // the distances of a tile are computed by one kernel call
+  std::vector<int> distances(std::min(tile, this->count));
+  for(int start = 0; start < this->count; start += tile){
+    int end = std::min(this->count, start + tile);
+    for(int q = first; q < last; ++q){
+      bitset_kernels::count_xor_rows(distances.data(), this->row(start), this->stride, end - start, queries[q].data());
+      std::vector<match> &heap = results[q];
+      for(int id = start; id < end; ++id){
+        match candidate = {id, distances[id - start]};
+        fingerprint_store::offer(heap, k, candidate);
+      }
+    }
+  }
+
+  for(int q = first; q < last; ++q)
+    std::sort_heap(results[q].begin(), results[q].end());
+}
+
+std::vector<fingerprint_store::match> fingerprint_store::search(const my_bitset &query, const int &k) const{
+  this->check_query(query, "fingerprint_store::search: size_mismatch");
+  if(k < 0)
+    throw std::runtime_error("fingerprint_store::search: invalid_k");
+  if(!this->tables.empty())
+    return this->search_indexed(query, k);
+
+  std::vector<my_bitset> queries(1, query);
+  std::vector<std::vector<match> > results(1);
+  this->scan(queries, 0, 1, k, results);
+  return results[0];
+}
+
+void fingerprint_store::search_range(const std::vector<my_bitset> &queries, const int &first, const int &last,
+    const int &k, std::vector<std::vector<match> > &results) const{
+  if(this->tables.empty()) {
+    this->scan(queries, first, last, k, results);
+    return;
+  }
+  for(int q = first; q < last; ++q)
+    results[q] = this->search_indexed(queries[q], k);
+}
+
+std::vector<std::vector<fingerprint_store::match> > fingerprint_store::search_batch(
+    const std::vector<my_bitset> &queries, const int &k, const int &threads) const{
+  if(k < 0)
+    throw std::runtime_error("fingerprint_store::search_batch: invalid_k");
+  for(size_t q = 0; q < queries.size(); ++q)
+    this->check_query(queries[q], "fingerprint_store::search_batch: size_mismatch");
+
+  int total = (int)queries.size();
+  std::vector<std::vector<match> > results(total);
+
+  int workers_count = worker_threads::count(threads, total / fingerprint_store::queries_per_thread);
+  if(workers_count == 1) {
+    this->search_range(queries, 0, total, k, results);
+    return results;
+  }
+
+  std::vector<std::thread> workers;
+  int per_thread = (total + workers_count - 1) / workers_count;
+  for(int t = 1; t < workers_count; ++t){
+    int first = t * per_thread;
+    int last = std::min(total, first + per_thread);
+    if(first >= last) break;
+    workers.push_back(std::thread(&fingerprint_store::search_range, this,
+        std::cref(queries), first, last, k, std::ref(results)));
+  }
+  this->search_range(queries, 0, std::min(total, per_thread), k, results);
+  for(size_t t = 0; t < workers.size(); ++t)
+    workers[t].join();
+  return results;
+}
+
+std::vector<fingerprint_store::match> fingerprint_store::search_radius(const my_bitset &query, const int &radius) const{
+  this->check_query(query, "fingerprint_store::search_radius: size_mismatch");
+
+  std::vector<match> result;
+  for(int id = 0; id < this->count; ++id){
+    int d = this->distance_blocks(this->row(id), query.data());
+    if(d <= radius) {
+      match found = {id, d};
+      result.push_back(found);
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+///////////////////////////////////////
+// multi-index hashing
+
+void fingerprint_store::build_index(const int &substrings){
+  if((substrings <= 0) || (substrings > this->bits) ||
+      ((this->bits + substrings - 1) / substrings > fingerprint_store::block_size))
+    throw std::runtime_error("fingerprint_store::build_index: invalid_substrings");
+
+  this->tables.assign(substrings, substring_table());
+  int start = 0;
+  for(int t = 0; t < substrings; ++t){
+    substring_table &table = this->tables[t];
+    // the first bits % substrings substrings are one bit longer
+    table.start = start;
+    table.length = (this->bits / substrings) + ((t < this->bits % substrings) ? 1 : 0);
+    start += table.length;
+
+    table.entries.resize(this->count);
+    for(int id = 0; id < this->count; ++id)
+      table.entries[id] = std::make_pair(fingerprint_store::substring(this->row(id), table.start, table.length), id);
+    std::sort(table.entries.begin(), table.entries.end());
+  }
+  this->indexed = this->count;
+}
+
+void fingerprint_store::clear_index(){
+  this->tables.clear();
+  this->indexed = 0;
+}
+
+bool fingerprint_store::is_indexed() const{
+  return !this->tables.empty();
+}
+
+std::vector<fingerprint_store::match> fingerprint_store::search_indexed(const my_bitset &query, const int &k) const{
+  const unsigned long long *q = query.data();
+  std::vector<match> heap;
+  std::unordered_set<int> seen;
+
+  // the fingerprints added after the index was built
+  for(int id = this->indexed; id < this->count; ++id){
+    match candidate = {id, this->distance_blocks(this->row(id), q)};
+    fingerprint_store::offer(heap, k, candidate);
+  }
+
+  int m = (int)this->tables.size();
+  int longest = this->tables[0].length;
+  // the probes done so far, a probe is a binary search, past the size of
+  // the store a scan is cheaper
+  double probes = 0;
+  std::vector<int> flipped;
+
+  for(int s = 0; s <= longest; ++s){
+    for(int t = 0; t < m; ++t){
+      const substring_table &table = this->tables[t];
+      if(s > table.length) continue;
+
+      // the number of substrings at distance s, C(length, s)
+      double combinations = 1;
+      for(int i = 0; i < s; ++i) combinations = combinations * (table.length - i) / (i + 1);
+      probes += combinations;
+      if(probes > this->indexed) {
+        std::vector<my_bitset> queries(1, query);
+        std::vector<std::vector<match> > results(1);
+        this->scan(queries, 0, 1, k, results);
+        return results[0];
+      }
+
+      unsigned long long key = fingerprint_store::substring(q, table.start, table.length);
+      // the positions of the flipped bits, in increasing order
+      flipped.resize(s);
+      for(int i = 0; i < s; ++i) flipped[i] = i;
+      while(true){
+        unsigned long long probe = key;
+        for(int i = 0; i < s; ++i) probe ^= (1ULL << flipped[i]);
+
+        std::vector<std::pair<unsigned long long, int> >::const_iterator it = std::lower_bound(
+            table.entries.begin(), table.entries.end(), std::make_pair(probe, -1));
+        for(; (it != table.entries.end()) && (it->first == probe); ++it){
+          if(!seen.insert(it->second).second) continue;
+          match candidate = {it->second, this->distance_blocks(this->row(it->second), q)};
+          fingerprint_store::offer(heap, k, candidate);
+        }
+
+        // the next combination
+        int i = s - 1;
+        while((i >= 0) && (flipped[i] == table.length - s + i)) --i;
+        if(i < 0) break;
+        ++flipped[i];
+        for(int j = i + 1; j < s; ++j) flipped[j] = flipped[j - 1] + 1;
+      }
+    }
+
+    // every unseen fingerprint differs from the query in at least s + 1
+    // bits in each substring
+    if(((int)heap.size() == k) && ((k == 0) || (heap.front().distance < m * (s + 1))))
+      break;
+  }
+
+  std::sort_heap(heap.begin(), heap.end());
+  return heap;
+}
+
+#endif /* FINGERPRINT_STORE_H_ */
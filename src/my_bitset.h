@@ -3,21 +3,110 @@
 
 #include <cstdlib>
 #include <string>
+#include <algorithm>
+#include <iterator>
 #include <memory.h>
 #include <stdexcept>
 
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MY_BITSET_MMAP 1
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// the bits are stored in 64 bits blocks, bit 0 is the most significant bit
+// of the first block, so comparing two blocks as unsigned integers gives the
+// same order as comparing their bits one by one, and the whole bitset reads
+// as a big-endian number with its least significant bit at index size() - 1.
+// the size is exact, the unused low bits of the last block are always zeros.
+// the byte oriented accessors (words) are views over the same bits, word 0
+// is bits 0 to 7, the last word is zero padded when the size is not a
+// multiple of 8.
+// the storage may be larger than the blocks in use (capacity), an
+// assignment from a bitset that fits in it reuses it without allocating.
+// the bitset can also grow at its end (push_back, append_bits, resize),
+// the storage then grows geometrically so appending one bit at a time is
+// amortized constant time.
+// the storage may also be a memory mapped file (see map_file), a 64 bytes
+// header followed by the blocks in native byte order, so opening a file
+// costs nothing until its pages are touched.
+// sizes and bit indices are 64 bits wide, a bitset holds up to max_size()
+// bits (about 17 billion, the words must still be indexable by an int),
+// the blocks stay int indexed.
 class my_bitset {
 private:
   const static int word_size = (sizeof(unsigned char) * 8);
-  unsigned char *arr;
-  int words;
+  const static int block_size = (sizeof(unsigned long long) * 8);
+  const static long long max_bits = 0x7FFFFFFFLL * 8;
+  unsigned long long *arr;
+  long long bits;
+  int blocks;
+  int capacity;
+  // the whole mapped file when the storage is a mapping, NULL otherwise
+  unsigned char *mapping;
+  long long mapping_bytes;
+
+  struct file_header {
+    char magic[8];
+    unsigned long long byte_order;
+    long long bits;
+    long long reserved[5];
+  };
+
+  int static blocks_for(const long long &bits);
+  void allocate(const long long &size);
+  void release();
+  void static open_mapping(my_bitset &result, const char *path, const int &flags, const bool &shared, const long long &new_size);
+  void reallocate(const int &new_capacity);
+  void set_size(const long long &size);
+  void clear_tail();
+  // allocates and fills the blocks from its worker threads
+  friend class parallel_bitset;
+
+  unsigned long long static load_bits(
+      const unsigned long long *src,
+      const int &src_blocks,
+      const long long &index);
+  void static copy_bits(
+      unsigned long long *dst,
+      const long long &dst_index,
+      const unsigned long long *src,
+      const int &src_blocks,
+      const long long &src_index,
+      const long long &length);
+  void static store_bits(
+      unsigned long long *dst,
+      const long long &index,
+      const int &length,
+      const unsigned long long &value);
+
+  // shift whole blocks arrays, dst and src may be the same array
+  void static shift_blocks_left(
+      unsigned long long *dst,
+      const unsigned long long *src,
+      const int &blocks,
+      const long long &places);
+  void static shift_blocks_right(
+      unsigned long long *dst,
+      const unsigned long long *src,
+      const int &blocks,
+      const long long &places);
+  void reverse_bits(const long long &from, const long long &to);
 public:
   my_bitset();
   // basic constructor
-  my_bitset(const int &size, const bool &value);
+  my_bitset(const long long &size, const bool &value);
 
   // copy constructor
   my_bitset(const my_bitset &_my_bitset);
+  // move constructor, leaves the passed object empty
+  my_bitset(my_bitset &&_my_bitset);
   my_bitset(const unsigned long long &val);
   my_bitset(const unsigned char* buffer, const int &buffer_size);
 
@@ -28,30 +117,145 @@ public:
   // destructor
   ~my_bitset();
 
-  // assignment operator
+  // file backed storage (posix only), map_file opens an existing file,
+  // a READ_ONLY mapping is copy on write, so the bitset can still be
+  // changed but the file never is, a READ_WRITE mapping writes the changes
+  // through to the file. create_file makes a new zero filled file of the
+  // given size and maps it READ_WRITE, save writes any bitset in the same
+  // format to a new file that then replaces the one at path, so a bitset
+  // can be saved over the file it is mapped from (the bitset stays mapped
+  // to the replaced file, map_file the path again to follow the new one).
+  // an assignment that does not fit in the mapped file moves the
+  // bitset to heap storage, detaching it from the file.
+  enum map_mode {
+    READ_ONLY, READ_WRITE
+  };
+  my_bitset static map_file(const std::string &path, const map_mode &mode);
+  my_bitset static create_file(const std::string &path, const long long &size);
+  void save(const std::string &path) const;
+  bool is_mapped() const;
+  // flushes the changes of a READ_WRITE mapping to the file
+  void sync() const;
+
+  // assignment operator, reuses the storage when it is large enough
   my_bitset& operator = (const my_bitset &_my_bitset);
+  // move assignment operator, takes the passed object storage
+  my_bitset& operator = (my_bitset &&_my_bitset);
 
   // access
   int static get_word_size();
   int words_count() const;
-  int size() const;
-  bool get(const int &index) const;
+  long long size() const;
+  // the largest size a bitset can have
+  long long static max_size();
+  bool get(const long long &index) const;
   unsigned char get_word(const int &index) const;
-  void set(const int &index, const bool &value);
+  void set(const long long &index, const bool &value);
   void set_word(const int &index, const unsigned char &value);
 
+  // block access, blocks are the 64 bits storage units
+  int static get_block_size();
+  int blocks_count() const;
+  unsigned long long get_block(const int &index) const;
+  void set_block(const int &index, const unsigned long long &value);
+  // the blocks themselves, for the kernels and the structures built on
+  // top of my_bitset, a writer must keep the unused tail bits clear
+  unsigned long long* data();
+  const unsigned long long* data() const;
+
+  // growing and shrinking at the end, the bits keep their indices. the
+  // storage is only reallocated when the capacity is exceeded, a mapped
+  // bitset grows in its file while it fits and moves to the heap otherwise
+
+  // the number of bits the storage can hold without a reallocation
+  long long capacity_bits() const;
+  void reserve(const long long &size);
+  // the new bits take the given value
+  void resize(const long long &size, const bool &value);
+  void push_back(const bool &value);
+  void pop_back();
+  // appends the low length bits (0 to 64) of value, most significant
+  // first, so the appended bits read as the number value
+  void append_bits(const unsigned long long &value, const int &length);
+  void shrink_to_fit();
+
+  // bit counting and searching, the find functions return -1 if
+  // there is no set bit
+  long long count() const;
+  // the number of bits set in both bitsets, without building the
+  // intersection, the passed object is zero extended if it is shorter
+  long long count_and(const my_bitset &_my_bitset) const;
+  bool any() const;
+  bool none() const;
+  long long find_first() const;
+  long long find_next(const long long &index) const;
+  long long count_leading_zeros() const;
+  // the first set bit at or after the given index and the last set bit
+  // at or before it, indices out of range are clamped to the bitset
+  long long find_next_set(const long long &from) const;
+  long long find_prev_set(const long long &from) const;
+
+  // calls f(index) for every set bit in increasing order, the zero blocks
+  // are skipped, so the cost follows the number of set bits
+  template<typename function>
+  void for_each_set_bit(function f) const;
+
+  // bidirectional iterator over the indices of the set bits
+  class set_bit_iterator {
+  private:
+    const my_bitset *owner;
+    long long index;
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef long long value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const long long* pointer;
+    typedef long long reference;
+
+    set_bit_iterator();
+    set_bit_iterator(const my_bitset *owner, const long long &index);
+    long long operator * () const;
+    set_bit_iterator& operator ++ ();
+    set_bit_iterator operator ++ (int);
+    set_bit_iterator& operator -- ();
+    set_bit_iterator operator -- (int);
+    bool operator == (const set_bit_iterator &it) const;
+    bool operator != (const set_bit_iterator &it) const;
+  };
+  typedef std::reverse_iterator<set_bit_iterator> reverse_set_bit_iterator;
+
+  set_bit_iterator begin_set_bits() const;
+  set_bit_iterator end_set_bits() const;
+  reverse_set_bit_iterator rbegin_set_bits() const;
+  reverse_set_bit_iterator rend_set_bits() const;
+
   // all operators should return a new value without changing either
   // the calling object (the this object) or the passed object
   my_bitset operator & (const my_bitset &_my_bitset) const;
   my_bitset operator | (const my_bitset &_my_bitset) const;
   my_bitset operator ^ (const my_bitset &_my_bitset) const;
   my_bitset operator ~ () const;
-  my_bitset operator << (const int &places) const;
-  my_bitset operator >> (const int &places) const;
-  my_bitset rotate_left  (const int &places) const;
-  my_bitset rotate_right (const int &places) const;
-  my_bitset pad_left (const int &places, const bool &value) const;
-  my_bitset pad_right (const int &places, const bool &value) const;
+  my_bitset operator << (const long long &places) const;
+  my_bitset operator >> (const long long &places) const;
+  my_bitset rotate_left  (const long long &places) const;
+  my_bitset rotate_right (const long long &places) const;
+
+  // in place binary operators and complement, they do not allocate,
+  // the size of the calling object does not change and the passed
+  // object is zero extended if it is shorter
+  my_bitset& operator &= (const my_bitset &_my_bitset);
+  my_bitset& operator |= (const my_bitset &_my_bitset);
+  my_bitset& operator ^= (const my_bitset &_my_bitset);
+  my_bitset& flip();
+
+  // in place shifts and rotates, they do not allocate
+  my_bitset& operator <<= (const long long &places);
+  my_bitset& operator >>= (const long long &places);
+  my_bitset& rotate_left_inplace  (const long long &places);
+  my_bitset& rotate_right_inplace (const long long &places);
+
+  my_bitset pad_left (const long long &places, const bool &value) const;
+  my_bitset pad_right (const long long &places, const bool &value) const;
   my_bitset trim_left () const;
   my_bitset trim_left (const int &words_count) const;
   my_bitset trim_right () const;
@@ -69,6 +273,7 @@ public:
   bool operator < (const my_bitset &_my_bitset) const;
   bool operator <= (const my_bitset &_my_bitset) const;
 
+  // the bits one per bool, for bitsets of up to 2^31 - 1 bits
   bool* dump(int &size) const;
   char* to_c_str() const;
   char* to_c_str(int &size) const;
@@ -78,270 +283,1035 @@ public:
 
 ///////////////////////////////////////
 
+const int my_bitset::word_size;
+const int my_bitset::block_size;
+const long long my_bitset::max_bits;
+
+// the sizes are checked against max_bits first, so the blocks fit an int
+int my_bitset::blocks_for(const long long &bits){
+  return (int)((bits + my_bitset::block_size - 1) / my_bitset::block_size);
+}
+
+// gives an empty bitset storage for the given size, the blocks are
+// not initialized, the caller fills all of them
+void my_bitset::allocate(const long long &size){
+  if(size > my_bitset::max_bits)
+    throw std::length_error("my_bitset::allocate: size_too_large");
+
+  int _blocks = my_bitset::blocks_for(size);
+  this->arr = ((_blocks == 0) ? NULL : new unsigned long long[_blocks]);
+  this->bits = size;
+  this->blocks = _blocks;
+  this->capacity = _blocks;
+  this->mapping = NULL;
+  this->mapping_bytes = 0;
+}
+
+// frees the heap storage or unmaps the file, leaving an empty bitset
+void my_bitset::release(){
+#ifdef MY_BITSET_MMAP
+  if(this->mapping != NULL) munmap(this->mapping, (size_t)this->mapping_bytes);
+  else delete[] this->arr;
+#else
+  delete[] this->arr;
+#endif
+  this->arr = NULL;
+  this->mapping = NULL;
+  this->mapping_bytes = 0;
+  this->bits = this->blocks = this->capacity = 0;
+}
+
+// zeros the unused low bits of the last block
+void my_bitset::clear_tail(){
+  int used = (int)(this->bits % my_bitset::block_size);
+  if(used != 0)
+    this->arr[this->blocks - 1] &= ~(~0ULL >> used);
+}
+
+// the 64 bits starting at the given index, aligned to the most
+// significant bit, the bits past the last block read as zeros
+unsigned long long my_bitset::load_bits(
+    const unsigned long long *src,
+    const int &src_blocks,
+    const long long &index){
+
+  long long block = index / my_bitset::block_size;
+  int offset = (int)(index % my_bitset::block_size);
+  if(block >= src_blocks) return 0;
+
+  unsigned long long value = src[block] << offset;
+  if((offset != 0) && (block + 1 < src_blocks))
+    value |= src[block + 1] >> (my_bitset::block_size - offset);
+  return value;
+}
+
+// copies length bits from src starting at src_index to dst starting at
+// dst_index, one destination block (or the part of it in range) at a time
+void my_bitset::copy_bits(
+    unsigned long long *dst,
+    const long long &dst_index,
+    const unsigned long long *src,
+    const int &src_blocks,
+    const long long &src_index,
+    const long long &length){
+
+  long long dst_pos = dst_index, src_pos = src_index, remaining = length;
+  while(remaining > 0){
+    int offset = (int)(dst_pos % my_bitset::block_size);
+    int chunk = my_bitset::block_size - offset;
+    if(chunk > remaining) chunk = (int)remaining;
+
+    unsigned long long mask = ((chunk == my_bitset::block_size) ?
+        ~0ULL : (~(~0ULL >> chunk))) >> offset;
+    unsigned long long value = my_bitset::load_bits(src, src_blocks, src_pos) >> offset;
+    unsigned long long &target = dst[dst_pos / my_bitset::block_size];
+    target = (target & ~mask) | (value & mask);
+
+    dst_pos += chunk, src_pos += chunk, remaining -= chunk;
+  }
+}
+
+// writes the top length bits (1 to 64) of value starting at the given index
+void my_bitset::store_bits(
+    unsigned long long *dst,
+    const long long &index,
+    const int &length,
+    const unsigned long long &value){
+
+  long long block = index / my_bitset::block_size;
+  int offset = (int)(index % my_bitset::block_size);
+  int first = my_bitset::block_size - offset;
+  if(first > length) first = length;
+
+  unsigned long long mask = ((first == my_bitset::block_size) ?
+      ~0ULL : (~(~0ULL >> first))) >> offset;
+  dst[block] = (dst[block] & ~mask) | ((value >> offset) & mask);
+
+  if(length > first){
+    mask = ~(~0ULL >> (length - first));
+    dst[block + 1] = (dst[block + 1] & ~mask) | ((value << first) & mask);
+  }
+}
+
+// moves the bits towards index 0, a whole blocks move followed by a funnel
+// shift of every pair of adjacent blocks, the blocks are visited in
+// increasing order so every source block is read before it is overwritten
+void my_bitset::shift_blocks_left(
+    unsigned long long *dst,
+    const unsigned long long *src,
+    const int &blocks,
+    const long long &places){
+
+  if(places / my_bitset::block_size >= blocks) {
+    if(blocks > 0) memset(dst, 0, blocks * sizeof(unsigned long long));
+    return;
+  }
+  int block_shift = (int)(places / my_bitset::block_size);
+  int bit_shift = (int)(places % my_bitset::block_size);
+
+  int moved = blocks - block_shift;
+  if(bit_shift == 0) {
+    memmove(dst, src + block_shift, moved * sizeof(unsigned long long));
+  }
+  else {
+    for(int i = 0; i < moved - 1; ++i)
+      dst[i] = (src[i + block_shift] << bit_shift) |
+          (src[i + block_shift + 1] >> (my_bitset::block_size - bit_shift));
+    dst[moved - 1] = src[blocks - 1] << bit_shift;
+  }
+
+  if(block_shift > 0)
+    memset(dst + moved, 0, block_shift * sizeof(unsigned long long));
+}
+
+// moves the bits away from index 0, the mirror of shift_blocks_left,
+// visiting the blocks in decreasing order
+void my_bitset::shift_blocks_right(
+    unsigned long long *dst,
+    const unsigned long long *src,
+    const int &blocks,
+    const long long &places){
+
+  if(places / my_bitset::block_size >= blocks) {
+    if(blocks > 0) memset(dst, 0, blocks * sizeof(unsigned long long));
+    return;
+  }
+  int block_shift = (int)(places / my_bitset::block_size);
+  int bit_shift = (int)(places % my_bitset::block_size);
+
+  int moved = blocks - block_shift;
+  if(bit_shift == 0) {
+    memmove(dst + block_shift, src, moved * sizeof(unsigned long long));
+  }
+  else {
+    for(int i = blocks - 1; i > block_shift; --i)
+      dst[i] = (src[i - block_shift] >> bit_shift) |
+          (src[i - block_shift - 1] << (my_bitset::block_size - bit_shift));
+    dst[block_shift] = src[0] >> bit_shift;
+  }
+
+  if(block_shift > 0)
+    memset(dst, 0, block_shift * sizeof(unsigned long long));
+}
+
+// reverses the order of the bits in the range [from, to), swapping
+// 64 bits windows from both ends of the range towards its middle
+void my_bitset::reverse_bits(const long long &from, const long long &to){
+  long long left = from, right = to;
+  while((right - left) >= (2 * my_bitset::block_size)){
+    unsigned long long left_bits = my_bitset::load_bits(this->arr, this->blocks, left);
+    unsigned long long right_bits = my_bitset::load_bits(this->arr, this->blocks, right - my_bitset::block_size);
+    my_bitset::store_bits(this->arr, left, my_bitset::block_size, bit_ops::reverse(right_bits));
+    my_bitset::store_bits(this->arr, right - my_bitset::block_size, my_bitset::block_size, bit_ops::reverse(left_bits));
+    left += my_bitset::block_size, right -= my_bitset::block_size;
+  }
+
+  // less than two windows are left, split them into a head of up to 64
+  // bits and the rest, the reversed range is the reversed rest followed
+  // by the reversed head
+  int remaining = (int)(right - left);
+  if(remaining <= 0) return;
+
+  int head = ((remaining < my_bitset::block_size) ? remaining : my_bitset::block_size);
+  int rest = remaining - head;
+  unsigned long long head_bits = my_bitset::load_bits(this->arr, this->blocks, left);
+  unsigned long long rest_bits = ((rest == 0) ? 0 :
+      my_bitset::load_bits(this->arr, this->blocks, left + head));
+
+  if(rest > 0)
+    my_bitset::store_bits(this->arr, left, rest,
+        bit_ops::reverse(rest_bits) << (my_bitset::block_size - rest));
+  my_bitset::store_bits(this->arr, left + rest, head,
+      bit_ops::reverse(head_bits) << (my_bitset::block_size - head));
+}
+
+///////////////////////////////////////
+
 my_bitset::my_bitset(){
-  this->words = 0;
+  this->bits = 0;
+  this->blocks = 0;
+  this->capacity = 0;
   this->arr = NULL;
+  this->mapping = NULL;
+  this->mapping_bytes = 0;
 }
 
-my_bitset::my_bitset(const int &size, const bool &value){
+my_bitset::my_bitset(const long long &size, const bool &value){
   if(size < 0)
     throw std::runtime_error("my_bitset::my_bitset: invalid_size");
-
+  if(size > my_bitset::max_bits)
+    throw std::length_error("my_bitset::my_bitset: size_too_large");
+
+  this->bits = size;
+  this->blocks = my_bitset::blocks_for(size);
+  this->capacity = this->blocks;
+  this->mapping = NULL;
+  this->mapping_bytes = 0;
   if(size == 0) {
-    this->words = 0;
     this->arr = NULL;
     return;
   }
 
-  this->words = ((size - 1) / my_bitset::word_size) + 1;
-  this->arr = new unsigned char[this->words];
-  if(!value) memset(this->arr, 0, this->words);
-  else memset(this->arr, 0xFF, this->words);
+  this->arr = new unsigned long long[this->blocks];
+  if(!value) memset(this->arr, 0, this->blocks * sizeof(unsigned long long));
+  else memset(this->arr, 0xFF, this->blocks * sizeof(unsigned long long));
+  this->clear_tail();
 }
 
 my_bitset::my_bitset(const my_bitset &_my_bitset){
-  this->arr = new unsigned char[_my_bitset.words];
-  this->words = _my_bitset.words;
-  memcpy(this->arr, _my_bitset.arr, _my_bitset.words);
+  this->allocate(_my_bitset.bits);
+  if(this->blocks != 0)
+    memcpy(this->arr, _my_bitset.arr, this->blocks * sizeof(unsigned long long));
 }
 
-my_bitset::my_bitset(const unsigned long long &value){
-  unsigned long long _value = value;
-  unsigned long long base = 1 << my_bitset::word_size;
-  this->words = sizeof(_value) / sizeof(unsigned char);
-  this->arr = new unsigned char[this->words];
-  memset(this->arr, 0, this->words);
+my_bitset::my_bitset(my_bitset &&_my_bitset){
+  this->bits = _my_bitset.bits;
+  this->blocks = _my_bitset.blocks;
+  this->capacity = _my_bitset.capacity;
+  this->arr = _my_bitset.arr;
+  this->mapping = _my_bitset.mapping;
+  this->mapping_bytes = _my_bitset.mapping_bytes;
+  _my_bitset.bits = 0;
+  _my_bitset.blocks = 0;
+  _my_bitset.capacity = 0;
+  _my_bitset.arr = NULL;
+  _my_bitset.mapping = NULL;
+  _my_bitset.mapping_bytes = 0;
+}
 
-  int index = this->words;
-  while(index--)
-    this->arr[index] = _value % base, _value /= base;
+my_bitset::my_bitset(const unsigned long long &value){
+  this->allocate(my_bitset::block_size);
+  this->arr[0] = value;
 }
 
 my_bitset::my_bitset(const unsigned char* buffer, const int &buffer_size){
-  this->arr = new unsigned char[buffer_size];
-  this->words = buffer_size;
-  memcpy(this->arr, buffer, buffer_size);
+  if(buffer_size < 0)
+    throw std::runtime_error("my_bitset::my_bitset: invalid_size");
+
+  this->allocate((long long)buffer_size * my_bitset::word_size);
+
+  // whole blocks are loaded as big-endian 64 bits values,
+  // the bytes of the last partial block are shifted in
+  int full_blocks = buffer_size / sizeof(unsigned long long);
+  for(int i = 0; i < full_blocks; ++i)
+    this->arr[i] = bit_ops::load_big_endian(buffer + (i * sizeof(unsigned long long)));
+
+  if(full_blocks < this->blocks){
+    unsigned long long value = 0;
+    for(int i = full_blocks * sizeof(unsigned long long); i < buffer_size; ++i)
+      value = (value << my_bitset::word_size) | buffer[i];
+    int used = buffer_size - (full_blocks * sizeof(unsigned long long));
+    this->arr[full_blocks] = value << (my_bitset::block_size - (used * my_bitset::word_size));
+  }
 }
 
 // text constructor
-my_bitset::my_bitset(const char* buffer, const int &buffer_size){
-  this->arr = new unsigned char[buffer_size];
-  this->words = buffer_size;
-  memcpy(this->arr, buffer, buffer_size);
-}
+my_bitset::my_bitset(const char* buffer, const int &buffer_size) :
+    my_bitset((const unsigned char*)buffer, buffer_size) { }
 
 // text constructor
-my_bitset::my_bitset(const std::string &str){
-  this->arr = new unsigned char[str.size()];
-  this->words = str.size();
-  memcpy(this->arr, str.c_str(), str.size());
-}
+my_bitset::my_bitset(const std::string &str) :
+    my_bitset((const unsigned char*)str.c_str(), (int)str.size()) { }
 
 my_bitset::~my_bitset(){
-  delete[] this->arr;
+  this->release();
 }
 
 my_bitset& my_bitset::operator = (const my_bitset &_my_bitset){
-  delete[] this->arr;
-  this->arr = new unsigned char[_my_bitset.words];
-  this->words = _my_bitset.words;
-  memcpy(this->arr, _my_bitset.arr, _my_bitset.words);
+  if(this == &_my_bitset) return (*this);
+
+  if(_my_bitset.blocks > this->capacity) {
+    // left empty if the allocation throws
+    this->release();
+    this->allocate(_my_bitset.bits);
+  }
+  else {
+    this->bits = _my_bitset.bits;
+    this->blocks = _my_bitset.blocks;
+    if(this->mapping != NULL)
+      ((file_header*)this->mapping)->bits = this->bits;
+  }
+
+  if(this->blocks != 0)
+    memcpy(this->arr, _my_bitset.arr, this->blocks * sizeof(unsigned long long));
+  return (*this);
+}
+
+my_bitset& my_bitset::operator = (my_bitset &&_my_bitset){
+  if(this == &_my_bitset) return (*this);
+
+  this->release();
+  this->bits = _my_bitset.bits;
+  this->blocks = _my_bitset.blocks;
+  this->capacity = _my_bitset.capacity;
+  this->arr = _my_bitset.arr;
+  this->mapping = _my_bitset.mapping;
+  this->mapping_bytes = _my_bitset.mapping_bytes;
+  _my_bitset.bits = 0;
+  _my_bitset.blocks = 0;
+  _my_bitset.capacity = 0;
+  _my_bitset.arr = NULL;
+  _my_bitset.mapping = NULL;
+  _my_bitset.mapping_bytes = 0;
   return (*this);
 }
 
+// maps the file at path into result, when new_size is not negative the
+// file is (re)sized to hold a zero filled bitset of that size first
+void my_bitset::open_mapping(my_bitset &result, const char *path, const int &flags, const bool &shared, const long long &new_size){
+#ifdef MY_BITSET_MMAP
+  const char magic[8] = {'M', 'Y', 'B', 'I', 'T', 'S', 'E', 'T'};
+  const unsigned long long byte_order = 0x0102030405060708ULL;
+
+  int fd = open(path, flags, 0644);
+  if(fd < 0)
+    throw std::runtime_error("my_bitset::map_file: open_failed");
+
+  long long bytes;
+  if(new_size >= 0) {
+    bytes = (long long)sizeof(file_header) + (long long)my_bitset::blocks_for(new_size) * sizeof(unsigned long long);
+    if((ftruncate(fd, 0) != 0) || (ftruncate(fd, (off_t)bytes) != 0)) {
+      close(fd);
+      throw std::runtime_error("my_bitset::create_file: resize_failed");
+    }
+  }
+  else {
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("my_bitset::map_file: stat_failed");
+    }
+    bytes = (long long)st.st_size;
+    if(bytes < (long long)sizeof(file_header)) {
+      close(fd);
+      throw std::runtime_error("my_bitset::map_file: invalid_file");
+    }
+  }
+
+  // the pages of a private mapping are copied on the first write,
+  // so a read only file can still back a writable bitset
+  void *address = mmap(NULL, (size_t)bytes, PROT_READ | PROT_WRITE,
+      (shared ? MAP_SHARED : MAP_PRIVATE), fd, 0);
+  close(fd);
+  if(address == MAP_FAILED)
+    throw std::runtime_error("my_bitset::map_file: mmap_failed");
+
+  file_header *header = (file_header*)address;
+  if(new_size >= 0) {
+    memcpy(header->magic, magic, sizeof(magic));
+    header->byte_order = byte_order;
+    header->bits = new_size;
+  }
+  else if((memcmp(header->magic, magic, sizeof(magic)) != 0) || (header->byte_order != byte_order) ||
+      (header->bits < 0) || (header->bits > my_bitset::max_bits) ||
+      ((long long)sizeof(file_header) + (long long)my_bitset::blocks_for(header->bits) *
+          (long long)sizeof(unsigned long long) > bytes)) {
+    munmap(address, (size_t)bytes);
+    throw std::runtime_error("my_bitset::map_file: invalid_file");
+  }
+
+  result.release();
+  result.mapping = (unsigned char*)address;
+  result.mapping_bytes = bytes;
+  result.bits = header->bits;
+  result.blocks = my_bitset::blocks_for(result.bits);
+  // a file longer than the largest bitset only lends that much capacity
+  long long file_blocks = (bytes - (long long)sizeof(file_header)) / (long long)sizeof(unsigned long long);
+  result.capacity = ((file_blocks > my_bitset::blocks_for(my_bitset::max_bits)) ?
+      my_bitset::blocks_for(my_bitset::max_bits) : (int)file_blocks);
+  result.arr = (unsigned long long*)(result.mapping + sizeof(file_header));
+#else
+  throw std::runtime_error("my_bitset::map_file: not_supported");
+#endif
+}
+
+my_bitset my_bitset::map_file(const std::string &path, const map_mode &mode){
+  my_bitset result;
+#ifdef MY_BITSET_MMAP
+  my_bitset::open_mapping(result, path.c_str(),
+      ((mode == my_bitset::READ_WRITE) ? O_RDWR : O_RDONLY), (mode == my_bitset::READ_WRITE), -1);
+#else
+  my_bitset::open_mapping(result, path.c_str(), 0, false, -1);
+#endif
+  return result;
+}
+
+my_bitset my_bitset::create_file(const std::string &path, const long long &size){
+  if(size < 0)
+    throw std::runtime_error("my_bitset::create_file: invalid_size");
+  if(size > my_bitset::max_bits)
+    throw std::length_error("my_bitset::create_file: size_too_large");
+
+  my_bitset result;
+#ifdef MY_BITSET_MMAP
+  my_bitset::open_mapping(result, path.c_str(), O_RDWR | O_CREAT, true, size);
+#else
+  my_bitset::open_mapping(result, path.c_str(), 0, true, size);
+#endif
+  return result;
+}
+
+// the bits are written to a temporary file in the directory of path,
+// which is renamed over path once complete, create_file on path itself
+// would truncate the file this bitset may be mapped from before reading it
+void my_bitset::save(const std::string &path) const{
+#ifdef MY_BITSET_MMAP
+  std::string temporary = path + ".XXXXXX";
+  int fd = mkstemp(&temporary[0]);
+  if(fd < 0)
+    throw std::runtime_error("my_bitset::save: open_failed");
+  // mkstemp creates the file private to the user, create_file gives 0644
+  fchmod(fd, 0644);
+  close(fd);
+
+  try {
+    my_bitset file = my_bitset::create_file(temporary, this->bits);
+    if(this->blocks != 0)
+      memcpy(file.arr, this->arr, this->blocks * sizeof(unsigned long long));
+    file.sync();
+  }
+  catch(...) {
+    unlink(temporary.c_str());
+    throw;
+  }
+
+  if(rename(temporary.c_str(), path.c_str()) != 0) {
+    unlink(temporary.c_str());
+    throw std::runtime_error("my_bitset::save: rename_failed");
+  }
+#else
+  my_bitset file = my_bitset::create_file(path, this->bits);
+#endif
+}
+
+bool my_bitset::is_mapped() const{
+  return (this->mapping != NULL);
+}
+
+void my_bitset::sync() const{
+#ifdef MY_BITSET_MMAP
+  if(this->mapping == NULL) return;
+  if(msync(this->mapping, (size_t)this->mapping_bytes, MS_SYNC) != 0)
+    throw std::runtime_error("my_bitset::sync: msync_failed");
+#endif
+}
+
 int my_bitset::get_word_size(){
   return my_bitset::word_size;
 }
 
 int my_bitset::words_count() const{
-  return this->words;
+  return (int)((this->bits + my_bitset::word_size - 1) / my_bitset::word_size);
+}
+
+long long my_bitset::size() const{
+  return this->bits;
 }
 
-int my_bitset::size() const{
-  return (this->words * my_bitset::word_size);
+long long my_bitset::max_size(){
+  return my_bitset::max_bits;
 }
 
-bool my_bitset::get(const int &index) const{
-  int size = this->words * my_bitset::word_size;
-  if(index >= size)
+bool my_bitset::get(const long long &index) const{
+  if(index >= this->bits)
     throw std::out_of_range("my_bitset::get: index_out_of_bound");
   if(index < 0)
     throw std::out_of_range("my_bitset::get: index_out_of_bound");
 
-  int word_index = index / my_bitset::word_size;
-  int bit_index = index % my_bitset::word_size;
+  int block_index = (int)(index / my_bitset::block_size);
+  int bit_index = (int)(index % my_bitset::block_size);
 
-  return (bool)(((this->arr[word_index]) >> (my_bitset::word_size - bit_index - 1)) & 1);
+  return (bool)((this->arr[block_index] >> (my_bitset::block_size - bit_index - 1)) & 1);
 }
 
 unsigned char my_bitset::get_word(const int &index) const{
-  if(index >= this->words)
+  if(index >= this->words_count())
     throw std::out_of_range("my_bitset::get_word: index_out_of_bound");
   if(index < 0)
     throw std::out_of_range("my_bitset::get_word: index_out_of_bound");
-  return this->arr[index];
+
+  int block_index = index / sizeof(unsigned long long);
+  int shift = my_bitset::block_size - (((index % sizeof(unsigned long long)) + 1) * my_bitset::word_size);
+  return (unsigned char)(this->arr[block_index] >> shift);
 }
 
-void my_bitset::set(const int &index, const bool &value){
-  int size = this->words * my_bitset::word_size;
-  if(index >= size)
+void my_bitset::set(const long long &index, const bool &value){
+  if(index >= this->bits)
     throw std::out_of_range("my_bitset::set: index_out_of_bound");
   if(index < 0)
     throw std::out_of_range("my_bitset::set: index_out_of_bound");
 
-  int word_index = index / my_bitset::word_size;
-  int bit_index = index % my_bitset::word_size;
+  int block_index = (int)(index / my_bitset::block_size);
+  int bit_index = (int)(index % my_bitset::block_size);
 
-  unsigned char mask = (unsigned char)(1 << (my_bitset::word_size - bit_index - 1));
-  if(value) this->arr[word_index] |= mask;
-  else this->arr[word_index] &= (~mask);
+  unsigned long long mask = 1ULL << (my_bitset::block_size - bit_index - 1);
+  if(value) this->arr[block_index] |= mask;
+  else this->arr[block_index] &= (~mask);
 }
 
 void my_bitset::set_word(const int &index, const unsigned char &value){
-  if(index >= this->words)
+  if(index >= this->words_count())
     throw std::out_of_range("my_bitset::set_word: index_out_of_bound");
   if(index < 0)
     throw std::out_of_range("my_bitset::set_word: index_out_of_bound");
+
+  int block_index = index / sizeof(unsigned long long);
+  int shift = my_bitset::block_size - (((index % sizeof(unsigned long long)) + 1) * my_bitset::word_size);
+  this->arr[block_index] &= ~(0xFFULL << shift);
+  this->arr[block_index] |= ((unsigned long long)value) << shift;
+  if(block_index == this->blocks - 1) this->clear_tail();
+}
+
+int my_bitset::get_block_size(){
+  return my_bitset::block_size;
+}
+
+int my_bitset::blocks_count() const{
+  return this->blocks;
+}
+
+unsigned long long my_bitset::get_block(const int &index) const{
+  if(index >= this->blocks)
+    throw std::out_of_range("my_bitset::get_block: index_out_of_bound");
+  if(index < 0)
+    throw std::out_of_range("my_bitset::get_block: index_out_of_bound");
+  return this->arr[index];
+}
+
+void my_bitset::set_block(const int &index, const unsigned long long &value){
+  if(index >= this->blocks)
+    throw std::out_of_range("my_bitset::set_block: index_out_of_bound");
+  if(index < 0)
+    throw std::out_of_range("my_bitset::set_block: index_out_of_bound");
   this->arr[index] = value;
+  if(index == this->blocks - 1) this->clear_tail();
+}
+
+unsigned long long* my_bitset::data(){
+  return this->arr;
+}
+
+const unsigned long long* my_bitset::data() const{
+  return this->arr;
+}
+
+// moves the blocks in use to a new heap storage of the given capacity
+// (in blocks), the blocks past them are not initialized
+void my_bitset::reallocate(const int &new_capacity){
+  unsigned long long *fresh = ((new_capacity == 0) ? NULL : new unsigned long long[new_capacity]);
+  if(this->blocks != 0)
+    memcpy(fresh, this->arr, this->blocks * sizeof(unsigned long long));
+
+  long long _bits = this->bits;
+  int _blocks = this->blocks;
+  this->release();
+  this->arr = fresh;
+  this->bits = _bits;
+  this->blocks = _blocks;
+  this->capacity = new_capacity;
+}
+
+// changes the size within the capacity, the blocks that come into use are
+// zero filled and the tail of the last block is cleared, so the new bits
+// are zeros
+void my_bitset::set_size(const long long &size){
+  int _blocks = my_bitset::blocks_for(size);
+  if(_blocks > this->blocks)
+    memset(this->arr + this->blocks, 0, (_blocks - this->blocks) * sizeof(unsigned long long));
+  this->bits = size;
+  this->blocks = _blocks;
+  this->clear_tail();
+  if(this->mapping != NULL)
+    ((file_header*)this->mapping)->bits = this->bits;
 }
 
+long long my_bitset::capacity_bits() const{
+  long long result = (long long)this->capacity * my_bitset::block_size;
+  return ((result > my_bitset::max_bits) ? my_bitset::max_bits : result);
+}
+
+void my_bitset::reserve(const long long &size){
+  if(size < 0)
+    throw std::runtime_error("my_bitset::reserve: invalid_size");
+  if(size > my_bitset::max_bits)
+    throw std::length_error("my_bitset::reserve: size_too_large");
+  int needed = my_bitset::blocks_for(size);
+  if(needed > this->capacity) this->reallocate(needed);
+}
+
+void my_bitset::resize(const long long &size, const bool &value){
+  if(size < 0)
+    throw std::runtime_error("my_bitset::resize: invalid_size");
+
+  long long old_size = this->bits;
+  this->reserve(size);
+  this->set_size(size);
+  if(value && (size > old_size)) {
+    unsigned long long *first = this->arr + (old_size / my_bitset::block_size);
+    int offset = (int)(old_size % my_bitset::block_size);
+    *first |= (~0ULL >> offset);
+    if(first + 1 < this->arr + this->blocks)
+      memset(first + 1, 0xFF, (this->arr + this->blocks - first - 1) * sizeof(unsigned long long));
+    this->clear_tail();
+  }
+}
+
+void my_bitset::push_back(const bool &value){
+  this->append_bits((value ? 1ULL : 0ULL), 1);
+}
+
+void my_bitset::pop_back(){
+  if(this->bits == 0)
+    throw std::out_of_range("my_bitset::pop_back: empty_bitset");
+  this->set_size(this->bits - 1);
+}
+
+void my_bitset::append_bits(const unsigned long long &value, const int &length){
+  if((length < 0) || (length > my_bitset::block_size))
+    throw std::runtime_error("my_bitset::append_bits: invalid_length");
+  if(length == 0) return;
+  if(this->bits > my_bitset::max_bits - length)
+    throw std::overflow_error("my_bitset::append_bits: overflow_error");
+
+  // doubling the capacity keeps the appends amortized constant time
+  long long index = this->bits;
+  int needed = my_bitset::blocks_for(index + length);
+  if(needed > this->capacity) {
+    int grown = ((this->capacity > 0x3FFFFFFF) ? needed : (this->capacity * 2));
+    this->reallocate((grown > needed) ? grown : needed);
+  }
+  this->set_size(index + length);
+  my_bitset::store_bits(this->arr, index, length, value << (my_bitset::block_size - length));
+}
+
+void my_bitset::shrink_to_fit(){
+  if((this->mapping == NULL) && (this->capacity > this->blocks))
+    this->reallocate(this->blocks);
+}
+
+long long my_bitset::count() const{
+  return bitset_kernels::count_blocks(this->arr, this->blocks);
+}
+
+long long my_bitset::count_and(const my_bitset &_my_bitset) const{
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  return bitset_kernels::count_and_blocks(this->arr, _my_bitset.arr, common);
+}
+
+bool my_bitset::any() const{
+  for(int i = 0; i < this->blocks; ++i)
+    if(this->arr[i] != 0) return true;
+  return false;
+}
+
+bool my_bitset::none() const{
+  return !(this->any());
+}
+
+long long my_bitset::find_first() const{
+  return this->find_next_set(0);
+}
+
+// the first set bit after the given index
+long long my_bitset::find_next(const long long &index) const{
+  return this->find_next_set((index < 0) ? 0 : (index + 1));
+}
+
+// the number of zero bits before the first set bit, which
+// is the size of the bitset if no bit is set
+long long my_bitset::count_leading_zeros() const{
+  long long first = this->find_first();
+  return ((first < 0) ? this->bits : first);
+}
+
+long long my_bitset::find_next_set(const long long &from) const{
+  long long start = ((from < 0) ? 0 : from);
+  if(start >= this->bits) return -1;
+
+  // the bits before start are masked out of the first block
+  int block_index = (int)(start / my_bitset::block_size);
+  unsigned long long block = this->arr[block_index] & (~0ULL >> (start % my_bitset::block_size));
+  while(true){
+    if(block != 0)
+      return ((long long)block_index * my_bitset::block_size) + bit_ops::count_leading_zeros(block);
+    if(++block_index >= this->blocks)
+      return -1;
+    block = this->arr[block_index];
+  }
+}
+
+long long my_bitset::find_prev_set(const long long &from) const{
+  long long start = ((from >= this->bits) ? (this->bits - 1) : from);
+  if(start < 0) return -1;
+
+  // the bits after start are masked out of the first block, bit index
+  // i of a block is its (63 - i)-th bit, so the last set bit of a block
+  // is found by counting its trailing zeros
+  int block_index = (int)(start / my_bitset::block_size);
+  unsigned long long block = this->arr[block_index] &
+      ~((~0ULL >> (start % my_bitset::block_size)) >> 1);
+  while(true){
+    if(block != 0)
+      return ((long long)block_index * my_bitset::block_size) +
+          (my_bitset::block_size - 1 - bit_ops::count_trailing_zeros(block));
+    if(--block_index < 0)
+      return -1;
+    block = this->arr[block_index];
+  }
+}
+
+template<typename function>
+void my_bitset::for_each_set_bit(function f) const{
+  for(int i = 0; i < this->blocks; ++i){
+    unsigned long long block = this->arr[i];
+    long long base = (long long)i * my_bitset::block_size;
+    while(block != 0){
+      int bit = bit_ops::count_leading_zeros(block);
+      f(base + bit);
+      block ^= (1ULL << (my_bitset::block_size - 1 - bit));
+    }
+  }
+}
+
+// the end iterator holds index size(), decrementing it
+// gives the last set bit
+my_bitset::set_bit_iterator::set_bit_iterator(){
+  this->owner = NULL;
+  this->index = 0;
+}
+
+my_bitset::set_bit_iterator::set_bit_iterator(const my_bitset *owner, const long long &index){
+  this->owner = owner;
+  this->index = index;
+}
+
+long long my_bitset::set_bit_iterator::operator * () const{
+  return this->index;
+}
+
+my_bitset::set_bit_iterator& my_bitset::set_bit_iterator::operator ++ (){
+  long long next = this->owner->find_next_set(this->index + 1);
+  this->index = ((next < 0) ? this->owner->bits : next);
+  return (*this);
+}
+
+my_bitset::set_bit_iterator my_bitset::set_bit_iterator::operator ++ (int){
+  set_bit_iterator it(*this);
+  ++(*this);
+  return it;
+}
+
+my_bitset::set_bit_iterator& my_bitset::set_bit_iterator::operator -- (){
+  this->index = this->owner->find_prev_set(this->index - 1);
+  return (*this);
+}
+
+my_bitset::set_bit_iterator my_bitset::set_bit_iterator::operator -- (int){
+  set_bit_iterator it(*this);
+  --(*this);
+  return it;
+}
+
+bool my_bitset::set_bit_iterator::operator == (const set_bit_iterator &it) const{
+  return (this->owner == it.owner) && (this->index == it.index);
+}
+
+bool my_bitset::set_bit_iterator::operator != (const set_bit_iterator &it) const{
+  return !(this->operator == (it));
+}
+
+my_bitset::set_bit_iterator my_bitset::begin_set_bits() const{
+  long long first = this->find_next_set(0);
+  return set_bit_iterator(this, ((first < 0) ? this->bits : first));
+}
+
+my_bitset::set_bit_iterator my_bitset::end_set_bits() const{
+  return set_bit_iterator(this, this->bits);
+}
+
+my_bitset::reverse_set_bit_iterator my_bitset::rbegin_set_bits() const{
+  return reverse_set_bit_iterator(this->end_set_bits());
+}
+
+my_bitset::reverse_set_bit_iterator my_bitset::rend_set_bits() const{
+  return reverse_set_bit_iterator(this->begin_set_bits());
+}
+
+// the binary operators produce a result of the same size as the calling
+// object, the passed object is zero extended if it is shorter, the
+// common blocks go through the vectorized kernels, the result storage is
+// written once and never zero filled first
 my_bitset my_bitset::operator & (const my_bitset &_my_bitset) const{
-  my_bitset result(this->words * my_bitset::word_size, 0);
-  for(int i = 0;i < this->words;++i)
-    result.arr[i] = this->arr[i] & _my_bitset.arr[i];
+  my_bitset result;
+  result.allocate(this->bits);
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  bitset_kernels::and_blocks(result.arr, this->arr, _my_bitset.arr, common);
+  if(common < this->blocks)
+    memset(result.arr + common, 0, (this->blocks - common) * sizeof(unsigned long long));
+  result.clear_tail();
   return result;
 }
 
 my_bitset my_bitset::operator | (const my_bitset &_my_bitset) const{
-  my_bitset result(this->words * my_bitset::word_size, 0);
-  for(int i = 0;i < this->words;++i)
-    result.arr[i] = this->arr[i] | _my_bitset.arr[i];
+  my_bitset result;
+  result.allocate(this->bits);
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  bitset_kernels::or_blocks(result.arr, this->arr, _my_bitset.arr, common);
+  if(common < this->blocks)
+    memcpy(result.arr + common, this->arr + common, (this->blocks - common) * sizeof(unsigned long long));
+  result.clear_tail();
   return result;
 }
 
 my_bitset my_bitset::operator ^ (const my_bitset &_my_bitset) const{
-  my_bitset result(this->words * my_bitset::word_size, 0);
-  for(int i = 0;i < this->words;++i)
-    result.arr[i] = this->arr[i] ^ _my_bitset.arr[i];
+  my_bitset result;
+  result.allocate(this->bits);
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  bitset_kernels::xor_blocks(result.arr, this->arr, _my_bitset.arr, common);
+  if(common < this->blocks)
+    memcpy(result.arr + common, this->arr + common, (this->blocks - common) * sizeof(unsigned long long));
+  result.clear_tail();
   return result;
 }
 
 my_bitset my_bitset::operator ~ () const{
-  my_bitset result(this->words * my_bitset::word_size, 0);
-  for(int i=0;i<this->words;++i)
-    result.arr[i] = ~(this->arr[i]);
+  my_bitset result;
+  result.allocate(this->bits);
+  bitset_kernels::not_blocks(result.arr, this->arr, this->blocks);
+  result.clear_tail();
   return result;
 }
 
-my_bitset my_bitset::operator << (const int &places) const{
+my_bitset& my_bitset::operator &= (const my_bitset &_my_bitset){
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  bitset_kernels::and_blocks(this->arr, this->arr, _my_bitset.arr, common);
+  if(common < this->blocks)
+    memset(this->arr + common, 0, (this->blocks - common) * sizeof(unsigned long long));
+  this->clear_tail();
+  return (*this);
+}
+
+my_bitset& my_bitset::operator |= (const my_bitset &_my_bitset){
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  bitset_kernels::or_blocks(this->arr, this->arr, _my_bitset.arr, common);
+  this->clear_tail();
+  return (*this);
+}
+
+my_bitset& my_bitset::operator ^= (const my_bitset &_my_bitset){
+  int common = ((this->blocks <= _my_bitset.blocks) ? this->blocks : _my_bitset.blocks);
+  bitset_kernels::xor_blocks(this->arr, this->arr, _my_bitset.arr, common);
+  this->clear_tail();
+  return (*this);
+}
+
+my_bitset& my_bitset::flip(){
+  bitset_kernels::not_blocks(this->arr, this->arr, this->blocks);
+  this->clear_tail();
+  return (*this);
+}
+
+my_bitset my_bitset::operator << (const long long &places) const{
   if(places < 0)
     return (*this)>>(places * -1);
 
-  int size = this->words * my_bitset::word_size;
-  my_bitset result(size, 0);
-  for(int i = 0; i < (size - places); ++i)
-    result.set(i, this->get(i + places));
+  my_bitset result(this->bits, 0);
+  my_bitset::shift_blocks_left(result.arr, this->arr, this->blocks, places);
   return result;
 }
 
-my_bitset my_bitset::operator >> (const int &places) const{
+my_bitset my_bitset::operator >> (const long long &places) const{
   if(places < 0)
     return (*this)<<(places * -1);
 
-  int size = this->words * my_bitset::word_size;
-  my_bitset result(size, 0);
-  for(int i = size - 1; i >= places; --i)
-    result.set(i, this->get(i - places));
+  my_bitset result(this->bits, 0);
+  my_bitset::shift_blocks_right(result.arr, this->arr, this->blocks, places);
+  if(result.blocks > 0) result.clear_tail();
   return result;
 }
 
-my_bitset my_bitset::rotate_left  (const int &places) const{
+my_bitset my_bitset::rotate_left  (const long long &places) const{
   if(places < 0)
     return this->rotate_right(places * -1);
 
-  int size = this->words * my_bitset::word_size;
-  int _places = places % size;
+  long long size = this->bits;
+  if(size == 0) return (*this);
+  long long _places = places % size;
 
-  unsigned char *temp_buffer = new unsigned char[this->words * 2];
-  memcpy(temp_buffer, this->arr, this->words);
-  memcpy(temp_buffer + this->words, this->arr, this->words);
-  my_bitset temp_bitset(temp_buffer, this->words * 2);
+  // the bits shifted out of the front are copied to the vacated end
   my_bitset result(size, 0);
-
-  for(int i = 0; i < size; ++i)
-    result.set(i, temp_bitset.get(i + _places));
+  my_bitset::shift_blocks_left(result.arr, this->arr, this->blocks, _places);
+  my_bitset::copy_bits(result.arr, size - _places, this->arr, this->blocks, 0, _places);
   return result;
 }
 
-my_bitset my_bitset::rotate_right (const int &places) const{
+my_bitset my_bitset::rotate_right (const long long &places) const{
   if(places < 0)
     return this->rotate_left(places * -1);
 
-  int size = this->words * my_bitset::word_size;
-  int _places = places % size;
+  long long size = this->bits;
+  if(size == 0) return (*this);
+  return this->rotate_left(size - (places % size));
+}
 
-  unsigned char *temp_buffer = new unsigned char[this->words * 2];
-  memcpy(temp_buffer, this->arr, this->words);
-  memcpy(temp_buffer + this->words, this->arr, this->words);
-  my_bitset temp_bitset(temp_buffer, this->words * 2);
-  my_bitset result(size, 0);
+my_bitset& my_bitset::operator <<= (const long long &places){
+  if(places < 0)
+    return (*this) >>= (places * -1);
 
-  for(int i = size - 1; i >= 0; --i)
-    result.set(i, temp_bitset.get(size + i - _places));
-  return result;
+  my_bitset::shift_blocks_left(this->arr, this->arr, this->blocks, places);
+  return (*this);
 }
 
-my_bitset my_bitset::pad_left (const int &places, const bool &value) const{
-  my_bitset result((this->words * my_bitset::word_size) + places, 0);
-  memcpy(result.arr + (result.words - this->words), this->arr, this->words);
-  if(value) memset(result.arr, 0xFF, (result.words - this->words));
+my_bitset& my_bitset::operator >>= (const long long &places){
+  if(places < 0)
+    return (*this) <<= (places * -1);
+
+  my_bitset::shift_blocks_right(this->arr, this->arr, this->blocks, places);
+  if(this->blocks > 0) this->clear_tail();
+  return (*this);
+}
+
+my_bitset& my_bitset::rotate_left_inplace (const long long &places){
+  if(places < 0)
+    return this->rotate_right_inplace(places * -1);
+
+  long long size = this->bits;
+  if(size == 0) return (*this);
+  long long _places = places % size;
+  if(_places == 0) return (*this);
+
+  // whole blocks rotation when everything is block aligned
+  if((_places % my_bitset::block_size == 0) && (size % my_bitset::block_size == 0)) {
+    std::rotate(this->arr, this->arr + (_places / my_bitset::block_size), this->arr + this->blocks);
+    return (*this);
+  }
+
+  // rotation by three reversals, (a b) -> (a' b')' = (b a)
+  this->reverse_bits(0, _places);
+  this->reverse_bits(_places, size);
+  this->reverse_bits(0, size);
+  return (*this);
+}
+
+my_bitset& my_bitset::rotate_right_inplace (const long long &places){
+  if(places < 0)
+    return this->rotate_left_inplace(places * -1);
+
+  long long size = this->bits;
+  if(size == 0) return (*this);
+  return this->rotate_left_inplace(size - (places % size));
+}
+
+my_bitset my_bitset::pad_left (const long long &places, const bool &value) const{
+  my_bitset result(this->bits + places, value);
+  my_bitset::copy_bits(result.arr, places, this->arr, this->blocks, 0, this->bits);
   return result;
 }
 
-my_bitset my_bitset::pad_right (const int &places, const bool &value) const{
-  my_bitset result((this->words * my_bitset::word_size) + places, 0);
-  memcpy(result.arr, this->arr, this->words);
-  if(value) memset(result.arr + this->words, 0xFF, (result.words - this->words));
+my_bitset my_bitset::pad_right (const long long &places, const bool &value) const{
+  my_bitset result(this->bits + places, value);
+  my_bitset::copy_bits(result.arr, 0, this->arr, this->blocks, 0, this->bits);
   return result;
 }
 
 my_bitset my_bitset::trim_left () const{
   int index = 0;
-  while((index < this->words) && (this->arr[index] == 0)) ++index;
-  my_bitset result((this->words - index) * my_bitset::word_size, 0);
-  memcpy(result.arr, this->arr + index, result.words);
-  return result;
+  int words = this->words_count();
+  while((index < words) && (this->get_word(index) == 0)) ++index;
+  return this->trim_left(index);
 }
 
 my_bitset my_bitset::trim_left (const int &words_count) const{
-  if(words_count > this->words)
+  if(words_count > this->words_count())
     throw std::out_of_range("my_bitset::trim_left: words_count_out_of_range");
   if(words_count < 0)
     throw std::out_of_range("my_bitset::trim_left: words_count_out_of_range");
 
-  int index = words_count;
-  my_bitset result((this->words - index) * my_bitset::word_size, 0);
-  memcpy(result.arr, this->arr + index, result.words);
+  long long removed = (long long)words_count * my_bitset::word_size;
+  if(removed > this->bits) removed = this->bits;
+
+  my_bitset result(this->bits - removed, 0);
+  my_bitset::copy_bits(result.arr, 0, this->arr, this->blocks, removed, result.bits);
   return result;
 }
 
 my_bitset my_bitset::trim_right () const{
-  int index = this->words - 1;
-  while((index >= 0) && (this->arr[index] == 0)) --index;
-  my_bitset result((index + 1) * my_bitset::word_size, 0);
-  memcpy(result.arr, this->arr, index + 1);
-  return result;
+  int index = this->words_count() - 1;
+  while((index >= 0) && (this->get_word(index) == 0)) --index;
+  return this->trim_right(this->words_count() - index - 1);
 }
 
 my_bitset my_bitset::trim_right (const int &words_count) const{
-  if(words_count > this->words)
+  if(words_count > this->words_count())
     throw std::out_of_range("my_bitset::trim_right: words_count_out_of_range");
   if(words_count < 0)
     throw std::out_of_range("my_bitset::trim_right: words_count_out_of_range");
 
-  int index = this->words - words_count - 1;
-  my_bitset result((index + 1) * my_bitset::word_size, 0);
-  memcpy(result.arr, this->arr, index + 1);
+  long long kept = ((words_count == 0) ? this->bits :
+      ((long long)(this->words_count() - words_count) * my_bitset::word_size));
+
+  my_bitset result(kept, 0);
+  my_bitset::copy_bits(result.arr, 0, this->arr, this->blocks, 0, kept);
   return result;
 }
 
@@ -350,27 +1320,38 @@ my_bitset my_bitset::trim_right (const int &words_count) const{
 // return  1 if _my_bitset1 < _my_bitset2
 // return 0 if _my_bitset1 == _my_bitset2
 int my_bitset::compare(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2){
-  int max_size = ((_my_bitset1.size() >= _my_bitset2.size()) ? _my_bitset1.size() : _my_bitset2.size());
-  my_bitset op1 = _my_bitset1.pad_left(max_size - _my_bitset1.size(), 0);
-  my_bitset op2 = _my_bitset2.pad_left(max_size - _my_bitset2.size(), 0);
-
-  int flag = 0;
-  for(int i = 0; (i < op1.words) && (flag == 0); ++i) {
-    if(op1.arr[i] > op2.arr[i]) flag = -1;
-    else if(op1.arr[i] < op2.arr[i]) flag = 1;
+  // the leading zeros do not change the arithmetic value, so after
+  // skipping them the longer operand is the larger one, operands of equal
+  // significant length are compared 64 bits at a time starting from their
+  // first set bits, with no padded copies of the operands
+  long long first1 = _my_bitset1.find_first();
+  long long first2 = _my_bitset2.find_first();
+  long long length1 = ((first1 < 0) ? 0 : (_my_bitset1.bits - first1));
+  long long length2 = ((first2 < 0) ? 0 : (_my_bitset2.bits - first2));
+
+  if(length1 != length2)
+    return ((length1 > length2) ? -1 : 1);
+
+  for(long long i = 0; i < length1; i += my_bitset::block_size){
+    unsigned long long op1 = my_bitset::load_bits(_my_bitset1.arr, _my_bitset1.blocks, first1 + i);
+    unsigned long long op2 = my_bitset::load_bits(_my_bitset2.arr, _my_bitset2.blocks, first2 + i);
+    if(op1 != op2) return ((op1 > op2) ? -1 : 1);
   }
 
-  return flag;
+  return 0;
 }
 
 bool my_bitset::operator == (const my_bitset &_my_bitset) const{
+  // same size bitsets are equal only if all their bits are equal
+  if(this->bits == _my_bitset.bits)
+    return bitset_kernels::equal_blocks(this->arr, _my_bitset.arr, this->blocks);
+
   int flag = my_bitset::compare((*this), _my_bitset);
   return (flag == 0);
 }
 
 bool my_bitset::operator != (const my_bitset &_my_bitset) const{
-  int flag = my_bitset::compare((*this), _my_bitset);
-  return (flag != 0);
+  return !(this->operator == (_my_bitset));
 }
 
 bool my_bitset::operator > (const my_bitset &_my_bitset) const{
@@ -394,42 +1375,46 @@ bool my_bitset::operator <= (const my_bitset &_my_bitset) const{
 }
 
 bool* my_bitset::dump(int &size) const{
-  size = this->words * my_bitset::word_size;
+  if(this->bits > 0x7FFFFFFFLL)
+    throw std::overflow_error("my_bitset::dump: overflow_error");
+  size = (int)this->bits;
   bool *dump = new bool[size];
-  for(int i=0; i<size; ++i)
-    dump[i] = this->get(i);
+  // a block at a time, without the bounds check of get
+  for(int i = 0; i < size; ++i)
+    dump[i] = ((this->arr[i / my_bitset::block_size] >> (my_bitset::block_size - 1 - (i % my_bitset::block_size))) & 1) != 0;
   return dump;
 }
 
 char* my_bitset::to_c_str() const{
-  char *buffer = new char[this->words + 1];
-  memcpy(buffer, this->arr, this->words);
-  buffer[this->words] = 0;
-  return buffer;
+  int size;
+  return this->to_c_str(size);
 }
 
 char* my_bitset::to_c_str(int &size) const{
-  size = this->words;
-  char *buffer = new char[this->words + 1];
-  memcpy(buffer, this->arr, this->words);
-  buffer[this->words] = 0;
+  size = this->words_count();
+  char *buffer = new char[size + 1];
+  for(int i = 0; i < size; ++i)
+    buffer[i] = (char)this->get_word(i);
+  buffer[size] = 0;
   return buffer;
 }
 
 std::string my_bitset::to_string() const{
-  if(this->words == 0) return "";
-  return std::string((char*)(this->arr), this->words);
+  int size = this->words_count();
+  if(size == 0) return "";
+
+  std::string str(size, 0);
+  for(int i = 0; i < size; ++i)
+    str[i] = (char)this->get_word(i);
+  return str;
 }
 
 unsigned long long my_bitset::to_ullong() const{
-  if((this->words * sizeof(unsigned char)) > sizeof(unsigned long long))
+  if(this->bits > my_bitset::block_size)
     throw std::overflow_error("my_bitset::to_ullong: overflow_error");
 
-  unsigned long long val = 0;
-  for(int i=0; i<this->words; ++i)
-    val <<= my_bitset::word_size, val |= this->arr[i];
-
-  return val;
+  if(this->bits == 0) return 0;
+  return this->arr[0] >> (my_bitset::block_size - this->bits);
 }
 
 #endif /* my_bitset_H_ */
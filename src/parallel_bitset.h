@@ -0,0 +1,438 @@
+#ifndef PARALLEL_BITSET_H_
+#define PARALLEL_BITSET_H_
+
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory.h>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+
+// a fixed set of worker threads that run the parts of one job at a time.
+// with n threads (the calling thread and n - 1 workers), part t runs on
+// thread t % n, the calling thread being thread 0, always the same thread
+// for the same part, so a job split the same way twice touches the same
+// memory from the same threads. run returns once all the parts are done,
+// concurrent calls run one after the other, a part must not call run on
+// the same pool.
+
+class bitset_thread_pool {
+private:
+  std::vector<std::thread> workers;
+  std::mutex lock;
+  std::mutex run_lock;
+  std::condition_variable start_signal;
+  std::condition_variable done_signal;
+  const std::function<void(int)> *job;
+  int parts;
+  int pending;
+  long long generation;
+  bool stopping;
+
+  void work(const int &index);
+
+public:
+  // threads counts the calling thread, threads - 1 workers are started
+  bitset_thread_pool(const int &threads);
+  ~bitset_thread_pool();
+
+  int size() const;
+  void run(const int &parts, const std::function<void(int)> &job);
+
+  // a pool of all the hardware threads, started on first use
+  bitset_thread_pool static & shared();
+};
+
+// multithreaded versions of the my_bitset bulk operations for bitsets of
+// hundreds of millions of bits, where one core cannot use all the memory
+// bandwidth. the blocks are split in one contiguous range per thread,
+// aligned to 4 KB pages, each range goes through the simd kernels on a
+// thread of the shared pool. a result that has to be allocated is left
+// untouched until the threads write it, so with a first touch numa policy
+// every range lives on the node of the thread that computes it, and later
+// calls with the same thread count find their operands there.
+//
+// below min_blocks_per_thread blocks per thread fewer threads are used,
+// down to the serial kernels on the calling thread for small bitsets.
+// threads = 0 uses one part per pool thread, more parts than pool threads
+// are run in turns. the results are the ones of the my_bitset operators:
+// the result takes the size of the left operand and the right one is zero
+// extended, the result may be one of the operands.
+
+class parallel_bitset {
+private:
+  const static int block_size = 64;
+  // 4 KB
+  const static int page_blocks = 512;
+  // 128 KB
+  const static int min_blocks_per_thread = 16384;
+  // the blocks scanned between two looks at the other threads, for the
+  // searches that stop early
+  const static int scan_blocks = 4096;
+
+  enum binary_op {
+    AND, OR, XOR
+  };
+
+  // splits [0, n) in parts of chunk blocks, the last one shorter
+  struct split {
+    int parts;
+    int chunk;
+  };
+
+  split static make_split(const int &threads, const int &n);
+  void static for_each_part(const split &_split, const int &n, const std::function<void(int, int)> &f);
+  // sets the size of result for all its blocks to be written, allocating
+  // without touching the memory when it is too small
+  void static prepare(my_bitset &result, const long long &size);
+  void static binary(const binary_op &op, const my_bitset &_my_bitset1, const my_bitset &_my_bitset2,
+      my_bitset &result, const int &threads);
+  // the lowest index in [0, n) for which find(from, to) over a range of
+  // indices returns a value >= 0, the ranges past a found one are skipped
+  int static find_lowest(const split &_split, const int &n, const std::function<int(int, int)> &find);
+
+public:
+  void static and_into(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, my_bitset &result,
+      const int &threads = 0);
+  void static or_into(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, my_bitset &result,
+      const int &threads = 0);
+  void static xor_into(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, my_bitset &result,
+      const int &threads = 0);
+  void static not_into(const my_bitset &_my_bitset, my_bitset &result, const int &threads = 0);
+  // result becomes size bits of the given value, with the storage first
+  // touched by the threads that later work on it
+  void static assign(my_bitset &result, const long long &size, const bool &value, const int &threads = 0);
+
+  long long static count(const my_bitset &_my_bitset, const int &threads = 0);
+  long long static count_and(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, const int &threads = 0);
+  // the first set bit, -1 if there is none
+  long long static find_first(const my_bitset &_my_bitset, const int &threads = 0);
+
+  // the same results as my_bitset::operator == and my_bitset::compare
+  bool static equal(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, const int &threads = 0);
+  int static compare(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, const int &threads = 0);
+};
+
+///////////////////////////////////////
+
+bitset_thread_pool::bitset_thread_pool(const int &threads) :
+    job(NULL), parts(0), pending(0), generation(0), stopping(false) {
+  for(int i = 1; i < threads; ++i)
+    this->workers.push_back(std::thread(&bitset_thread_pool::work, this, i - 1));
+}
+
+bitset_thread_pool::~bitset_thread_pool(){
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->stopping = true;
+  }
+  this->start_signal.notify_all();
+  for(size_t i = 0; i < this->workers.size(); ++i)
+    this->workers[i].join();
+}
+
+void bitset_thread_pool::work(const int &index){
+  long long seen = 0;
+  std::unique_lock<std::mutex> guard(this->lock);
+  while(true){
+    this->start_signal.wait(guard, [this, &seen](){ return this->stopping || (this->generation != seen); });
+    if(this->stopping) return;
+    seen = this->generation;
+    if(index + 1 >= this->parts) continue;
+
+    const std::function<void(int)> *current = this->job;
+    int count = this->parts;
+    guard.unlock();
+    for(int part = index + 1; part < count; part += this->size())
+      (*current)(part);
+    guard.lock();
+    if(--this->pending == 0) this->done_signal.notify_one();
+  }
+}
+
+int bitset_thread_pool::size() const{
+  return (int)this->workers.size() + 1;
+}
+
+void bitset_thread_pool::run(const int &parts, const std::function<void(int)> &job){
+  if((parts <= 1) || this->workers.empty()) {
+    for(int part = 0; part < parts; ++part)
+      job(part);
+    return;
+  }
+
+  std::lock_guard<std::mutex> running(this->run_lock);
+  {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->job = &job;
+    this->parts = parts;
+    this->pending = (((parts - 1) < (int)this->workers.size()) ? (parts - 1) : (int)this->workers.size());
+    ++this->generation;
+  }
+  this->start_signal.notify_all();
+  for(int part = 0; part < parts; part += this->size())
+    job(part);
+
+  std::unique_lock<std::mutex> guard(this->lock);
+  this->done_signal.wait(guard, [this](){ return this->pending == 0; });
+  this->job = NULL;
+}
+
+bitset_thread_pool& bitset_thread_pool::shared(){
+  static bitset_thread_pool instance((std::thread::hardware_concurrency() == 0) ? 1 :
+      (int)std::thread::hardware_concurrency());
+  return instance;
+}
+
+///////////////////////////////////////
+
+const int parallel_bitset::block_size;
+const int parallel_bitset::page_blocks;
+const int parallel_bitset::min_blocks_per_thread;
+const int parallel_bitset::scan_blocks;
+
+parallel_bitset::split parallel_bitset::make_split(const int &threads, const int &n){
+  int count = ((threads <= 0) ? bitset_thread_pool::shared().size() : threads);
+  if(count > n / parallel_bitset::min_blocks_per_thread) count = n / parallel_bitset::min_blocks_per_thread;
+
+  split result;
+  if(count <= 1) {
+    result.parts = ((n > 0) ? 1 : 0);
+    result.chunk = n;
+    return result;
+  }
+  int chunk = (n + count - 1) / count;
+  chunk = ((chunk + parallel_bitset::page_blocks - 1) / parallel_bitset::page_blocks) * parallel_bitset::page_blocks;
+  result.chunk = chunk;
+  result.parts = (n + chunk - 1) / chunk;
+  return result;
+}
+
+void parallel_bitset::for_each_part(const split &_split, const int &n, const std::function<void(int, int)> &f){
+  std::function<void(int)> part = [&_split, &n, &f](int t){
+    int from = t * _split.chunk;
+    int to = ((n - from < _split.chunk) ? n : from + _split.chunk);
+    f(from, to);
+  };
+  bitset_thread_pool::shared().run(_split.parts, part);
+}
+
+int parallel_bitset::find_lowest(const split &_split, const int &n, const std::function<int(int, int)> &find){
+  // best is the lowest part that found something, the parts above it stop
+  std::atomic<int> best(_split.parts);
+  std::vector<int> found(_split.parts, -1);
+  std::function<void(int)> part = [&](int t){
+    int from = t * _split.chunk;
+    int to = ((n - from < _split.chunk) ? n : from + _split.chunk);
+    for(int i = from; (i < to) && (best.load(std::memory_order_relaxed) > t); i += parallel_bitset::scan_blocks){
+      int result = find(i, ((to - i < parallel_bitset::scan_blocks) ? to : i + parallel_bitset::scan_blocks));
+      if(result >= 0) {
+        found[t] = result;
+        int current = best.load();
+        while((current > t) && !best.compare_exchange_weak(current, t)) { }
+        return;
+      }
+    }
+  };
+  bitset_thread_pool::shared().run(_split.parts, part);
+
+  int lowest = best.load();
+  return ((lowest < _split.parts) ? found[lowest] : -1);
+}
+
+void parallel_bitset::prepare(my_bitset &result, const long long &size){
+  int _blocks = my_bitset::blocks_for(size);
+  if(_blocks > result.capacity) {
+    result.release();
+    result.allocate(size);
+    return;
+  }
+  result.bits = size;
+  result.blocks = _blocks;
+  if(result.mapping != NULL)
+    ((my_bitset::file_header*)result.mapping)->bits = size;
+}
+
+void parallel_bitset::binary(const binary_op &op, const my_bitset &_my_bitset1, const my_bitset &_my_bitset2,
+    my_bitset &result, const int &threads){
+  // the right operand would be freed before being read
+  if((&result == &_my_bitset2) && (&result != &_my_bitset1) &&
+      (my_bitset::blocks_for(_my_bitset1.bits) > result.capacity)) {
+    my_bitset temp;
+    parallel_bitset::binary(op, _my_bitset1, _my_bitset2, temp, threads);
+    result = std::move(temp);
+    return;
+  }
+
+  const unsigned long long *a = _my_bitset1.arr;
+  const unsigned long long *b = _my_bitset2.arr;
+  int n = _my_bitset1.blocks;
+  int common = ((n <= _my_bitset2.blocks) ? n : _my_bitset2.blocks);
+  parallel_bitset::prepare(result, _my_bitset1.bits);
+  unsigned long long *dst = result.arr;
+
+  parallel_bitset::for_each_part(parallel_bitset::make_split(threads, n), n, [&](int from, int to){
+    int middle = ((common < from) ? from : ((common > to) ? to : common));
+    if(op == AND) bitset_kernels::and_blocks(dst + from, a + from, b + from, middle - from);
+    else if(op == OR) bitset_kernels::or_blocks(dst + from, a + from, b + from, middle - from);
+    else bitset_kernels::xor_blocks(dst + from, a + from, b + from, middle - from);
+
+    // past the right operand, zeros for and, the left operand otherwise
+    if(middle < to) {
+      if(op == AND) memset(dst + middle, 0, (to - middle) * sizeof(unsigned long long));
+      else if(dst != a) memcpy(dst + middle, a + middle, (to - middle) * sizeof(unsigned long long));
+    }
+  });
+  result.clear_tail();
+}
+
+void parallel_bitset::and_into(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, my_bitset &result,
+    const int &threads){
+  parallel_bitset::binary(AND, _my_bitset1, _my_bitset2, result, threads);
+}
+
+void parallel_bitset::or_into(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, my_bitset &result,
+    const int &threads){
+  parallel_bitset::binary(OR, _my_bitset1, _my_bitset2, result, threads);
+}
+
+void parallel_bitset::xor_into(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, my_bitset &result,
+    const int &threads){
+  parallel_bitset::binary(XOR, _my_bitset1, _my_bitset2, result, threads);
+}
+
+void parallel_bitset::not_into(const my_bitset &_my_bitset, my_bitset &result, const int &threads){
+  const unsigned long long *a = _my_bitset.arr;
+  int n = _my_bitset.blocks;
+  parallel_bitset::prepare(result, _my_bitset.bits);
+  unsigned long long *dst = result.arr;
+
+  parallel_bitset::for_each_part(parallel_bitset::make_split(threads, n), n, [&](int from, int to){
+    bitset_kernels::not_blocks(dst + from, a + from, to - from);
+  });
+  result.clear_tail();
+}
+
+void parallel_bitset::assign(my_bitset &result, const long long &size, const bool &value, const int &threads){
+  if(size < 0)
+    throw std::runtime_error("parallel_bitset::assign: invalid_size");
+  if(size > my_bitset::max_bits)
+    throw std::length_error("parallel_bitset::assign: size_too_large");
+
+  parallel_bitset::prepare(result, size);
+  unsigned long long *dst = result.arr;
+  int n = result.blocks;
+  parallel_bitset::for_each_part(parallel_bitset::make_split(threads, n), n, [&](int from, int to){
+    memset(dst + from, (value ? 0xFF : 0), (to - from) * sizeof(unsigned long long));
+  });
+  result.clear_tail();
+}
+
+long long parallel_bitset::count(const my_bitset &_my_bitset, const int &threads){
+  const unsigned long long *a = _my_bitset.arr;
+  int n = _my_bitset.blocks;
+  split _split = parallel_bitset::make_split(threads, n);
+  if(_split.parts <= 1) return bitset_kernels::count_blocks(a, n);
+
+  // one slot per cache line, the threads do not share lines
+  std::vector<long long> counts(_split.parts * 8, 0);
+  parallel_bitset::for_each_part(_split, n, [&](int from, int to){
+    counts[(from / _split.chunk) * 8] = bitset_kernels::count_blocks(a + from, to - from);
+  });
+
+  long long result = 0;
+  for(int t = 0; t < _split.parts; ++t)
+    result += counts[t * 8];
+  return result;
+}
+
+long long parallel_bitset::count_and(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2,
+    const int &threads){
+  const unsigned long long *a = _my_bitset1.arr;
+  const unsigned long long *b = _my_bitset2.arr;
+  int n = ((_my_bitset1.blocks <= _my_bitset2.blocks) ? _my_bitset1.blocks : _my_bitset2.blocks);
+  split _split = parallel_bitset::make_split(threads, n);
+  if(_split.parts <= 1) return bitset_kernels::count_and_blocks(a, b, n);
+
+  std::vector<long long> counts(_split.parts * 8, 0);
+  parallel_bitset::for_each_part(_split, n, [&](int from, int to){
+    counts[(from / _split.chunk) * 8] = bitset_kernels::count_and_blocks(a + from, b + from, to - from);
+  });
+
+  long long result = 0;
+  for(int t = 0; t < _split.parts; ++t)
+    result += counts[t * 8];
+  return result;
+}
+
+long long parallel_bitset::find_first(const my_bitset &_my_bitset, const int &threads){
+  const unsigned long long *a = _my_bitset.arr;
+  int n = _my_bitset.blocks;
+  split _split = parallel_bitset::make_split(threads, n);
+  if(_split.parts <= 1) return _my_bitset.find_first();
+
+  // the first non zero block, the bit index may not fit an int
+  int block = parallel_bitset::find_lowest(_split, n, [a](int from, int to){
+    for(int i = from; i < to; ++i)
+      if(a[i] != 0) return i;
+    return -1;
+  });
+  if(block < 0) return -1;
+  return ((long long)block * parallel_bitset::block_size) + bit_ops::count_leading_zeros(a[block]);
+}
+
+bool parallel_bitset::equal(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, const int &threads){
+  if(_my_bitset1.bits != _my_bitset2.bits)
+    return (parallel_bitset::compare(_my_bitset1, _my_bitset2, threads) == 0);
+
+  const unsigned long long *a = _my_bitset1.arr;
+  const unsigned long long *b = _my_bitset2.arr;
+  int n = _my_bitset1.blocks;
+  split _split = parallel_bitset::make_split(threads, n);
+  if(_split.parts <= 1) return bitset_kernels::equal_blocks(a, b, n);
+
+  return (parallel_bitset::find_lowest(_split, n, [a, b](int from, int to){
+    return (bitset_kernels::equal_blocks(a + from, b + from, to - from) ? -1 : from);
+  }) < 0);
+}
+
+int parallel_bitset::compare(const my_bitset &_my_bitset1, const my_bitset &_my_bitset2, const int &threads){
+  // as my_bitset::compare, the significant bits of the two operands are
+  // compared 64 at a time, the windows are split over the threads
+  long long first1 = parallel_bitset::find_first(_my_bitset1, threads);
+  long long first2 = parallel_bitset::find_first(_my_bitset2, threads);
+  long long length1 = ((first1 < 0) ? 0 : (_my_bitset1.bits - first1));
+  long long length2 = ((first2 < 0) ? 0 : (_my_bitset2.bits - first2));
+
+  if(length1 != length2)
+    return ((length1 > length2) ? -1 : 1);
+
+  const unsigned long long *a = _my_bitset1.arr;
+  const unsigned long long *b = _my_bitset2.arr;
+  int blocks1 = _my_bitset1.blocks, blocks2 = _my_bitset2.blocks;
+  int windows = (int)((length1 + parallel_bitset::block_size - 1) / parallel_bitset::block_size);
+  std::function<int(int, int)> find = [=](int from, int to){
+    for(int i = from; i < to; ++i){
+      unsigned long long op1 = my_bitset::load_bits(a, blocks1, first1 + (long long)i * parallel_bitset::block_size);
+      unsigned long long op2 = my_bitset::load_bits(b, blocks2, first2 + (long long)i * parallel_bitset::block_size);
+      if(op1 != op2) return i;
+    }
+    return -1;
+  };
+
+  split _split = parallel_bitset::make_split(threads, windows);
+  int window = ((_split.parts <= 1) ? find(0, windows) : parallel_bitset::find_lowest(_split, windows, find));
+  if(window < 0) return 0;
+
+  unsigned long long op1 = my_bitset::load_bits(a, blocks1, first1 + (long long)window * parallel_bitset::block_size);
+  unsigned long long op2 = my_bitset::load_bits(b, blocks2, first2 + (long long)window * parallel_bitset::block_size);
+  return ((op1 > op2) ? -1 : 1);
+}
+
+#endif /* PARALLEL_BITSET_H_ */
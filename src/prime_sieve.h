@@ -0,0 +1,301 @@
+#ifndef PRIME_SIEVE_H_
+#define PRIME_SIEVE_H_
+
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "my_bitset.h"
+#include "worker_threads.h"
+
+// segmented sieve of eratosthenes over [lo, hi). only the odd numbers are
+// kept, one bit each, in my_bitset segments of 32 KB (the size of a level
+// 1 data cache), so the range is never held in memory at once, a segment
+// covers 524288 numbers.
+//
+// a segment does not start from all ones but from a copy of a precomputed
+// wheel pattern with the multiples of 3, 5, 7, 11 and 13 already crossed
+// off (it repeats every 15015 odd numbers), a funnel shifted copy of
+// words, then only the primes from 17 to sqrt(hi) cross off their odd
+// multiples, each one keeps its next multiple from segment to segment.
+//
+// the primes come in increasing order through a callback. the segments can
+// be sieved ahead by worker threads (threads = 0 for one per core), their
+// primes are still handed to the callback by the calling thread, in order.
+// small_primes gives the table of primes for trial division (big_integer
+// factoring, rns bases).
+
+class prime_sieve {
+private:
+  // the odd numbers of a segment
+  const static int segment_bits = 262144;
+  // the odd numbers of a period of the wheel, 3 * 5 * 7 * 11 * 13
+  const static int wheel_bits = 15015;
+  // the consecutive segments a thread sieves before the results are
+  // handed to the callback
+  const static int segments_per_task = 8;
+  const static unsigned long long max_value = (1ULL << 62);
+
+  struct range {
+    // the first odd number of the first segment
+    unsigned long long first;
+    unsigned long long hi;
+    long long segments;
+    // the sieving primes, 17 to sqrt(hi)
+    std::vector<unsigned int> primes;
+  };
+
+  const std::vector<unsigned long long> static & wheel();
+  // the tasks of segments_per_task segments covering the range, the
+  // threads beyond that would have nothing to sieve
+  long long static tasks(const long long &segments);
+  void static prepare(range &_range, const unsigned long long &lo, const unsigned long long &hi);
+  void static start(const range &_range, const long long &segment, std::vector<unsigned long long> &next);
+  void static sieve(const range &_range, const long long &segment, my_bitset &bits,
+      std::vector<unsigned long long> &next);
+  void static sieve_task(const range &_range, const long long &first, const long long &last,
+      std::vector<my_bitset> &results);
+  void static count_task(const range &_range, const long long &first, const long long &last,
+      unsigned long long &result);
+
+public:
+  // calls f(p) for every prime lo <= p < hi in increasing order
+  template<typename function>
+  void static for_each_prime(const unsigned long long &lo, const unsigned long long &hi, function f,
+      const int &threads = 1);
+  unsigned long long static count_primes(const unsigned long long &lo, const unsigned long long &hi,
+      const int &threads = 1);
+  std::vector<unsigned long long> static primes(const unsigned long long &lo, const unsigned long long &hi,
+      const int &threads = 1);
+  // the primes up to limit (included)
+  std::vector<unsigned int> static small_primes(const unsigned int &limit);
+};
+
+///////////////////////////////////////
+
+const int prime_sieve::segment_bits;
+const int prime_sieve::wheel_bits;
+const int prime_sieve::segments_per_task;
+const unsigned long long prime_sieve::max_value;
+
+// bit i (in the my_bitset order) is set when the odd number 2 * (i % 15015)
+// + 1 has no factor 3 to 13, long enough to copy a whole segment starting
+// anywhere in the first period
+const std::vector<unsigned long long>& prime_sieve::wheel(){
+  static const std::vector<unsigned long long> pattern = [](){
+    int bits = prime_sieve::wheel_bits + prime_sieve::segment_bits + 128;
+    std::vector<unsigned long long> result((bits + 63) / 64, 0);
+    for(int i = 0; i < bits; ++i){
+      unsigned int n = 2 * (i % prime_sieve::wheel_bits) + 1;
+      if((n % 3 != 0) && (n % 5 != 0) && (n % 7 != 0) && (n % 11 != 0) && (n % 13 != 0))
+        result[i / 64] |= 1ULL << (63 - (i % 64));
+    }
+    return result;
+  }();
+  return pattern;
+}
+
+void prime_sieve::prepare(range &_range, const unsigned long long &lo, const unsigned long long &hi){
+  if(hi > prime_sieve::max_value)
+    throw std::overflow_error("prime_sieve::prepare: overflow_error");
+
+  unsigned long long first = ((lo < 17) ? 17 : lo);
+  first |= 1;
+  _range.first = first;
+  _range.hi = hi;
+  _range.segments = ((hi <= first) ? 0 :
+      (long long)(((hi - first + 1) / 2 + prime_sieve::segment_bits - 1) / prime_sieve::segment_bits));
+
+  _range.primes.clear();
+  if(_range.segments == 0) return;
+
+  // the sieving primes come from a smaller sieve, down to a range
+  // with none of them
+  unsigned long long root = 1;
+  while((root + 1) * (root + 1) < hi) ++root;
+  if(root >= 17)
+    prime_sieve::for_each_prime(17, root + 1, [&_range](unsigned long long p){
+      _range.primes.push_back((unsigned int)p);
+    });
+}
+
+// the next odd multiple to cross off of every sieving prime, from the
+// start of the given segment
+void prime_sieve::start(const range &_range, const long long &segment, std::vector<unsigned long long> &next){
+  unsigned long long low = _range.first + 2ULL * prime_sieve::segment_bits * segment;
+  next.resize(_range.primes.size());
+  for(size_t k = 0; k < _range.primes.size(); ++k){
+    unsigned long long p = _range.primes[k];
+    unsigned long long m = ((low + p - 1) / p) * p;
+    if(m < p * p) m = p * p;
+    if((m & 1) == 0) m += p;
+    next[k] = m;
+  }
+}
+
+void prime_sieve::sieve(const range &_range, const long long &segment, my_bitset &bits,
+    std::vector<unsigned long long> &next){
+  unsigned long long low = _range.first + 2ULL * prime_sieve::segment_bits * segment;
+  unsigned long long odd_count = (_range.hi - low + 1) / 2;
+  int size = ((odd_count < (unsigned long long)prime_sieve::segment_bits) ?
+      (int)odd_count : prime_sieve::segment_bits);
+
+  // the storage is kept from a segment to the next, only the size of the
+  // last one changes
+  bits.resize(size, false);
+  unsigned long long *words = bits.data();
+  int blocks = bits.blocks_count();
+
+  // the wheel copy
+  int offset = (int)(((low - 1) / 2) % prime_sieve::wheel_bits);
+  const unsigned long long *pattern = prime_sieve::wheel().data() + (offset / 64);
+  int shift = offset % 64;
+  if(shift == 0) {
+    memcpy(words, pattern, blocks * sizeof(unsigned long long));
+  }
+  else {
+    for(int i = 0; i < blocks; ++i)
+      words[i] = (pattern[i] << shift) | (pattern[i + 1] >> (64 - shift));
+  }
+  if(size % 64 != 0)
+    words[blocks - 1] &= ~(~0ULL >> (size % 64));
+
+  // the index of an odd multiple m is (m - low) / 2, the next odd
+  // multiple is 2p further, p bits further
+  unsigned long long high = low + 2ULL * size;
+  for(size_t k = 0; k < _range.primes.size(); ++k){
+    unsigned long long m = next[k];
+    if(m >= high) continue;
+    unsigned long long p = _range.primes[k];
+    unsigned long long index = (m - low) >> 1;
+    for(; index < (unsigned long long)size; index += p)
+      words[index >> 6] &= ~(1ULL << (63 - (index & 63)));
+    next[k] = low + 2 * index;
+  }
+}
+
+void prime_sieve::sieve_task(const range &_range, const long long &first, const long long &last,
+    std::vector<my_bitset> &results){
+  std::vector<unsigned long long> next;
+  prime_sieve::start(_range, first, next);
+  for(long long s = first; s < last; ++s)
+    prime_sieve::sieve(_range, s, results[s - first], next);
+}
+
+void prime_sieve::count_task(const range &_range, const long long &first, const long long &last,
+    unsigned long long &result){
+  my_bitset bits;
+  bits.reserve(prime_sieve::segment_bits);
+  std::vector<unsigned long long> next;
+  prime_sieve::start(_range, first, next);
+  result = 0;
+  for(long long s = first; s < last; ++s){
+    prime_sieve::sieve(_range, s, bits, next);
+    result += bits.count();
+  }
+}
+
+long long prime_sieve::tasks(const long long &segments){
+  return (segments + prime_sieve::segments_per_task - 1) / prime_sieve::segments_per_task;
+}
+
+template<typename function>
+void prime_sieve::for_each_prime(const unsigned long long &lo, const unsigned long long &hi, function f,
+    const int &threads){
+  // the primes of the wheel and 2 are crossed off in the segments
+  const unsigned int small[6] = {2, 3, 5, 7, 11, 13};
+  for(int i = 0; i < 6; ++i)
+    if((small[i] >= lo) && (small[i] < hi)) f((unsigned long long)small[i]);
+
+  range _range;
+  prime_sieve::prepare(_range, lo, hi);
+  if(_range.segments == 0) return;
+
+  int count = worker_threads::count(threads, prime_sieve::tasks(_range.segments));
+  if(count == 1) {
+    std::vector<my_bitset> bits(1);
+    std::vector<unsigned long long> next;
+    prime_sieve::start(_range, 0, next);
+    for(long long s = 0; s < _range.segments; ++s){
+      prime_sieve::sieve(_range, s, bits[0], next);
+      unsigned long long low = _range.first + 2ULL * prime_sieve::segment_bits * s;
+      bits[0].for_each_set_bit([&f, &low](int index){ f(low + 2ULL * index); });
+    }
+    return;
+  }
+
+  // every round, each thread sieves a task of consecutive segments into its
+  // own bitsets, then the calling thread walks them in order
+  std::vector<std::vector<my_bitset> > tasks(count, std::vector<my_bitset>(prime_sieve::segments_per_task));
+  long long round_segments = (long long)count * prime_sieve::segments_per_task;
+  for(long long round = 0; round < _range.segments; round += round_segments){
+    std::vector<std::thread> workers;
+    for(int t = 0; t < count; ++t){
+      long long first = round + (long long)t * prime_sieve::segments_per_task;
+      long long last = std::min(_range.segments, first + prime_sieve::segments_per_task);
+      if(first >= last) break;
+      workers.push_back(std::thread(prime_sieve::sieve_task, std::cref(_range), first, last, std::ref(tasks[t])));
+    }
+    for(size_t t = 0; t < workers.size(); ++t)
+      workers[t].join();
+
+    for(size_t t = 0; t < workers.size(); ++t){
+      long long first = round + (long long)t * prime_sieve::segments_per_task;
+      long long last = std::min(_range.segments, first + prime_sieve::segments_per_task);
+      for(long long s = first; s < last; ++s){
+        unsigned long long low = _range.first + 2ULL * prime_sieve::segment_bits * s;
+        tasks[t][s - first].for_each_set_bit([&f, &low](int index){ f(low + 2ULL * index); });
+      }
+    }
+  }
+}
+
+unsigned long long prime_sieve::count_primes(const unsigned long long &lo, const unsigned long long &hi,
+    const int &threads){
+  unsigned long long result = 0;
+  const unsigned int small[6] = {2, 3, 5, 7, 11, 13};
+  for(int i = 0; i < 6; ++i)
+    if((small[i] >= lo) && (small[i] < hi)) ++result;
+
+  range _range;
+  prime_sieve::prepare(_range, lo, hi);
+  if(_range.segments == 0) return result;
+
+  // no order to keep, every thread takes one contiguous share
+  int count = worker_threads::count(threads, prime_sieve::tasks(_range.segments));
+  std::vector<unsigned long long> counts(count, 0);
+  std::vector<std::thread> workers;
+  long long share = (_range.segments + count - 1) / count;
+  for(int t = 1; t < count; ++t){
+    long long first = t * share;
+    long long last = std::min(_range.segments, first + share);
+    if(first >= last) break;
+    workers.push_back(std::thread(prime_sieve::count_task, std::cref(_range), first, last, std::ref(counts[t])));
+  }
+  prime_sieve::count_task(_range, 0, std::min(_range.segments, share), counts[0]);
+  for(size_t t = 0; t < workers.size(); ++t)
+    workers[t].join();
+
+  for(int t = 0; t < count; ++t)
+    result += counts[t];
+  return result;
+}
+
+std::vector<unsigned long long> prime_sieve::primes(const unsigned long long &lo, const unsigned long long &hi,
+    const int &threads){
+  std::vector<unsigned long long> result;
+  prime_sieve::for_each_prime(lo, hi, [&result](unsigned long long p){ result.push_back(p); }, threads);
+  return result;
+}
+
+std::vector<unsigned int> prime_sieve::small_primes(const unsigned int &limit){
+  std::vector<unsigned int> result;
+  prime_sieve::for_each_prime(0, (unsigned long long)limit + 1,
+      [&result](unsigned long long p){ result.push_back((unsigned int)p); });
+  return result;
+}
+
+#endif /* PRIME_SIEVE_H_ */
@@ -1,12 +1,48 @@
 #ifndef RBTREE_H_
 #define RBTREE_H_
 
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <sstream>
 using namespace std;
 
 // require c++11
+// an ordered map from Key to Value, the pair is stored inline in the node
+// and the nodes come from Allocator (rebound to the node type). keys are
+// ordered by Compare, two keys are the same key when neither is less than
+// the other. when Compare has an is_transparent member type (as
+// std::less<void>) the lookups also take any type it can compare with a
+// key, without building a Key.
+// the nodes never move, an iterator stays valid until its own node is
+// erased, an erase relinks the nodes rather than moving values between
+// them.
+// the tree owns a pool of nodes, it takes slabs of nodes from the
+// allocator (64 nodes first, each slab twice as large as the one before,
+// up to 65536) and hands them out one at a time, an erased node goes to a
+// free list and is the next one handed out, so churn reuses the same
+// memory. clear gives back whole slabs, with no walk over the nodes when
+// the pairs are trivially destructible.
+// every node also keeps the size of its subtree, kept up to date by the
+// rotations, the leaf insertion and the node erasure, so the k-th key
+// (select), the number of keys less than a key (rank) and the number of
+// keys in a range take one walk down the tree, O(log n).
+template<typename Key, typename Value, typename Compare = std::less<Key>,
+    typename Allocator = std::allocator<std::pair<const Key, Value> > >
 class rbtree {
+public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef std::pair<const Key, Value> value_type;
+  typedef Compare key_compare;
+  typedef Allocator allocator_type;
+  typedef std::size_t size_type;
+
 private:
   enum color {
     RED, BLACK, DOUBLE_BLACK
@@ -14,21 +50,57 @@ private:
 
   class node {
   public:
-    int v;
+    value_type v;
     rbtree::color c;
     rbtree::node* p;
     rbtree::node* l;
     rbtree::node* r;
+    // the number of nodes in the subtree of this node
+    size_type s;
 
-    node();
-    node(int);
-    ~node();
+    template<typename... Args>
+    node(Args&&... args);
     string to_string();
-    string int_to_string(const int &v);
+    string key_to_string(const Key &k);
     string color_to_string(const rbtree::color &c);
   };
 
+  typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node> node_allocator;
+  typedef std::allocator_traits<node_allocator> node_traits;
+
+  struct slab {
+    rbtree::node* nodes;
+    size_type size;
+  };
+  // what a free node holds instead of a node
+  struct free_node {
+    free_node* next;
+  };
+
+  const static size_type min_slab_nodes = 64;
+  const static size_type max_slab_nodes = 65536;
+
   rbtree::node* root;
+  size_type count;
+  Compare less;
+  node_allocator alloc;
+  std::vector<slab> slabs;
+  // the part of the last slab never handed out
+  rbtree::node* slab_next;
+  rbtree::node* slab_end;
+  free_node* free_nodes;
+
+  // true when the lookups may take other types than Key
+  template<typename K, typename C = Compare, typename = void>
+  struct transparent : std::false_type { };
+  template<typename K, typename C>
+  struct transparent<K, C, typename std::conditional<true, void, typename C::is_transparent>::type> : std::true_type { };
+
+  void add_slab();
+  void release_slabs();
+  template<typename... Args>
+  rbtree::node* create_node(Args&&... args);
+  void destroy_node(rbtree::node* n);
 
   // helper functions
   rbtree::color get_color(rbtree::node* n);
@@ -36,80 +108,261 @@ private:
   rbtree::node* get_sibling(rbtree::node* parent, rbtree::node* n);
   rbtree::node* get_uncle(rbtree::node* n);
   rbtree::node* get_grand_parent(rbtree::node* n);
+  rbtree::node static * next_node(rbtree::node* n);
+  rbtree::node static * prev_node(rbtree::node* n);
+  rbtree::node* first_node() const;
+  rbtree::node* last_node() const;
+  size_type static get_size(rbtree::node* n);
+  // adds delta to the sizes of n and of all its ancestors
+  void static update_sizes(rbtree::node* n, const long long &delta);
 
   rbtree::node* start_rotation(rbtree::node* top, rbtree::node* mid, rbtree::node* bottom);
   rbtree::node* rotate_left(rbtree::node* n);
   rbtree::node* rotate_right(rbtree::node* n);
 
-  rbtree::node* find_reference(int v);
-
-  rbtree::node* insert_leaf(int v);
+  template<typename K>
+  rbtree::node* find_reference(const K &k) const;
+  template<typename K>
+  rbtree::node* lower_bound_reference(const K &k) const;
+  template<typename K>
+  rbtree::node* upper_bound_reference(const K &k) const;
+  template<typename K>
+  size_type rank_reference(const K &k) const;
+  rbtree::node* select_reference(size_type k) const;
+
+  // links the new node as a leaf, or returns the node that already holds
+  // its key and leaves the new one unlinked
+  rbtree::node* insert_leaf(rbtree::node* new_node);
+  // puts n where its successor s (the leftmost node of its right subtree)
+  // is and s where n is, colors included
+  void swap_with_successor(rbtree::node* n, rbtree::node* s);
   tuple<rbtree::node*, rbtree::node*, rbtree::color> erase_node(rbtree::node* n);
   void rebalance_red(rbtree::node* n);
   void rebalance_double_black(rbtree::node* parent, rbtree::node* n);
+  std::pair<rbtree::node*, bool> insert_node(rbtree::node* new_node);
+  void erase_reference(rbtree::node* n);
 
   string to_string(rbtree::node* n, string indent, const int &position, const bool &last);
+
 public:
+  // in order bidirectional iterators, end() is one past the largest key
+  template<bool constant>
+  class tree_iterator {
+  private:
+    friend class rbtree;
+    template<bool> friend class tree_iterator;
+    rbtree::node* n;
+    const rbtree* tree;
+    tree_iterator(rbtree::node* n, const rbtree* tree) : n(n), tree(tree) { }
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef typename rbtree::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<constant, const value_type*, value_type*>::type pointer;
+    typedef typename std::conditional<constant, const value_type&, value_type&>::type reference;
+
+    tree_iterator() : n(NULL), tree(NULL) { }
+    // an iterator converts to a const_iterator
+    tree_iterator(const tree_iterator<false> &it) : n(it.n), tree(it.tree) { }
+    reference operator * () const { return this->n->v; }
+    pointer operator -> () const { return &this->n->v; }
+    tree_iterator& operator ++ () { this->n = rbtree::next_node(this->n); return (*this); }
+    tree_iterator operator ++ (int) { tree_iterator it(*this); ++(*this); return it; }
+    tree_iterator& operator -- () {
+      this->n = ((this->n == NULL) ? this->tree->last_node() : rbtree::prev_node(this->n));
+      return (*this);
+    }
+    tree_iterator operator -- (int) { tree_iterator it(*this); --(*this); return it; }
+    bool operator == (const tree_iterator &it) const { return this->n == it.n; }
+    bool operator != (const tree_iterator &it) const { return this->n != it.n; }
+  };
+  typedef tree_iterator<false> iterator;
+  typedef tree_iterator<true> const_iterator;
+
   // public interface
   rbtree();
+  explicit rbtree(const Compare &less, const Allocator &alloc = Allocator());
+  rbtree(const rbtree &_rbtree) = delete;
+  rbtree(rbtree &&_rbtree);
   ~rbtree();
+  rbtree& operator = (const rbtree &_rbtree) = delete;
+  rbtree& operator = (rbtree &&_rbtree);
+
   void clear();
-  void insert(int v);
-  void erase(int v);
-  bool find(int v);
+  size_type size() const;
+  bool empty() const;
+
+  // the key with a default constructed value, nothing if the key is there
+  std::pair<iterator, bool> insert(const Key &k);
+  std::pair<iterator, bool> insert(const value_type &v);
+  std::pair<iterator, bool> insert(value_type &&v);
+  // builds the pair from the arguments, the new node is dropped if the key
+  // is already there
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args);
+  // builds the value from the arguments only if the key is not there
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key &k, Args&&... args);
+  Value& operator [] (const Key &k);
+
+  size_type erase(const Key &k);
+  // returns the iterator after the erased node
+  iterator erase(const_iterator it);
+
+  iterator find(const Key &k);
+  const_iterator find(const Key &k) const;
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  iterator find(const K &k);
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  const_iterator find(const K &k) const;
+  bool contains(const Key &k) const;
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  bool contains(const K &k) const;
+
+  // the first key not less than k, and the first key greater than k
+  iterator lower_bound(const Key &k);
+  const_iterator lower_bound(const Key &k) const;
+  iterator upper_bound(const Key &k);
+  const_iterator upper_bound(const Key &k) const;
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  iterator lower_bound(const K &k);
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  const_iterator lower_bound(const K &k) const;
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  iterator upper_bound(const K &k);
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  const_iterator upper_bound(const K &k) const;
+
+  // the key of rank k (0 is the smallest), end() if k >= size()
+  iterator select(const size_type &k);
+  const_iterator select(const size_type &k) const;
+  // the number of keys less than k
+  size_type rank(const Key &k) const;
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  size_type rank(const K &k) const;
+  // the number of keys in [lo, hi)
+  size_type count_range(const Key &lo, const Key &hi) const;
+  template<typename K, typename = typename std::enable_if<transparent<K>::value>::type>
+  size_type count_range(const K &lo, const K &hi) const;
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
   string to_string();
 };
 
 ///////////////////////////////////////
 ///////////////////////////////////////
 // node public interface
-rbtree::node::node() {
-  this->v = 0;
-  this->c = rbtree::RED;
-  this->p = NULL;
-  this->l = NULL;
-  this->r = NULL;
-}
 
-rbtree::node::node(int v) {
-  this->v = v;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename... Args>
+rbtree<Key, Value, Compare, Allocator>::node::node(Args&&... args) :
+    v(std::forward<Args>(args)...) {
   this->c = rbtree::RED;
   this->p = NULL;
   this->l = NULL;
   this->r = NULL;
+  this->s = 1;
 }
 
-rbtree::node::~node() {
-  // cout << "rbtree::node::~node()" << endl;
-  this->p = NULL;
-  delete this->l;
-  delete this->r;
-  this->l = NULL;
-  this->r = NULL;
-}
-
-string rbtree::node::to_string() {
-  return this->int_to_string(this->v) + "_" + this->color_to_string(this->c);
+template<typename Key, typename Value, typename Compare, typename Allocator>
+string rbtree<Key, Value, Compare, Allocator>::node::to_string() {
+  return this->key_to_string(this->v.first) + "_" + this->color_to_string(this->c);
 }
 
-string rbtree::node::int_to_string(const int &v) {
-  stringstream ss; string s; ss << v, ss >> s; return s;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+string rbtree<Key, Value, Compare, Allocator>::node::key_to_string(const Key &k) {
+  stringstream ss; ss << k; return ss.str();
 }
 
-string rbtree::node::color_to_string(const rbtree::color &c) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+string rbtree<Key, Value, Compare, Allocator>::node::color_to_string(const rbtree::color &c) {
   return ((c == rbtree::RED) ? "R" : "B");
 }
 
 ///////////////////////////////////////
 // helper functions
 
-rbtree::color rbtree::get_color(rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+const typename rbtree<Key, Value, Compare, Allocator>::size_type rbtree<Key, Value, Compare, Allocator>::min_slab_nodes;
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+const typename rbtree<Key, Value, Compare, Allocator>::size_type rbtree<Key, Value, Compare, Allocator>::max_slab_nodes;
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::add_slab() {
+  size_type size = rbtree::min_slab_nodes;
+  if (!this->slabs.empty())
+    size = ((this->slabs.back().size < rbtree::max_slab_nodes / 2) ? (2 * this->slabs.back().size) : rbtree::max_slab_nodes);
+
+  slab new_slab;
+  new_slab.nodes = node_traits::allocate(this->alloc, size);
+  new_slab.size = size;
+  try {
+    this->slabs.push_back(new_slab);
+  }
+  catch(...) {
+    node_traits::deallocate(this->alloc, new_slab.nodes, size);
+    throw;
+  }
+  this->slab_next = new_slab.nodes;
+  this->slab_end = new_slab.nodes + size;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::release_slabs() {
+  for (size_t i = 0; i < this->slabs.size(); ++i)
+    node_traits::deallocate(this->alloc, this->slabs[i].nodes, this->slabs[i].size);
+  this->slabs.clear();
+  this->slab_next = NULL;
+  this->slab_end = NULL;
+  this->free_nodes = NULL;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename... Args>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::create_node(Args&&... args) {
+  rbtree::node* n;
+  if (this->free_nodes != NULL) {
+    n = reinterpret_cast<rbtree::node*>(this->free_nodes);
+    this->free_nodes = this->free_nodes->next;
+  }
+  else {
+    if (this->slab_next == this->slab_end) this->add_slab();
+    n = this->slab_next++;
+  }
+
+  try {
+    node_traits::construct(this->alloc, n, std::forward<Args>(args)...);
+  }
+  catch(...) {
+    this->free_nodes = ::new((void*)n) free_node{this->free_nodes};
+    throw;
+  }
+  return n;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::destroy_node(rbtree::node* n) {
+  node_traits::destroy(this->alloc, n);
+  this->free_nodes = ::new((void*)n) free_node{this->free_nodes};
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::color
+rbtree<Key, Value, Compare, Allocator>::get_color(rbtree::node* n) {
   if (n == NULL)
     return rbtree::BLACK;
   return n->c;
 }
 
-rbtree::node* rbtree::get_sibling(rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::get_sibling(rbtree::node* n) {
   if (n == NULL)
     return NULL;
   if (n->p == NULL)
@@ -122,7 +375,9 @@ rbtree::node* rbtree::get_sibling(rbtree::node* n) {
   return NULL;
 }
 
-rbtree::node* rbtree::get_sibling(rbtree::node* parent, rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::get_sibling(rbtree::node* parent, rbtree::node* n) {
   if (parent == NULL)
     return NULL;
 
@@ -133,14 +388,18 @@ rbtree::node* rbtree::get_sibling(rbtree::node* parent, rbtree::node* n) {
   return NULL;
 }
 
-rbtree::node* rbtree::get_uncle(rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::get_uncle(rbtree::node* n) {
   if (n == NULL)
     return NULL;
 
   return this->get_sibling(n->p);
 }
 
-rbtree::node* rbtree::get_grand_parent(rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::get_grand_parent(rbtree::node* n) {
   if (n == NULL)
     return NULL;
 
@@ -150,7 +409,63 @@ rbtree::node* rbtree::get_grand_parent(rbtree::node* n) {
   return n->p->p;
 }
 
-rbtree::node* rbtree::start_rotation(rbtree::node* top, rbtree::node* mid, rbtree::node* bottom) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::next_node(rbtree::node* n) {
+  if (n->r != NULL) {
+    n = n->r;
+    while (n->l != NULL) n = n->l;
+    return n;
+  }
+  while (n->p != NULL && n->p->r == n) n = n->p;
+  return n->p;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::prev_node(rbtree::node* n) {
+  if (n->l != NULL) {
+    n = n->l;
+    while (n->r != NULL) n = n->r;
+    return n;
+  }
+  while (n->p != NULL && n->p->l == n) n = n->p;
+  return n->p;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::first_node() const {
+  rbtree::node* n = this->root;
+  if (n != NULL)
+    while (n->l != NULL) n = n->l;
+  return n;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::last_node() const {
+  rbtree::node* n = this->root;
+  if (n != NULL)
+    while (n->r != NULL) n = n->r;
+  return n;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::size_type
+rbtree<Key, Value, Compare, Allocator>::get_size(rbtree::node* n) {
+  return ((n == NULL) ? 0 : n->s);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::update_sizes(rbtree::node* n, const long long &delta) {
+  for (; n != NULL; n = n->p)
+    n->s += delta;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::start_rotation(rbtree::node* top, rbtree::node* mid, rbtree::node* bottom) {
   // this function examines the configuration of the three provided
   // nodes, and determine the proper set of rotations according to
   // the four cases, then it returns a reference to the new top
@@ -162,7 +477,7 @@ rbtree::node* rbtree::start_rotation(rbtree::node* top, rbtree::node* mid, rbtre
   if(mid == NULL)
     throw "ERROR at: rbtree::start_rotation(rbtree::node* top, rbtree::node* mid, rbtree::node* bottom): the second argument 'mid' can not be null";
 
-  if(mid == NULL)
+  if(bottom == NULL)
     throw "ERROR at: rbtree::start_rotation(rbtree::node* top, rbtree::node* mid, rbtree::node* bottom): the third argument 'bottom' can not be null";
 
   rbtree::node* new_top = NULL;
@@ -192,7 +507,9 @@ rbtree::node* rbtree::start_rotation(rbtree::node* top, rbtree::node* mid, rbtre
   return new_top;
 }
 
-rbtree::node* rbtree::rotate_left(rbtree::node* n){
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::rotate_left(rbtree::node* n){
   // n points to the top node in the rotated nodes
 
   if(n == NULL)
@@ -214,11 +531,17 @@ rbtree::node* rbtree::rotate_left(rbtree::node* n){
   }
   right_child->p = parent;
 
+  // the rotated pair keeps the same nodes below it
+  right_child->s = n->s;
+  n->s = this->get_size(n->l) + this->get_size(n->r) + 1;
+
   if(this->root == n) this->root = right_child;
   return right_child;
 }
 
-rbtree::node* rbtree::rotate_right(rbtree::node* n){
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::rotate_right(rbtree::node* n){
   // n points to the top node in the rotated nodes
 
   if(n == NULL)
@@ -240,65 +563,174 @@ rbtree::node* rbtree::rotate_right(rbtree::node* n){
   }
   left_child->p = parent;
 
+  left_child->s = n->s;
+  n->s = this->get_size(n->l) + this->get_size(n->r) + 1;
+
   if(this->root == n) this->root = left_child;
   return left_child;
 }
 
-rbtree::node* rbtree::find_reference(int v) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::find_reference(const K &k) const {
+  rbtree::node* n = this->root;
+  while (n != NULL) {
+    if (this->less(k, n->v.first)) n = n->l;
+    else if (this->less(n->v.first, k)) n = n->r;
+    else return n;
+  }
+
+  return NULL;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::lower_bound_reference(const K &k) const {
+  rbtree::node* n = this->root;
+  rbtree::node* result = NULL;
+  while (n != NULL) {
+    if (this->less(n->v.first, k)) n = n->r;
+    else result = n, n = n->l;
+  }
+  return result;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::upper_bound_reference(const K &k) const {
+  rbtree::node* n = this->root;
+  rbtree::node* result = NULL;
+  while (n != NULL) {
+    if (this->less(k, n->v.first)) result = n, n = n->l;
+    else n = n->r;
+  }
+  return result;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K>
+typename rbtree<Key, Value, Compare, Allocator>::size_type
+rbtree<Key, Value, Compare, Allocator>::rank_reference(const K &k) const {
+  // every time the walk goes right, the left subtree and the node are
+  // less than k
   rbtree::node* n = this->root;
+  size_type result = 0;
   while (n != NULL) {
-    if (n->v == v) return n;
-    n = ((v < n->v) ? n->l : n->r);
+    if (this->less(n->v.first, k)) result += this->get_size(n->l) + 1, n = n->r;
+    else n = n->l;
   }
+  return result;
+}
 
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::select_reference(size_type k) const {
+  rbtree::node* n = this->root;
+  while (n != NULL) {
+    size_type left_size = this->get_size(n->l);
+    if (k < left_size) n = n->l;
+    else if (k == left_size) return n;
+    else k -= left_size + 1, n = n->r;
+  }
   return NULL;
 }
 
-rbtree::node* rbtree::insert_leaf(int v) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::node*
+rbtree<Key, Value, Compare, Allocator>::insert_leaf(rbtree::node* new_node) {
   if (this->root == NULL)
-    return this->root = new rbtree::node(v);
+    return this->root = new_node;
 
+  const Key &k = new_node->v.first;
   rbtree::node* parent = NULL;
   rbtree::node* current = this->root;
+  bool left = false;
   while (current != NULL) {
-    if (v == current->v)
-      return NULL;
-
     parent = current;
-    current = ((v < current->v) ? current->l : current->r);
+    if (this->less(k, current->v.first)) left = true, current = current->l;
+    else if (this->less(current->v.first, k)) left = false, current = current->r;
+    else return current;
   }
 
-  rbtree::node* new_node = new rbtree::node();
-  new_node->v = v;
   new_node->p = parent;
+  if (left) parent->l = new_node;
+  else parent->r = new_node;
+  this->update_sizes(parent, 1);
+  return new_node;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::swap_with_successor(rbtree::node* n, rbtree::node* s) {
+  rbtree::node* parent = n->p;
+  rbtree::node* left_child = n->l;
+  rbtree::node* right_child = n->r;
+  rbtree::node* s_parent = s->p;
+  rbtree::node* s_right = s->r;
+  std::swap(n->c, s->c);
+  std::swap(n->s, s->s);
+
+  s->p = parent;
+  if(parent == NULL) this->root = s;
+  else if(parent->l == n) parent->l = s;
+  else parent->r = s;
+
+  s->l = left_child;
+  left_child->p = s;
+
+  // s may be the right child of n
+  if(s_parent == n) {
+    s->r = n;
+    n->p = s;
+  }
+  else {
+    s->r = right_child;
+    right_child->p = s;
+    s_parent->l = n;
+    n->p = s_parent;
+  }
 
-  return ((v < parent->v) ?
-      (parent->l = new_node) :
-      (parent->r = new_node));
+  n->l = NULL;
+  n->r = s_right;
+  if(s_right != NULL) s_right->p = n;
 }
 
-tuple<rbtree::node*, rbtree::node*, rbtree::color> rbtree::erase_node(rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+tuple<typename rbtree<Key, Value, Compare, Allocator>::node*, typename rbtree<Key, Value, Compare, Allocator>::node*,
+    typename rbtree<Key, Value, Compare, Allocator>::color>
+rbtree<Key, Value, Compare, Allocator>::erase_node(rbtree::node* n) {
   // returns a tuple containing a reference to the parent of the new
   // node that replaced the actually deleted node, a reference to the
-  // new node, and the color of the new node. the deleted node may be
-  // the provided node, or a substitute node if the provided node has
-  // two children. this is done as the caller need to know about the
-  // double black node to start rebalancing, regardless of which node
-  // was actually deleted. the function also colors the new node with
-  // the proper color. if the deleted node had no children, this
-  // function will return NULL in the second place of the tuple, and
-  // the color in the third place will be double black to signal the
-  // caller to deal with a double black situation with no reference
-  // to a new node
+  // new node, and the color of the new node. the deleted node is always
+  // the provided node, if it has two children it first trades places
+  // with its successor, so it has at most one. this is done as the
+  // caller need to know about the double black node to start
+  // rebalancing. the function also colors the new node with the proper
+  // color. if the deleted node had no children, this function will
+  // return NULL in the second place of the tuple, and the color in the
+  // third place will be double black to signal the caller to deal with
+  // a double black situation with no reference to a new node
 
   if(n == NULL)
     throw "ERROR at: rbtree::erase_node(rbtree::node* n): the first argument can not be null";
 
+  if(n->l != NULL && n->r != NULL) {
+    // always replacing with the leftmost node in the right subtree
+    rbtree::node* left_most = n->r;
+    while(left_most->l != NULL)
+      left_most = left_most->l;
+
+    this->swap_with_successor(n, left_most);
+  }
+
   rbtree::node* parent = n->p;
   rbtree::node* new_node = NULL;
   rbtree::color new_node_color = rbtree::DOUBLE_BLACK;
 
   bool is_root = (parent == NULL);
+  this->update_sizes(parent, -1);
 
   if(n->l == NULL && n->r == NULL) {
     if(parent != NULL) {
@@ -327,7 +759,7 @@ tuple<rbtree::node*, rbtree::node*, rbtree::color> rbtree::erase_node(rbtree::no
     right_child->p = parent;
     new_node = right_child;
   }
-  else if(n->r == NULL) {
+  else {
     rbtree::node* left_child = n->l;
 
     if(parent != NULL) {
@@ -342,26 +774,15 @@ tuple<rbtree::node*, rbtree::node*, rbtree::color> rbtree::erase_node(rbtree::no
     left_child->p = parent;
     new_node = left_child;
   }
-  else {
-    // always replacing with the leftmost node in the right subtree
-    rbtree::node* left_most = n->r;
-    while(left_most->l != NULL)
-      left_most = left_most->l;
-
-    n->v = left_most->v;
-    return this->erase_node(left_most);
-  }
 
   if(is_root) this->root = new_node;
 
-  n->p = NULL;
-  n->l = NULL;
-  n->r = NULL;
-  delete n;
+  this->destroy_node(n);
   return make_tuple(parent, new_node, new_node_color);
 }
 
-void rbtree::rebalance_red(rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::rebalance_red(rbtree::node* n) {
   if(n == NULL)
     return;
 
@@ -397,7 +818,8 @@ void rbtree::rebalance_red(rbtree::node* n) {
   }
 }
 
-void rbtree::rebalance_double_black(rbtree::node* parent, rbtree::node* n) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::rebalance_double_black(rbtree::node* parent, rbtree::node* n) {
   // this function takes a double black node n, and its parent
   // and work to fix the double black situation
 
@@ -445,15 +867,19 @@ void rbtree::rebalance_double_black(rbtree::node* parent, rbtree::node* n) {
       }
     }
     else if(left_nephew_color == rbtree::RED) {
+      // the new top takes the color of the old one, the black heights
+      // above the three nodes do not change
+      rbtree::color parent_color = parent->c;
       rbtree::node* new_top = this->start_rotation(parent, sibling, sibling->l);
-      new_top->c = rbtree::BLACK;
+      new_top->c = parent_color;
       if(new_top->l != NULL) new_top->l->c = rbtree::BLACK;
       if(new_top->r != NULL) new_top->r->c = rbtree::BLACK;
       return;
     }
     else if(right_nephew_color == rbtree::RED) {
+      rbtree::color parent_color = parent->c;
       rbtree::node* new_top = this->start_rotation(parent, sibling, sibling->r);
-      new_top->c = rbtree::BLACK;
+      new_top->c = parent_color;
       if(new_top->l != NULL) new_top->l->c = rbtree::BLACK;
       if(new_top->r != NULL) new_top->r->c = rbtree::BLACK;
       return;
@@ -474,7 +900,31 @@ void rbtree::rebalance_double_black(rbtree::node* parent, rbtree::node* n) {
   }
 }
 
-string rbtree::to_string(rbtree::node* n, string indent, const int &position, const bool &last) {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+std::pair<typename rbtree<Key, Value, Compare, Allocator>::node*, bool>
+rbtree<Key, Value, Compare, Allocator>::insert_node(rbtree::node* new_node) {
+  rbtree::node* inserted_node = this->insert_leaf(new_node);
+  if(inserted_node != new_node) {
+    this->destroy_node(new_node);
+    return std::make_pair(inserted_node, false);
+  }
+
+  ++this->count;
+  this->rebalance_red(inserted_node);
+  return std::make_pair(inserted_node, true);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::erase_reference(rbtree::node* n) {
+  auto erase_tuple = this->erase_node(n);
+  --this->count;
+  rbtree::color new_node_color = get<2>(erase_tuple);
+  if(new_node_color == rbtree::DOUBLE_BLACK)
+    this->rebalance_double_black(get<0>(erase_tuple), get<1>(erase_tuple));
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+string rbtree<Key, Value, Compare, Allocator>::to_string(rbtree::node* n, string indent, const int &position, const bool &last) {
   string s = indent;
   if (last) s += "--", indent += "  ";
   else s += "|-", indent += "| ";
@@ -496,41 +946,301 @@ string rbtree::to_string(rbtree::node* n, string indent, const int &position, co
 ///////////////////////////////////////
 // public interface
 
-rbtree::rbtree() {
-  this->root = NULL;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+rbtree<Key, Value, Compare, Allocator>::rbtree() :
+    root(NULL), count(0), less(), alloc(), slab_next(NULL), slab_end(NULL), free_nodes(NULL) { }
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+rbtree<Key, Value, Compare, Allocator>::rbtree(const Compare &less, const Allocator &alloc) :
+    root(NULL), count(0), less(less), alloc(alloc), slab_next(NULL), slab_end(NULL), free_nodes(NULL) { }
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+rbtree<Key, Value, Compare, Allocator>::rbtree(rbtree &&_rbtree) :
+    root(_rbtree.root), count(_rbtree.count), less(std::move(_rbtree.less)), alloc(std::move(_rbtree.alloc)),
+    slabs(std::move(_rbtree.slabs)), slab_next(_rbtree.slab_next), slab_end(_rbtree.slab_end),
+    free_nodes(_rbtree.free_nodes) {
+  _rbtree.root = NULL;
+  _rbtree.count = 0;
+  _rbtree.slabs.clear();
+  _rbtree.slab_next = NULL;
+  _rbtree.slab_end = NULL;
+  _rbtree.free_nodes = NULL;
 }
 
-rbtree::~rbtree() {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+rbtree<Key, Value, Compare, Allocator>::~rbtree() {
   this->clear();
 }
 
-void rbtree::clear() {
-  delete this->root;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+rbtree<Key, Value, Compare, Allocator>& rbtree<Key, Value, Compare, Allocator>::operator = (rbtree &&_rbtree) {
+  if(this == &_rbtree) return (*this);
+  this->clear();
+  this->root = _rbtree.root;
+  this->count = _rbtree.count;
+  this->less = std::move(_rbtree.less);
+  this->alloc = std::move(_rbtree.alloc);
+  this->slabs = std::move(_rbtree.slabs);
+  this->slab_next = _rbtree.slab_next;
+  this->slab_end = _rbtree.slab_end;
+  this->free_nodes = _rbtree.free_nodes;
+  _rbtree.root = NULL;
+  _rbtree.count = 0;
+  _rbtree.slabs.clear();
+  _rbtree.slab_next = NULL;
+  _rbtree.slab_end = NULL;
+  _rbtree.free_nodes = NULL;
+  return (*this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+void rbtree<Key, Value, Compare, Allocator>::clear() {
+  if (!std::is_trivially_destructible<rbtree::node>::value) {
+    // post order without recursion, a node is destroyed once both of
+    // its subtrees are, the memory goes with the slabs
+    rbtree::node* n = this->root;
+    while (n != NULL) {
+      if (n->l != NULL) n = n->l;
+      else if (n->r != NULL) n = n->r;
+      else {
+        rbtree::node* parent = n->p;
+        if (parent != NULL) {
+          if (parent->l == n) parent->l = NULL;
+          else parent->r = NULL;
+        }
+        node_traits::destroy(this->alloc, n);
+        n = parent;
+      }
+    }
+  }
+  this->release_slabs();
   this->root = NULL;
+  this->count = 0;
 }
 
-void rbtree::insert(int v) {
-  rbtree::node* inserted_node = this->insert_leaf(v);
-  this->rebalance_red(inserted_node);
-  return;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::size_type rbtree<Key, Value, Compare, Allocator>::size() const {
+  return this->count;
 }
 
-void rbtree::erase(int v) {
-  rbtree::node* target_node = this->find_reference(v);
-  if(target_node == NULL) return;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+bool rbtree<Key, Value, Compare, Allocator>::empty() const {
+  return (this->count == 0);
+}
 
-  auto erase_tuple = this->erase_node(target_node);
-  rbtree::color new_node_color = get<2>(erase_tuple);
-  if(new_node_color == rbtree::DOUBLE_BLACK)
-    this->rebalance_double_black(get<0>(erase_tuple), get<1>(erase_tuple));
-  return;
+template<typename Key, typename Value, typename Compare, typename Allocator>
+std::pair<typename rbtree<Key, Value, Compare, Allocator>::iterator, bool>
+rbtree<Key, Value, Compare, Allocator>::insert(const Key &k) {
+  return this->try_emplace(k);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+std::pair<typename rbtree<Key, Value, Compare, Allocator>::iterator, bool>
+rbtree<Key, Value, Compare, Allocator>::insert(const value_type &v) {
+  return this->emplace(v);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+std::pair<typename rbtree<Key, Value, Compare, Allocator>::iterator, bool>
+rbtree<Key, Value, Compare, Allocator>::insert(value_type &&v) {
+  return this->emplace(std::move(v));
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename... Args>
+std::pair<typename rbtree<Key, Value, Compare, Allocator>::iterator, bool>
+rbtree<Key, Value, Compare, Allocator>::emplace(Args&&... args) {
+  std::pair<rbtree::node*, bool> result = this->insert_node(this->create_node(std::forward<Args>(args)...));
+  return std::make_pair(iterator(result.first, this), result.second);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename... Args>
+std::pair<typename rbtree<Key, Value, Compare, Allocator>::iterator, bool>
+rbtree<Key, Value, Compare, Allocator>::try_emplace(const Key &k, Args&&... args) {
+  rbtree::node* existing = this->find_reference(k);
+  if(existing != NULL)
+    return std::make_pair(iterator(existing, this), false);
+
+  std::pair<rbtree::node*, bool> result = this->insert_node(this->create_node(std::piecewise_construct,
+      std::forward_as_tuple(k), std::forward_as_tuple(std::forward<Args>(args)...)));
+  return std::make_pair(iterator(result.first, this), result.second);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+Value& rbtree<Key, Value, Compare, Allocator>::operator [] (const Key &k) {
+  return this->try_emplace(k).first->second;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::size_type rbtree<Key, Value, Compare, Allocator>::erase(const Key &k) {
+  rbtree::node* target_node = this->find_reference(k);
+  if(target_node == NULL) return 0;
+
+  this->erase_reference(target_node);
+  return 1;
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::erase(const_iterator it) {
+  // the successor node is not moved by the erase
+  rbtree::node* next = rbtree::next_node(it.n);
+  this->erase_reference(it.n);
+  return iterator(next, this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::find(const Key &k) {
+  return iterator(this->find_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::find(const Key &k) const {
+  return const_iterator(this->find_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::find(const K &k) {
+  return iterator(this->find_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::find(const K &k) const {
+  return const_iterator(this->find_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+bool rbtree<Key, Value, Compare, Allocator>::contains(const Key &k) const {
+  return (this->find_reference(k) != NULL);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+bool rbtree<Key, Value, Compare, Allocator>::contains(const K &k) const {
+  return (this->find_reference(k) != NULL);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::lower_bound(const Key &k) {
+  return iterator(this->lower_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::lower_bound(const Key &k) const {
+  return const_iterator(this->lower_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::upper_bound(const Key &k) {
+  return iterator(this->upper_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::upper_bound(const Key &k) const {
+  return const_iterator(this->upper_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::lower_bound(const K &k) {
+  return iterator(this->lower_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::lower_bound(const K &k) const {
+  return const_iterator(this->lower_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::upper_bound(const K &k) {
+  return iterator(this->upper_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::upper_bound(const K &k) const {
+  return const_iterator(this->upper_bound_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator
+rbtree<Key, Value, Compare, Allocator>::select(const size_type &k) {
+  return iterator(this->select_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator
+rbtree<Key, Value, Compare, Allocator>::select(const size_type &k) const {
+  return const_iterator(this->select_reference(k), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::size_type
+rbtree<Key, Value, Compare, Allocator>::rank(const Key &k) const {
+  return this->rank_reference(k);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::size_type
+rbtree<Key, Value, Compare, Allocator>::rank(const K &k) const {
+  return this->rank_reference(k);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::size_type
+rbtree<Key, Value, Compare, Allocator>::count_range(const Key &lo, const Key &hi) const {
+  if (!this->less(lo, hi)) return 0;
+  return this->rank_reference(hi) - this->rank_reference(lo);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+template<typename K, typename>
+typename rbtree<Key, Value, Compare, Allocator>::size_type
+rbtree<Key, Value, Compare, Allocator>::count_range(const K &lo, const K &hi) const {
+  if (!this->less(lo, hi)) return 0;
+  return this->rank_reference(hi) - this->rank_reference(lo);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator rbtree<Key, Value, Compare, Allocator>::begin() {
+  return iterator(this->first_node(), this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::iterator rbtree<Key, Value, Compare, Allocator>::end() {
+  return iterator(NULL, this);
+}
+
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator rbtree<Key, Value, Compare, Allocator>::begin() const {
+  return const_iterator(this->first_node(), this);
 }
 
-bool rbtree::find(int v) {
-  return (this->find_reference(v) != NULL);
+template<typename Key, typename Value, typename Compare, typename Allocator>
+typename rbtree<Key, Value, Compare, Allocator>::const_iterator rbtree<Key, Value, Compare, Allocator>::end() const {
+  return const_iterator(NULL, this);
 }
 
-string rbtree::to_string() {
+template<typename Key, typename Value, typename Compare, typename Allocator>
+string rbtree<Key, Value, Compare, Allocator>::to_string() {
   return ((this->root == NULL) ? "" : this->to_string(this->root, "", 0, true));
 }
 
@@ -0,0 +1,458 @@
+#ifndef RNS_INTEGER_H_
+#define RNS_INTEGER_H_
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+#include "big_integer.h"
+
+// residue number system (multi-modular) representation of big integers.
+// a value x is kept as the list of its residues (x mod p) for a fixed set
+// of word sized primes p, so addition, subtraction and multiplication are
+// independent word sized operations on each residue, with no carries
+// between them, which makes them trivial to vectorize or to split among
+// threads. the representation is exact as long as every intermediate value
+// lies in the symmetric range (-M/2, M/2], where M is the product of all the
+// primes of the basis, values outside that range silently wrap modulo M.
+// comparisons other than equality, division and conversion to other bases
+// need the value back as a big_integer, which is done by the chinese
+// remainder theorem (garner's algorithm).
+
+// the set of primes used by a family of rns_integer values, all the
+// operands of an operation must share the same basis object
+class rns_basis {
+private:
+  int count;
+  // the primes, all of them are less than 2^31 so the sum of two
+  // residues fits in 32 bits and their product fits in 64 bits
+  unsigned int *primes;
+  // montgomery constants of every prime, with R = 2^32
+  // neg_inverse = -(p^-1) mod 2^32, r2 = R^2 mod p
+  unsigned int *neg_inverse;
+  unsigned int *r2;
+  // garner constants, garner_inverse[i * count + j] = (p_j^-1) mod p_i, j < i
+  unsigned int *garner_inverse;
+  // M and floor(M / 2) as little endian 32 bits limbs
+  std::vector<unsigned int> modulus;
+  std::vector<unsigned int> half_modulus;
+
+  bool static is_prime(const unsigned int &n);
+  unsigned int static pow_mod(unsigned long long base, unsigned int exp, const unsigned int &mod);
+
+  rns_basis(const rns_basis &);
+  rns_basis& operator = (const rns_basis &);
+
+public:
+  // picks the largest primes_count primes less than 2^31
+  rns_basis(const int &primes_count);
+  ~rns_basis();
+
+  // the number of primes needed to represent every value of magnitude
+  // less than 2^bits in the symmetric range
+  int static primes_for_bits(const int &bits);
+
+  int size() const;
+  unsigned int get_prime(const int &index) const;
+  // the number of bits of M, the largest magnitude is about half of that
+  int modulus_bits() const;
+
+  // montgomery arithmetic modulo the prime at the given index
+  unsigned int add(const int &index, const unsigned int &a, const unsigned int &b) const;
+  unsigned int sub(const int &index, const unsigned int &a, const unsigned int &b) const;
+  unsigned int mul(const int &index, const unsigned int &a, const unsigned int &b) const;
+  unsigned int reduce(const int &index, const unsigned long long &t) const;
+  unsigned int to_montgomery(const int &index, const unsigned int &a) const;
+  unsigned int from_montgomery(const int &index, const unsigned int &a) const;
+
+  friend class rns_integer;
+};
+
+class rns_integer {
+private:
+  const rns_basis *basis;
+  // residues in montgomery form, one per prime of the basis
+  unsigned int *residues;
+
+  void check_basis(const rns_integer &_rns_integer, const char *where) const;
+
+public:
+  // zero
+  rns_integer(const rns_basis &basis);
+  rns_integer(const rns_basis &basis, const long long &value);
+  rns_integer(const rns_basis &basis, const big_integer &value);
+  // copy constructor
+  rns_integer(const rns_integer &_rns_integer);
+  ~rns_integer();
+
+  rns_integer& operator = (const rns_integer &_rns_integer);
+
+  rns_integer operator + (const rns_integer &_rns_integer) const;
+  rns_integer operator - (const rns_integer &_rns_integer) const;
+  rns_integer operator * (const rns_integer &_rns_integer) const;
+  rns_integer operator - () const;
+
+  rns_integer& operator += (const rns_integer &_rns_integer);
+  rns_integer& operator -= (const rns_integer &_rns_integer);
+  rns_integer& operator *= (const rns_integer &_rns_integer);
+
+  bool operator == (const rns_integer &_rns_integer) const;
+  bool operator != (const rns_integer &_rns_integer) const;
+
+  const rns_basis& get_basis() const;
+  // the canonical residue modulo the prime at the given index
+  unsigned int get_residue(const int &index) const;
+
+  // chinese remainder reconstruction, the result is in (-M/2, M/2]
+  big_integer to_big_integer() const;
+};
+
+///////////////////////////////////////
+
+bool rns_basis::is_prime(const unsigned int &n){
+  if(n < 2) return false;
+  if(n % 2 == 0) return (n == 2);
+
+  // deterministic miller-rabin, the bases 2, 7 and 61
+  // are enough for every n less than 4759123141
+  unsigned int d = n - 1;
+  int s = 0;
+  while((d & 1) == 0) d >>= 1, ++s;
+
+  const unsigned int bases[3] = {2, 7, 61};
+  for(int i = 0; i < 3; ++i){
+    if(bases[i] % n == 0) continue;
+    unsigned long long x = rns_basis::pow_mod(bases[i], d, n);
+    if(x == 1 || x == n - 1) continue;
+
+    bool composite = true;
+    for(int r = 1; (r < s) && composite; ++r){
+      x = (x * x) % n;
+      if(x == n - 1) composite = false;
+    }
+
+    if(composite) return false;
+  }
+
+  return true;
+}
+
+unsigned int rns_basis::pow_mod(unsigned long long base, unsigned int exp, const unsigned int &mod){
+  unsigned long long result = 1;
+  base %= mod;
+  while(exp > 0){
+    if(exp & 1) result = (result * base) % mod;
+    base = (base * base) % mod;
+    exp >>= 1;
+  }
+  return (unsigned int)result;
+}
+
+rns_basis::rns_basis(const int &primes_count){
+  if(primes_count <= 0)
+    throw std::runtime_error("rns_basis::rns_basis: invalid_primes_count");
+
+  this->count = primes_count;
+  this->primes = new unsigned int[primes_count];
+  this->neg_inverse = new unsigned int[primes_count];
+  this->r2 = new unsigned int[primes_count];
+  this->garner_inverse = new unsigned int[primes_count * primes_count];
+
+  unsigned int candidate = (1U << 31) - 1;
+  for(int i = 0; i < primes_count; candidate -= 2){
+    if(rns_basis::is_prime(candidate))
+      this->primes[i++] = candidate;
+  }
+
+  for(int i = 0; i < primes_count; ++i){
+    unsigned int p = this->primes[i];
+
+    // newton iteration for p^-1 mod 2^32, p * p = 1 mod 8 so
+    // the initial guess is correct to 3 bits, every step doubles that
+    unsigned int inverse = p;
+    for(int step = 0; step < 4; ++step)
+      inverse *= 2 - (p * inverse);
+    this->neg_inverse[i] = 0U - inverse;
+
+    unsigned long long r = (1ULL << 32) % p;
+    this->r2[i] = (unsigned int)((r * r) % p);
+
+    for(int j = 0; j < i; ++j)
+      this->garner_inverse[i * primes_count + j] = rns_basis::pow_mod(this->primes[j], p - 2, p);
+  }
+
+  // M = the product of all primes
+  this->modulus.assign(1, 1);
+  for(int i = 0; i < primes_count; ++i){
+    unsigned long long carry = 0;
+    for(size_t l = 0; l < this->modulus.size(); ++l){
+      carry += (unsigned long long)this->modulus[l] * this->primes[i];
+      this->modulus[l] = (unsigned int)carry;
+      carry >>= 32;
+    }
+    if(carry) this->modulus.push_back((unsigned int)carry);
+  }
+
+  this->half_modulus = this->modulus;
+  for(size_t l = 0; l < this->half_modulus.size(); ++l){
+    this->half_modulus[l] >>= 1;
+    if(l + 1 < this->half_modulus.size())
+      this->half_modulus[l] |= (this->modulus[l + 1] & 1) << 31;
+  }
+}
+
+rns_basis::~rns_basis(){
+  delete[] this->primes;
+  delete[] this->neg_inverse;
+  delete[] this->r2;
+  delete[] this->garner_inverse;
+}
+
+int rns_basis::primes_for_bits(const int &bits){
+  // every prime is larger than 2^30, one extra bit for the sign
+  return ((bits + 1) / 30) + 1;
+}
+
+int rns_basis::size() const{
+  return this->count;
+}
+
+unsigned int rns_basis::get_prime(const int &index) const{
+  if(index < 0 || index >= this->count)
+    throw std::out_of_range("rns_basis::get_prime: index_out_of_bound");
+  return this->primes[index];
+}
+
+int rns_basis::modulus_bits() const{
+  int bits = (int)(this->modulus.size() - 1) * 32;
+  unsigned int top = this->modulus.back();
+  while(top) ++bits, top >>= 1;
+  return bits;
+}
+
+unsigned int rns_basis::add(const int &index, const unsigned int &a, const unsigned int &b) const{
+  unsigned int s = a + b;
+  return ((s >= this->primes[index]) ? (s - this->primes[index]) : s);
+}
+
+unsigned int rns_basis::sub(const int &index, const unsigned int &a, const unsigned int &b) const{
+  return ((a >= b) ? (a - b) : (a + this->primes[index] - b));
+}
+
+// montgomery reduction, t < p * 2^32, returns t * 2^-32 mod p
+unsigned int rns_basis::reduce(const int &index, const unsigned long long &t) const{
+  unsigned int m = (unsigned int)t * this->neg_inverse[index];
+  unsigned long long u = (t + (unsigned long long)m * this->primes[index]) >> 32;
+  return (unsigned int)((u >= this->primes[index]) ? (u - this->primes[index]) : u);
+}
+
+unsigned int rns_basis::mul(const int &index, const unsigned int &a, const unsigned int &b) const{
+  return this->reduce(index, (unsigned long long)a * b);
+}
+
+unsigned int rns_basis::to_montgomery(const int &index, const unsigned int &a) const{
+  return this->reduce(index, (unsigned long long)a * this->r2[index]);
+}
+
+unsigned int rns_basis::from_montgomery(const int &index, const unsigned int &a) const{
+  return this->reduce(index, a);
+}
+
+///////////////////////////////////////
+
+void rns_integer::check_basis(const rns_integer &_rns_integer, const char *where) const{
+  if(this->basis != _rns_integer.basis)
+    throw std::runtime_error(std::string(where) + ": basis_mismatch");
+}
+
+rns_integer::rns_integer(const rns_basis &basis){
+  this->basis = &basis;
+  this->residues = new unsigned int[basis.count];
+  for(int i = 0; i < basis.count; ++i)
+    this->residues[i] = 0;
+}
+
+rns_integer::rns_integer(const rns_basis &basis, const long long &value){
+  this->basis = &basis;
+  this->residues = new unsigned int[basis.count];
+
+  unsigned long long magnitude = ((value < 0) ?
+      (0ULL - (unsigned long long)value) : (unsigned long long)value);
+  for(int i = 0; i < basis.count; ++i){
+    unsigned int r = (unsigned int)(magnitude % basis.primes[i]);
+    if(value < 0 && r != 0) r = basis.primes[i] - r;
+    this->residues[i] = basis.to_montgomery(i, r);
+  }
+}
+
+rns_integer::rns_integer(const rns_basis &basis, const big_integer &value){
+  this->basis = &basis;
+  this->residues = new unsigned int[basis.count];
+
+  // the magnitude is reduced 32 bits at a time, starting from the most
+  // significant chunk, r < 2^31 so (r * 2^32 + chunk) fits in 64 bits
+  const my_bitset &mag = value.get_magnitude();
+  int bytes = mag.words_count();
+  int chunks = (bytes + 3) / 4;
+
+  for(int i = 0; i < basis.count; ++i){
+    unsigned long long r = 0;
+    int byte = 0;
+    for(int c = 0; c < chunks; ++c){
+      unsigned long long chunk = 0;
+      int chunk_bytes = ((c == 0) ? (bytes - ((chunks - 1) * 4)) : 4);
+      for(int k = 0; k < chunk_bytes; ++k, ++byte)
+        chunk = (chunk << 8) | mag.get_word(byte);
+      r = ((r << (chunk_bytes * 8)) | chunk) % basis.primes[i];
+    }
+
+    if(value.get_sign() < 0 && r != 0) r = basis.primes[i] - r;
+    this->residues[i] = basis.to_montgomery(i, (unsigned int)r);
+  }
+}
+
+rns_integer::rns_integer(const rns_integer &_rns_integer){
+  this->basis = _rns_integer.basis;
+  this->residues = new unsigned int[this->basis->count];
+  memcpy(this->residues, _rns_integer.residues, this->basis->count * sizeof(unsigned int));
+}
+
+rns_integer::~rns_integer(){
+  delete[] this->residues;
+}
+
+rns_integer& rns_integer::operator = (const rns_integer &_rns_integer){
+  if(this == &_rns_integer) return (*this);
+
+  if(this->basis->count != _rns_integer.basis->count){
+    delete[] this->residues;
+    this->residues = new unsigned int[_rns_integer.basis->count];
+  }
+
+  this->basis = _rns_integer.basis;
+  memcpy(this->residues, _rns_integer.residues, this->basis->count * sizeof(unsigned int));
+  return (*this);
+}
+
+rns_integer rns_integer::operator + (const rns_integer &_rns_integer) const{
+  rns_integer result(*this);
+  return (result += _rns_integer);
+}
+
+rns_integer rns_integer::operator - (const rns_integer &_rns_integer) const{
+  rns_integer result(*this);
+  return (result -= _rns_integer);
+}
+
+rns_integer rns_integer::operator * (const rns_integer &_rns_integer) const{
+  rns_integer result(*this);
+  return (result *= _rns_integer);
+}
+
+rns_integer rns_integer::operator - () const{
+  rns_integer result(*(this->basis));
+  for(int i = 0; i < this->basis->count; ++i)
+    result.residues[i] = this->basis->sub(i, 0, this->residues[i]);
+  return result;
+}
+
+rns_integer& rns_integer::operator += (const rns_integer &_rns_integer){
+  this->check_basis(_rns_integer, "rns_integer::operator +=");
+  for(int i = 0; i < this->basis->count; ++i)
+    this->residues[i] = this->basis->add(i, this->residues[i], _rns_integer.residues[i]);
+  return (*this);
+}
+
+rns_integer& rns_integer::operator -= (const rns_integer &_rns_integer){
+  this->check_basis(_rns_integer, "rns_integer::operator -=");
+  for(int i = 0; i < this->basis->count; ++i)
+    this->residues[i] = this->basis->sub(i, this->residues[i], _rns_integer.residues[i]);
+  return (*this);
+}
+
+rns_integer& rns_integer::operator *= (const rns_integer &_rns_integer){
+  this->check_basis(_rns_integer, "rns_integer::operator *=");
+  for(int i = 0; i < this->basis->count; ++i)
+    this->residues[i] = this->basis->mul(i, this->residues[i], _rns_integer.residues[i]);
+  return (*this);
+}
+
+bool rns_integer::operator == (const rns_integer &_rns_integer) const{
+  this->check_basis(_rns_integer, "rns_integer::operator ==");
+  return (memcmp(this->residues, _rns_integer.residues,
+      this->basis->count * sizeof(unsigned int)) == 0);
+}
+
+bool rns_integer::operator != (const rns_integer &_rns_integer) const{
+  return !(this->operator == (_rns_integer));
+}
+
+const rns_basis& rns_integer::get_basis() const{
+  return *(this->basis);
+}
+
+unsigned int rns_integer::get_residue(const int &index) const{
+  if(index < 0 || index >= this->basis->count)
+    throw std::out_of_range("rns_integer::get_residue: index_out_of_bound");
+  return this->basis->from_montgomery(index, this->residues[index]);
+}
+
+big_integer rns_integer::to_big_integer() const{
+  const rns_basis &b = *(this->basis);
+  int count = b.count;
+
+  // garner's algorithm, computes the mixed radix digits v such that
+  // x = v[0] + v[1]*p[0] + v[2]*p[0]*p[1] + ..., using word operations only
+  std::vector<unsigned int> v(count);
+  for(int i = 0; i < count; ++i){
+    unsigned long long digit = b.from_montgomery(i, this->residues[i]);
+    for(int j = 0; j < i; ++j){
+      unsigned long long vj = v[j] % b.primes[i];
+      digit = ((digit >= vj) ? (digit - vj) : (digit + b.primes[i] - vj));
+      digit = (digit * b.garner_inverse[i * count + j]) % b.primes[i];
+    }
+    v[i] = (unsigned int)digit;
+  }
+
+  // evaluate the mixed radix form with horner's rule on 32 bits limbs
+  std::vector<unsigned int> limbs(1, v[count - 1]);
+  for(int i = count - 2; i >= 0; --i){
+    unsigned long long carry = v[i];
+    for(size_t l = 0; l < limbs.size(); ++l){
+      carry += (unsigned long long)limbs[l] * b.primes[i];
+      limbs[l] = (unsigned int)carry;
+      carry >>= 32;
+    }
+    if(carry) limbs.push_back((unsigned int)carry);
+  }
+
+  // values above M/2 are the negative ones, their magnitude is M - x
+  limbs.resize(b.modulus.size(), 0);
+  bool negative = false;
+  for(int l = (int)limbs.size() - 1; l >= 0; --l){
+    if(limbs[l] != b.half_modulus[l]) {
+      negative = (limbs[l] > b.half_modulus[l]);
+      break;
+    }
+  }
+
+  if(negative) {
+    long long borrow = 0;
+    for(size_t l = 0; l < limbs.size(); ++l){
+      long long diff = (long long)b.modulus[l] - (long long)limbs[l] - borrow;
+      borrow = (diff < 0);
+      limbs[l] = (unsigned int)(diff + (borrow << 32));
+    }
+  }
+
+  int bytes = (int)limbs.size() * 4;
+  std::vector<unsigned char> buffer(bytes);
+  for(int l = 0; l < (int)limbs.size(); ++l)
+    for(int k = 0; k < 4; ++k)
+      buffer[bytes - (l * 4) - k - 1] = (unsigned char)(limbs[l] >> (k * 8));
+
+  return big_integer(my_bitset(&buffer[0], bytes), (negative ? -1 : 1));
+}
+
+#endif /* RNS_INTEGER_H_ */
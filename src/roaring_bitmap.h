@@ -0,0 +1,896 @@
+#ifndef ROARING_BITMAP_H_
+#define ROARING_BITMAP_H_
+
+#include <cstdlib>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+#include "bit_ops.h"
+#include "bitset_kernels.h"
+#include "my_bitset.h"
+
+// compressed bitmap of unsigned 32 bits values, the roaring layout: the
+// values are split by their high 16 bits into chunks of 65536 values, and
+// every non empty chunk is kept in the smallest of three containers:
+//   array   the sorted low 16 bits of the values, for up to 4096 values
+//   bitmap  65536 bits (1024 words), for denser chunks
+//   run     sorted (start, length - 1) pairs, for chunks made of long runs
+// so the memory follows the content instead of the largest value.
+// the boolean operators work container by container, picking a merge, a
+// lookup or a word by word loop depending on the two container types.
+// the words of a bitmap container are little-endian (value v is bit
+// v % 64 of word v / 64), unlike my_bitset blocks, the conversions
+// reverse the bits of every block.
+
+class roaring_bitmap {
+private:
+  enum container_type {
+    ARRAY, BITMAP, RUN
+  };
+
+  const static int array_max = 4096;
+  const static int bitmap_words = 1024;
+
+  class container {
+  public:
+    roaring_bitmap::container_type type;
+    int cardinality;
+    // ARRAY: sorted values, RUN: (start, length - 1) pairs
+    std::vector<unsigned short> values;
+    // BITMAP: 1024 words
+    std::vector<unsigned long long> words;
+
+    container();
+
+    // RUN: the index of the last run starting at or before the value,
+    // -1 if there is none
+    int find_run(const unsigned short &value) const;
+    // RUN: the value goes into the runs, the container is then switched
+    // to an array or a bitmap if the runs are no longer the smallest
+    void add_to_runs(const unsigned short &value);
+    void remove_from_runs(const unsigned short &value);
+
+    bool contains(const unsigned short &value) const;
+    bool add(const unsigned short &value);
+    bool remove(const unsigned short &value);
+
+    // ors the content into 1024 words
+    void fill_words(unsigned long long *target) const;
+    int runs_count() const;
+    template<typename function>
+    void for_each(const unsigned int &high, function f) const;
+    unsigned short minimum() const;
+    unsigned short maximum() const;
+    long long size_bytes() const;
+
+    void to_array();
+    void to_bitmap();
+    void to_runs();
+    // switches to the smallest container type for the content
+    void optimize();
+
+    // builds an array or bitmap container from 1024 words
+    void static from_words(container &result, std::vector<unsigned long long> &source);
+  };
+
+  // sorted high 16 bits of the chunks and their containers
+  std::vector<unsigned short> keys;
+  std::vector<roaring_bitmap::container> containers;
+
+  int find_key(const unsigned short &key) const;
+
+  void static set_range(unsigned long long *target, const int &first, const int &last);
+  int static count_range(const unsigned long long *source, const int &first, const int &last);
+
+  void static and_containers(container &result, const container &c1, const container &c2);
+  void static or_containers(container &result, const container &c1, const container &c2);
+  void static xor_containers(container &result, const container &c1, const container &c2);
+  long long static and_count(const container &c1, const container &c2);
+  long long static run_array_count(const container &runs, const container &array);
+
+public:
+  roaring_bitmap();
+  // the values are the indices of the set bits
+  roaring_bitmap(const my_bitset &_my_bitset);
+
+  bool contains(const unsigned int &value) const;
+  // return false if nothing changed
+  bool add(const unsigned int &value);
+  bool remove(const unsigned int &value);
+
+  long long cardinality() const;
+  bool empty() const;
+  // both throw if the bitmap is empty
+  unsigned int minimum() const;
+  unsigned int maximum() const;
+
+  // calls f(value) for every value in increasing order
+  template<typename function>
+  void for_each(function f) const;
+
+  // converts every container that is smaller as runs
+  void run_optimize();
+  long long memory_bytes() const;
+
+  roaring_bitmap operator & (const roaring_bitmap &_roaring_bitmap) const;
+  roaring_bitmap operator | (const roaring_bitmap &_roaring_bitmap) const;
+  roaring_bitmap operator ^ (const roaring_bitmap &_roaring_bitmap) const;
+  roaring_bitmap& operator &= (const roaring_bitmap &_roaring_bitmap);
+  roaring_bitmap& operator |= (const roaring_bitmap &_roaring_bitmap);
+  roaring_bitmap& operator ^= (const roaring_bitmap &_roaring_bitmap);
+
+  // the cardinalities of the intersection and the union,
+  // without building them
+  long long and_cardinality(const roaring_bitmap &_roaring_bitmap) const;
+  long long or_cardinality(const roaring_bitmap &_roaring_bitmap) const;
+
+  bool operator == (const roaring_bitmap &_roaring_bitmap) const;
+  bool operator != (const roaring_bitmap &_roaring_bitmap) const;
+
+  // a my_bitset of the given size, or of size maximum() + 1,
+  // throws if a value does not fit
+  my_bitset to_my_bitset() const;
+  my_bitset to_my_bitset(const int &size) const;
+};
+
+///////////////////////////////////////
+// container
+
+const int roaring_bitmap::array_max;
+const int roaring_bitmap::bitmap_words;
+
+roaring_bitmap::container::container(){
+  this->type = roaring_bitmap::ARRAY;
+  this->cardinality = 0;
+}
+
+bool roaring_bitmap::container::contains(const unsigned short &value) const{
+  if(this->type == roaring_bitmap::ARRAY)
+    return std::binary_search(this->values.begin(), this->values.end(), value);
+
+  if(this->type == roaring_bitmap::BITMAP)
+    return (bool)((this->words[value >> 6] >> (value & 63)) & 1);
+
+  int run = this->find_run(value);
+  return (run >= 0) && ((int)value <= (int)this->values[2 * run] + this->values[2 * run + 1]);
+}
+
+int roaring_bitmap::container::find_run(const unsigned short &value) const{
+  int low = 0, high = ((int)this->values.size() / 2) - 1;
+  while(low < high){
+    int mid = low + ((high - low + 1) / 2);
+    if(this->values[2 * mid] <= value) low = mid;
+    else high = mid - 1;
+  }
+  return (((high >= 0) && (this->values[2 * low] <= value)) ? low : -1);
+}
+
+void roaring_bitmap::container::add_to_runs(const unsigned short &value){
+  int run = this->find_run(value);
+  int runs = (int)this->values.size() / 2;
+  bool after = (run >= 0) && ((int)value == (int)this->values[2 * run] + this->values[2 * run + 1] + 1);
+  bool before = (run + 1 < runs) && ((int)value + 1 == (int)this->values[2 * (run + 1)]);
+
+  if(after && before) {
+    // the value joins two runs
+    this->values[2 * run + 1] = (unsigned short)(this->values[2 * run + 1] + this->values[2 * run + 3] + 2);
+    this->values.erase(this->values.begin() + 2 * (run + 1), this->values.begin() + 2 * (run + 2));
+  }
+  else if(after) {
+    ++this->values[2 * run + 1];
+  }
+  else if(before) {
+    this->values[2 * (run + 1)] = value;
+    ++this->values[2 * (run + 1) + 1];
+  }
+  else {
+    unsigned short run_values[2] = {value, 0};
+    this->values.insert(this->values.begin() + 2 * (run + 1), run_values, run_values + 2);
+  }
+  ++this->cardinality;
+  this->optimize();
+}
+
+void roaring_bitmap::container::remove_from_runs(const unsigned short &value){
+  int run = this->find_run(value);
+  int start = this->values[2 * run], last = start + this->values[2 * run + 1];
+
+  if(start == last) {
+    this->values.erase(this->values.begin() + 2 * run, this->values.begin() + 2 * (run + 1));
+  }
+  else if((int)value == start) {
+    ++this->values[2 * run];
+    --this->values[2 * run + 1];
+  }
+  else if((int)value == last) {
+    --this->values[2 * run + 1];
+  }
+  else {
+    // the run is split around the value
+    this->values[2 * run + 1] = (unsigned short)(value - start - 1);
+    unsigned short run_values[2] = {(unsigned short)(value + 1), (unsigned short)(last - value - 1)};
+    this->values.insert(this->values.begin() + 2 * (run + 1), run_values, run_values + 2);
+  }
+  --this->cardinality;
+  this->optimize();
+}
+
+bool roaring_bitmap::container::add(const unsigned short &value){
+  if(this->type == roaring_bitmap::RUN) {
+    if(this->contains(value)) return false;
+    this->add_to_runs(value);
+    return true;
+  }
+
+  if(this->type == roaring_bitmap::BITMAP) {
+    unsigned long long &word = this->words[value >> 6];
+    unsigned long long mask = 1ULL << (value & 63);
+    if(word & mask) return false;
+    word |= mask;
+    ++this->cardinality;
+    return true;
+  }
+
+  std::vector<unsigned short>::iterator it =
+      std::lower_bound(this->values.begin(), this->values.end(), value);
+  if((it != this->values.end()) && (*it == value)) return false;
+  this->values.insert(it, value);
+  ++this->cardinality;
+  if(this->cardinality > roaring_bitmap::array_max) this->to_bitmap();
+  return true;
+}
+
+bool roaring_bitmap::container::remove(const unsigned short &value){
+  if(!this->contains(value)) return false;
+  if(this->type == roaring_bitmap::RUN) {
+    this->remove_from_runs(value);
+    return true;
+  }
+
+  if(this->type == roaring_bitmap::BITMAP) {
+    this->words[value >> 6] &= ~(1ULL << (value & 63));
+    --this->cardinality;
+    if(this->cardinality <= roaring_bitmap::array_max) this->to_array();
+    return true;
+  }
+
+  this->values.erase(std::lower_bound(this->values.begin(), this->values.end(), value));
+  --this->cardinality;
+  return true;
+}
+
+void roaring_bitmap::container::fill_words(unsigned long long *target) const{
+  if(this->type == roaring_bitmap::ARRAY) {
+    for(int i = 0; i < (int)this->values.size(); ++i)
+      target[this->values[i] >> 6] |= 1ULL << (this->values[i] & 63);
+  }
+  else if(this->type == roaring_bitmap::BITMAP) {
+    bitset_kernels::or_blocks(target, target, &this->words[0], roaring_bitmap::bitmap_words);
+  }
+  else {
+    for(int i = 0; i < (int)this->values.size(); i += 2)
+      roaring_bitmap::set_range(target, this->values[i], this->values[i] + this->values[i + 1]);
+  }
+}
+
+int roaring_bitmap::container::runs_count() const{
+  if(this->type == roaring_bitmap::RUN)
+    return (int)this->values.size() / 2;
+
+  int result = 0;
+  if(this->type == roaring_bitmap::ARRAY) {
+    for(int i = 0; i < (int)this->values.size(); ++i)
+      if((i == 0) || (this->values[i] != this->values[i - 1] + 1)) ++result;
+    return result;
+  }
+
+  // a run starts at every set bit whose lower neighbour is clear
+  unsigned long long previous = 0;
+  for(int i = 0; i < roaring_bitmap::bitmap_words; ++i){
+    unsigned long long word = this->words[i];
+    result += bit_ops::popcount(word & ~((word << 1) | (previous >> 63)));
+    previous = word;
+  }
+  return result;
+}
+
+template<typename function>
+void roaring_bitmap::container::for_each(const unsigned int &high, function f) const{
+  unsigned int base = high << 16;
+  if(this->type == roaring_bitmap::ARRAY) {
+    for(int i = 0; i < (int)this->values.size(); ++i)
+      f(base | this->values[i]);
+  }
+  else if(this->type == roaring_bitmap::BITMAP) {
+    for(int i = 0; i < roaring_bitmap::bitmap_words; ++i){
+      unsigned long long word = this->words[i];
+      while(word != 0){
+        f(base | (unsigned int)((i << 6) + bit_ops::count_trailing_zeros(word)));
+        word &= word - 1;
+      }
+    }
+  }
+  else {
+    for(int i = 0; i < (int)this->values.size(); i += 2){
+      int last = this->values[i] + this->values[i + 1];
+      for(int v = this->values[i]; v <= last; ++v)
+        f(base | (unsigned int)v);
+    }
+  }
+}
+
+unsigned short roaring_bitmap::container::minimum() const{
+  if(this->type != roaring_bitmap::BITMAP)
+    return this->values[0];
+  int i = 0;
+  while(this->words[i] == 0) ++i;
+  return (unsigned short)((i << 6) + bit_ops::count_trailing_zeros(this->words[i]));
+}
+
+unsigned short roaring_bitmap::container::maximum() const{
+  if(this->type == roaring_bitmap::ARRAY)
+    return this->values.back();
+  if(this->type == roaring_bitmap::RUN)
+    return (unsigned short)(this->values[this->values.size() - 2] + this->values.back());
+  int i = roaring_bitmap::bitmap_words - 1;
+  while(this->words[i] == 0) --i;
+  return (unsigned short)((i << 6) + 63 - bit_ops::count_leading_zeros(this->words[i]));
+}
+
+long long roaring_bitmap::container::size_bytes() const{
+  return (long long)(this->values.capacity() * sizeof(unsigned short) +
+      this->words.capacity() * sizeof(unsigned long long));
+}
+
+void roaring_bitmap::container::to_array(){
+  if(this->type == roaring_bitmap::ARRAY) return;
+
+  std::vector<unsigned short> result;
+  result.reserve(this->cardinality);
+  this->for_each(0, [&result](const unsigned int &value){ result.push_back((unsigned short)value); });
+  this->values.swap(result);
+  std::vector<unsigned long long>().swap(this->words);
+  this->type = roaring_bitmap::ARRAY;
+}
+
+void roaring_bitmap::container::to_bitmap(){
+  if(this->type == roaring_bitmap::BITMAP) return;
+
+  std::vector<unsigned long long> result(roaring_bitmap::bitmap_words, 0);
+  this->fill_words(&result[0]);
+  this->words.swap(result);
+  std::vector<unsigned short>().swap(this->values);
+  this->type = roaring_bitmap::BITMAP;
+}
+
+void roaring_bitmap::container::to_runs(){
+  if(this->type == roaring_bitmap::RUN) return;
+
+  std::vector<unsigned short> result;
+  result.reserve(2 * this->runs_count());
+  int start = -1, last = -1;
+  this->for_each(0, [&](const unsigned int &value){
+    if((start < 0) || ((int)value != last + 1)) {
+      if(start >= 0) result.push_back((unsigned short)start), result.push_back((unsigned short)(last - start));
+      start = (int)value;
+    }
+    last = (int)value;
+  });
+  if(start >= 0) result.push_back((unsigned short)start), result.push_back((unsigned short)(last - start));
+
+  this->values.swap(result);
+  std::vector<unsigned long long>().swap(this->words);
+  this->type = roaring_bitmap::RUN;
+}
+
+void roaring_bitmap::container::optimize(){
+  long long array_bytes = ((this->cardinality <= roaring_bitmap::array_max) ?
+      (2LL * this->cardinality) : (1LL << 62));
+  long long bitmap_bytes = 8LL * roaring_bitmap::bitmap_words;
+  long long run_bytes = 4LL * this->runs_count();
+
+  if((run_bytes < array_bytes) && (run_bytes < bitmap_bytes)) this->to_runs();
+  else if(array_bytes <= bitmap_bytes) this->to_array();
+  else this->to_bitmap();
+}
+
+void roaring_bitmap::container::from_words(container &result, std::vector<unsigned long long> &source){
+  result.cardinality = (int)bitset_kernels::count_blocks(&source[0], roaring_bitmap::bitmap_words);
+  result.type = roaring_bitmap::BITMAP;
+  result.values.clear();
+  result.words.swap(source);
+  if(result.cardinality <= roaring_bitmap::array_max) result.to_array();
+}
+
+///////////////////////////////////////
+// helpers
+
+int roaring_bitmap::find_key(const unsigned short &key) const{
+  std::vector<unsigned short>::const_iterator it =
+      std::lower_bound(this->keys.begin(), this->keys.end(), key);
+  if((it == this->keys.end()) || (*it != key)) return -1;
+  return (int)(it - this->keys.begin());
+}
+
+// sets the bits first to last, inclusive
+void roaring_bitmap::set_range(unsigned long long *target, const int &first, const int &last){
+  int first_word = first >> 6, last_word = last >> 6;
+  unsigned long long first_mask = ~0ULL << (first & 63);
+  unsigned long long last_mask = ~0ULL >> (63 - (last & 63));
+  if(first_word == last_word) {
+    target[first_word] |= first_mask & last_mask;
+    return;
+  }
+  target[first_word] |= first_mask;
+  for(int i = first_word + 1; i < last_word; ++i) target[i] = ~0ULL;
+  target[last_word] |= last_mask;
+}
+
+// counts the set bits first to last, inclusive
+int roaring_bitmap::count_range(const unsigned long long *source, const int &first, const int &last){
+  int first_word = first >> 6, last_word = last >> 6;
+  unsigned long long first_mask = ~0ULL << (first & 63);
+  unsigned long long last_mask = ~0ULL >> (63 - (last & 63));
+  if(first_word == last_word)
+    return bit_ops::popcount(source[first_word] & first_mask & last_mask);
+
+  int result = bit_ops::popcount(source[first_word] & first_mask) +
+      bit_ops::popcount(source[last_word] & last_mask);
+  if(last_word - first_word > 1)
+    result += (int)bitset_kernels::count_blocks(source + first_word + 1, last_word - first_word - 1);
+  return result;
+}
+
+///////////////////////////////////////
+// container operations
+
+void roaring_bitmap::and_containers(container &result, const container &c1, const container &c2){
+  if((c1.type == roaring_bitmap::ARRAY) && (c2.type == roaring_bitmap::ARRAY)) {
+    result.type = roaring_bitmap::ARRAY;
+    result.values.clear();
+    std::set_intersection(c1.values.begin(), c1.values.end(),
+        c2.values.begin(), c2.values.end(), std::back_inserter(result.values));
+    result.cardinality = (int)result.values.size();
+    return;
+  }
+
+  // an array against anything else is filtered by lookups
+  if((c1.type == roaring_bitmap::ARRAY) || (c2.type == roaring_bitmap::ARRAY)) {
+    const container &array = ((c1.type == roaring_bitmap::ARRAY) ? c1 : c2);
+    const container &other = ((c1.type == roaring_bitmap::ARRAY) ? c2 : c1);
+    result.type = roaring_bitmap::ARRAY;
+    result.values.clear();
+    for(int i = 0; i < (int)array.values.size(); ++i)
+      if(other.contains(array.values[i])) result.values.push_back(array.values[i]);
+    result.cardinality = (int)result.values.size();
+    return;
+  }
+
+  // runs against runs intersect the intervals
+  if((c1.type == roaring_bitmap::RUN) && (c2.type == roaring_bitmap::RUN)) {
+    result.type = roaring_bitmap::RUN;
+    result.values.clear();
+    result.words.clear();
+    result.cardinality = 0;
+    int i = 0, j = 0;
+    while((i < (int)c1.values.size()) && (j < (int)c2.values.size())){
+      int start1 = c1.values[i], last1 = start1 + c1.values[i + 1];
+      int start2 = c2.values[j], last2 = start2 + c2.values[j + 1];
+      int start = std::max(start1, start2), last = std::min(last1, last2);
+      if(start <= last) {
+        result.values.push_back((unsigned short)start);
+        result.values.push_back((unsigned short)(last - start));
+        result.cardinality += last - start + 1;
+      }
+      if(last1 < last2) i += 2;
+      else j += 2;
+    }
+    if(result.cardinality > 0) result.optimize();
+    return;
+  }
+
+  // bitmaps (or a bitmap and runs) are combined word by word
+  std::vector<unsigned long long> words1(roaring_bitmap::bitmap_words, 0);
+  c1.fill_words(&words1[0]);
+  if(c2.type == roaring_bitmap::BITMAP) {
+    bitset_kernels::and_blocks(&words1[0], &words1[0], &c2.words[0], roaring_bitmap::bitmap_words);
+  }
+  else {
+    std::vector<unsigned long long> words2(roaring_bitmap::bitmap_words, 0);
+    c2.fill_words(&words2[0]);
+    bitset_kernels::and_blocks(&words1[0], &words1[0], &words2[0], roaring_bitmap::bitmap_words);
+  }
+  container::from_words(result, words1);
+}
+
+void roaring_bitmap::or_containers(container &result, const container &c1, const container &c2){
+  if((c1.type == roaring_bitmap::ARRAY) && (c2.type == roaring_bitmap::ARRAY) &&
+      (c1.cardinality + c2.cardinality <= roaring_bitmap::array_max)) {
+    result.type = roaring_bitmap::ARRAY;
+    result.values.clear();
+    std::set_union(c1.values.begin(), c1.values.end(),
+        c2.values.begin(), c2.values.end(), std::back_inserter(result.values));
+    result.cardinality = (int)result.values.size();
+    return;
+  }
+
+  // runs against runs merge the intervals, joining the adjacent ones
+  if((c1.type == roaring_bitmap::RUN) && (c2.type == roaring_bitmap::RUN)) {
+    result.type = roaring_bitmap::RUN;
+    result.values.clear();
+    result.words.clear();
+    result.cardinality = 0;
+    int i = 0, j = 0, start = -1, last = -2;
+    while((i < (int)c1.values.size()) || (j < (int)c2.values.size())){
+      const container *c;
+      int *k;
+      if((j >= (int)c2.values.size()) ||
+          ((i < (int)c1.values.size()) && (c1.values[i] <= c2.values[j])))
+        c = &c1, k = &i;
+      else
+        c = &c2, k = &j;
+
+      int next_start = c->values[*k], next_last = next_start + c->values[*k + 1];
+      *k += 2;
+      if(next_start <= last + 1) {
+        last = std::max(last, next_last);
+        continue;
+      }
+      if(start >= 0) {
+        result.values.push_back((unsigned short)start);
+        result.values.push_back((unsigned short)(last - start));
+        result.cardinality += last - start + 1;
+      }
+      start = next_start, last = next_last;
+    }
+    result.values.push_back((unsigned short)start);
+    result.values.push_back((unsigned short)(last - start));
+    result.cardinality += last - start + 1;
+    result.optimize();
+    return;
+  }
+
+  std::vector<unsigned long long> words(roaring_bitmap::bitmap_words, 0);
+  c1.fill_words(&words[0]);
+  c2.fill_words(&words[0]);
+  container::from_words(result, words);
+}
+
+void roaring_bitmap::xor_containers(container &result, const container &c1, const container &c2){
+  if((c1.type == roaring_bitmap::ARRAY) && (c2.type == roaring_bitmap::ARRAY) &&
+      (c1.cardinality + c2.cardinality <= roaring_bitmap::array_max)) {
+    result.type = roaring_bitmap::ARRAY;
+    result.values.clear();
+    std::set_symmetric_difference(c1.values.begin(), c1.values.end(),
+        c2.values.begin(), c2.values.end(), std::back_inserter(result.values));
+    result.cardinality = (int)result.values.size();
+    return;
+  }
+
+  std::vector<unsigned long long> words1(roaring_bitmap::bitmap_words, 0);
+  std::vector<unsigned long long> words2(roaring_bitmap::bitmap_words, 0);
+  c1.fill_words(&words1[0]);
+  c2.fill_words(&words2[0]);
+  bitset_kernels::xor_blocks(&words1[0], &words1[0], &words2[0], roaring_bitmap::bitmap_words);
+  container::from_words(result, words1);
+}
+
+long long roaring_bitmap::run_array_count(const container &runs, const container &array){
+  long long result = 0;
+  int i = 0;
+  for(int j = 0; (j < (int)array.values.size()) && (i < (int)runs.values.size()); ){
+    int value = array.values[j];
+    int start = runs.values[i], last = start + runs.values[i + 1];
+    if(value < start) ++j;
+    else if(value > last) i += 2;
+    else ++result, ++j;
+  }
+  return result;
+}
+
+long long roaring_bitmap::and_count(const container &c1, const container &c2){
+  if((c1.type == roaring_bitmap::BITMAP) && (c2.type == roaring_bitmap::BITMAP))
+    return bitset_kernels::count_and_blocks(&c1.words[0], &c2.words[0], roaring_bitmap::bitmap_words);
+
+  if((c1.type == roaring_bitmap::ARRAY) && (c2.type == roaring_bitmap::ARRAY)) {
+    long long result = 0;
+    int i = 0, j = 0;
+    while((i < (int)c1.values.size()) && (j < (int)c2.values.size())){
+      if(c1.values[i] < c2.values[j]) ++i;
+      else if(c1.values[i] > c2.values[j]) ++j;
+      else ++result, ++i, ++j;
+    }
+    return result;
+  }
+
+  if((c1.type == roaring_bitmap::RUN) && (c2.type == roaring_bitmap::RUN)) {
+    long long result = 0;
+    int i = 0, j = 0;
+    while((i < (int)c1.values.size()) && (j < (int)c2.values.size())){
+      int last1 = c1.values[i] + c1.values[i + 1];
+      int last2 = c2.values[j] + c2.values[j + 1];
+      int start = std::max((int)c1.values[i], (int)c2.values[j]);
+      int last = std::min(last1, last2);
+      if(start <= last) result += last - start + 1;
+      if(last1 < last2) i += 2;
+      else j += 2;
+    }
+    return result;
+  }
+
+  if((c1.type == roaring_bitmap::RUN) && (c2.type == roaring_bitmap::ARRAY))
+    return roaring_bitmap::run_array_count(c1, c2);
+  if((c1.type == roaring_bitmap::ARRAY) && (c2.type == roaring_bitmap::RUN))
+    return roaring_bitmap::run_array_count(c2, c1);
+
+  if((c1.type == roaring_bitmap::ARRAY) || (c2.type == roaring_bitmap::ARRAY)) {
+    const container &array = ((c1.type == roaring_bitmap::ARRAY) ? c1 : c2);
+    const container &bitmap = ((c1.type == roaring_bitmap::ARRAY) ? c2 : c1);
+    long long result = 0;
+    for(int i = 0; i < (int)array.values.size(); ++i)
+      result += (bitmap.words[array.values[i] >> 6] >> (array.values[i] & 63)) & 1;
+    return result;
+  }
+
+  // runs against a bitmap
+  const container &runs = ((c1.type == roaring_bitmap::RUN) ? c1 : c2);
+  const container &bitmap = ((c1.type == roaring_bitmap::RUN) ? c2 : c1);
+  long long result = 0;
+  for(int i = 0; i < (int)runs.values.size(); i += 2)
+    result += roaring_bitmap::count_range(&bitmap.words[0], runs.values[i], runs.values[i] + runs.values[i + 1]);
+  return result;
+}
+
+///////////////////////////////////////
+// public interface
+
+roaring_bitmap::roaring_bitmap(){
+}
+
+roaring_bitmap::roaring_bitmap(const my_bitset &_my_bitset){
+  // the values are 32 bits
+  if(_my_bitset.size() > 0x100000000LL)
+    throw std::overflow_error("roaring_bitmap::roaring_bitmap: overflow_error");
+  int blocks = _my_bitset.blocks_count();
+  int chunks = (blocks + roaring_bitmap::bitmap_words - 1) / roaring_bitmap::bitmap_words;
+  std::vector<unsigned long long> words;
+
+  for(int chunk = 0; chunk < chunks; ++chunk){
+    // my_bitset blocks are most significant bit first
+    words.assign(roaring_bitmap::bitmap_words, 0);
+    int first = chunk * roaring_bitmap::bitmap_words;
+    int last = std::min(blocks, first + roaring_bitmap::bitmap_words);
+    bool empty = true;
+    for(int i = first; i < last; ++i){
+      unsigned long long block = _my_bitset.get_block(i);
+      if(block == 0) continue;
+      words[i - first] = bit_ops::reverse(block);
+      empty = false;
+    }
+    if(empty) continue;
+
+    container c;
+    container::from_words(c, words);
+    c.optimize();
+    this->keys.push_back((unsigned short)chunk);
+    this->containers.push_back(c);
+  }
+}
+
+bool roaring_bitmap::contains(const unsigned int &value) const{
+  int index = this->find_key((unsigned short)(value >> 16));
+  return (index >= 0) && this->containers[index].contains((unsigned short)(value & 0xFFFF));
+}
+
+bool roaring_bitmap::add(const unsigned int &value){
+  unsigned short key = (unsigned short)(value >> 16);
+  std::vector<unsigned short>::iterator it =
+      std::lower_bound(this->keys.begin(), this->keys.end(), key);
+  int index = (int)(it - this->keys.begin());
+  if((it == this->keys.end()) || (*it != key)) {
+    this->keys.insert(it, key);
+    this->containers.insert(this->containers.begin() + index, container());
+  }
+  return this->containers[index].add((unsigned short)(value & 0xFFFF));
+}
+
+bool roaring_bitmap::remove(const unsigned int &value){
+  int index = this->find_key((unsigned short)(value >> 16));
+  if(index < 0) return false;
+  if(!this->containers[index].remove((unsigned short)(value & 0xFFFF))) return false;
+  if(this->containers[index].cardinality == 0) {
+    this->keys.erase(this->keys.begin() + index);
+    this->containers.erase(this->containers.begin() + index);
+  }
+  return true;
+}
+
+long long roaring_bitmap::cardinality() const{
+  long long result = 0;
+  for(int i = 0; i < (int)this->containers.size(); ++i)
+    result += this->containers[i].cardinality;
+  return result;
+}
+
+bool roaring_bitmap::empty() const{
+  return this->keys.empty();
+}
+
+unsigned int roaring_bitmap::minimum() const{
+  if(this->keys.empty())
+    throw std::out_of_range("roaring_bitmap::minimum: empty_bitmap");
+  return (((unsigned int)this->keys.front()) << 16) | this->containers.front().minimum();
+}
+
+unsigned int roaring_bitmap::maximum() const{
+  if(this->keys.empty())
+    throw std::out_of_range("roaring_bitmap::maximum: empty_bitmap");
+  return (((unsigned int)this->keys.back()) << 16) | this->containers.back().maximum();
+}
+
+template<typename function>
+void roaring_bitmap::for_each(function f) const{
+  for(int i = 0; i < (int)this->keys.size(); ++i)
+    this->containers[i].for_each(this->keys[i], f);
+}
+
+void roaring_bitmap::run_optimize(){
+  for(int i = 0; i < (int)this->containers.size(); ++i)
+    this->containers[i].optimize();
+}
+
+long long roaring_bitmap::memory_bytes() const{
+  long long result = (long long)(this->keys.capacity() * sizeof(unsigned short) +
+      this->containers.capacity() * sizeof(container));
+  for(int i = 0; i < (int)this->containers.size(); ++i)
+    result += this->containers[i].size_bytes();
+  return result;
+}
+
+roaring_bitmap roaring_bitmap::operator & (const roaring_bitmap &_roaring_bitmap) const{
+  roaring_bitmap result;
+  int i = 0, j = 0;
+  while((i < (int)this->keys.size()) && (j < (int)_roaring_bitmap.keys.size())){
+    if(this->keys[i] < _roaring_bitmap.keys[j]) ++i;
+    else if(this->keys[i] > _roaring_bitmap.keys[j]) ++j;
+    else {
+      container c;
+      roaring_bitmap::and_containers(c, this->containers[i], _roaring_bitmap.containers[j]);
+      if(c.cardinality > 0) {
+        result.keys.push_back(this->keys[i]);
+        result.containers.push_back(c);
+      }
+      ++i, ++j;
+    }
+  }
+  return result;
+}
+
+roaring_bitmap roaring_bitmap::operator | (const roaring_bitmap &_roaring_bitmap) const{
+  roaring_bitmap result;
+  int i = 0, j = 0;
+  while((i < (int)this->keys.size()) || (j < (int)_roaring_bitmap.keys.size())){
+    if((j >= (int)_roaring_bitmap.keys.size()) ||
+        ((i < (int)this->keys.size()) && (this->keys[i] < _roaring_bitmap.keys[j]))) {
+      result.keys.push_back(this->keys[i]);
+      result.containers.push_back(this->containers[i++]);
+    }
+    else if((i >= (int)this->keys.size()) || (this->keys[i] > _roaring_bitmap.keys[j])) {
+      result.keys.push_back(_roaring_bitmap.keys[j]);
+      result.containers.push_back(_roaring_bitmap.containers[j++]);
+    }
+    else {
+      container c;
+      roaring_bitmap::or_containers(c, this->containers[i], _roaring_bitmap.containers[j]);
+      result.keys.push_back(this->keys[i]);
+      result.containers.push_back(c);
+      ++i, ++j;
+    }
+  }
+  return result;
+}
+
+roaring_bitmap roaring_bitmap::operator ^ (const roaring_bitmap &_roaring_bitmap) const{
+  roaring_bitmap result;
+  int i = 0, j = 0;
+  while((i < (int)this->keys.size()) || (j < (int)_roaring_bitmap.keys.size())){
+    if((j >= (int)_roaring_bitmap.keys.size()) ||
+        ((i < (int)this->keys.size()) && (this->keys[i] < _roaring_bitmap.keys[j]))) {
+      result.keys.push_back(this->keys[i]);
+      result.containers.push_back(this->containers[i++]);
+    }
+    else if((i >= (int)this->keys.size()) || (this->keys[i] > _roaring_bitmap.keys[j])) {
+      result.keys.push_back(_roaring_bitmap.keys[j]);
+      result.containers.push_back(_roaring_bitmap.containers[j++]);
+    }
+    else {
+      container c;
+      roaring_bitmap::xor_containers(c, this->containers[i], _roaring_bitmap.containers[j]);
+      if(c.cardinality > 0) {
+        result.keys.push_back(this->keys[i]);
+        result.containers.push_back(c);
+      }
+      ++i, ++j;
+    }
+  }
+  return result;
+}
+
+roaring_bitmap& roaring_bitmap::operator &= (const roaring_bitmap &_roaring_bitmap){
+  (*this) = (*this) & _roaring_bitmap;
+  return (*this);
+}
+
+roaring_bitmap& roaring_bitmap::operator |= (const roaring_bitmap &_roaring_bitmap){
+  (*this) = (*this) | _roaring_bitmap;
+  return (*this);
+}
+
+roaring_bitmap& roaring_bitmap::operator ^= (const roaring_bitmap &_roaring_bitmap){
+  (*this) = (*this) ^ _roaring_bitmap;
+  return (*this);
+}
+
+long long roaring_bitmap::and_cardinality(const roaring_bitmap &_roaring_bitmap) const{
+  long long result = 0;
+  int i = 0, j = 0;
+  while((i < (int)this->keys.size()) && (j < (int)_roaring_bitmap.keys.size())){
+    if(this->keys[i] < _roaring_bitmap.keys[j]) ++i;
+    else if(this->keys[i] > _roaring_bitmap.keys[j]) ++j;
+    else result += roaring_bitmap::and_count(this->containers[i++], _roaring_bitmap.containers[j++]);
+  }
+  return result;
+}
+
+long long roaring_bitmap::or_cardinality(const roaring_bitmap &_roaring_bitmap) const{
+  return this->cardinality() + _roaring_bitmap.cardinality() - this->and_cardinality(_roaring_bitmap);
+}
+
+// the same values may be held in different container types,
+// so the containers are compared by their intersection
+bool roaring_bitmap::operator == (const roaring_bitmap &_roaring_bitmap) const{
+  if(this->keys != _roaring_bitmap.keys) return false;
+  for(int i = 0; i < (int)this->containers.size(); ++i){
+    const container &c1 = this->containers[i];
+    const container &c2 = _roaring_bitmap.containers[i];
+    if(c1.cardinality != c2.cardinality) return false;
+    if(roaring_bitmap::and_count(c1, c2) != c1.cardinality) return false;
+  }
+  return true;
+}
+
+bool roaring_bitmap::operator != (const roaring_bitmap &_roaring_bitmap) const{
+  return !(this->operator == (_roaring_bitmap));
+}
+
+my_bitset roaring_bitmap::to_my_bitset() const{
+  if(this->keys.empty()) return my_bitset();
+  unsigned int maximum = this->maximum();
+  if(maximum >= 0x7FFFFFFFU)
+    throw std::overflow_error("roaring_bitmap::to_my_bitset: overflow_error");
+  return this->to_my_bitset((int)maximum + 1);
+}
+
+my_bitset roaring_bitmap::to_my_bitset(const int &size) const{
+  if(size < 0)
+    throw std::runtime_error("roaring_bitmap::to_my_bitset: invalid_size");
+  if(!this->keys.empty() && (this->maximum() >= (unsigned int)size))
+    throw std::out_of_range("roaring_bitmap::to_my_bitset: value_out_of_range");
+
+  my_bitset result(size, 0);
+  std::vector<unsigned long long> words;
+  for(int i = 0; i < (int)this->keys.size(); ++i){
+    words.assign(roaring_bitmap::bitmap_words, 0);
+    this->containers[i].fill_words(&words[0]);
+
+    int first = this->keys[i] * roaring_bitmap::bitmap_words;
+    int last = std::min(result.blocks_count(), first + roaring_bitmap::bitmap_words);
+    for(int b = first; b < last; ++b)
+      if(words[b - first] != 0) result.set_block(b, bit_ops::reverse(words[b - first]));
+  }
+  return result;
+}
+
+#endif /* ROARING_BITMAP_H_ */
@@ -0,0 +1,26 @@
+#ifndef WORKER_THREADS_H_
+#define WORKER_THREADS_H_
+
+#include <thread>
+
+// the number of threads a parallel operation starts. the caller passes
+// the count it was asked for, 0 or less meaning one per hardware thread,
+// and how many threads its work can keep busy (its own work size divided
+// by its own grain), the result is between 1 and both of them
+
+class worker_threads {
+public:
+  int static count(const int &requested, const long long &useful);
+};
+
+///////////////////////////////////////
+
+int worker_threads::count(const int &requested, const long long &useful){
+  int result = requested;
+  // hardware_concurrency may not know and return 0
+  if(result <= 0) result = (int)std::thread::hardware_concurrency();
+  if(result > useful) result = (int)useful;
+  return ((result < 1) ? 1 : result);
+}
+
+#endif /* WORKER_THREADS_H_ */
@@ -0,0 +1,88 @@
+// atomic_bitset test
+//
+// threads racing on the same bits: test_and_set gives each bit to exactly
+// one of them, concurrent resets and word operations leave the bits the
+// serial versions would, and two threads that each set a bit and then
+// test the other's with seq_cst never both miss (the store buffering
+// pattern). meant to run under tsan as well.
+
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "atomic_bitset.h"
+#include "test_check.h"
+
+const int threads_count = 4;
+
+void test_exactly_once(){
+  const int size = 100003;
+  atomic_bitset bits(size);
+  std::vector<int> wins(threads_count, 0);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < threads_count; ++t)
+    threads.push_back(std::thread([&bits, &wins, t, size](){
+      for(int i = 0; i < size; ++i)
+        if(!bits.test_and_set((int)(((long long)i * 7 + t * 13) % size))) ++wins[t];
+    }));
+  for(int t = 0; t < threads_count; ++t) threads[t].join();
+
+  int total = 0;
+  for(int t = 0; t < threads_count; ++t) total += wins[t];
+  CHECK(total == size);
+  CHECK(bits.count() == size);
+  my_bitset copy = bits.to_my_bitset();
+  CHECK((copy.size() == size) && (copy.count() == size));
+
+  // every third bit reset, each thread its own share
+  threads.clear();
+  for(int t = 0; t < threads_count; ++t)
+    threads.push_back(std::thread([&bits, t, size](){
+      for(int i = t; i < size; i += threads_count)
+        if(i % 3 == 0) CHECK(bits.test_and_reset(i, std::memory_order_relaxed));
+    }));
+  for(int t = 0; t < threads_count; ++t) threads[t].join();
+  CHECK(bits.count() == size - (size + 2) / 3);
+  for(int i = 0; i < size; ++i)
+    CHECK(bits.test(i) == (i % 3 != 0));
+
+  // the unused bits of the last block stay clear
+  bits.clear();
+  CHECK(bits.count() == 0);
+  CHECK(bits.fetch_or_word(bits.blocks_count() - 1, ~0ULL) == 0);
+  CHECK(bits.count() == size % 64);
+  CHECK(bits.fetch_and_word(bits.blocks_count() - 1, 0) != 0);
+  CHECK(bits.count() == 0);
+
+  atomic_bitset from(copy);
+  CHECK(from.count() == size);
+  bool thrown = false;
+  try {
+    from.set(size);
+  } catch(std::out_of_range &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+void test_store_buffering(){
+  for(int round = 0; round < 2000; ++round){
+    atomic_bitset bits(2);
+    bool seen[2] = {false, false};
+    std::thread other([&bits, &seen](){
+      bits.test_and_set(1, std::memory_order_seq_cst);
+      seen[1] = bits.test(0, std::memory_order_seq_cst);
+    });
+    bits.test_and_set(0, std::memory_order_seq_cst);
+    seen[0] = bits.test(1, std::memory_order_seq_cst);
+    other.join();
+    CHECK(seen[0] || seen[1]);
+  }
+}
+
+int main(){
+  test_exactly_once();
+  test_store_buffering();
+  return test_result("atomic_bitset_test");
+}
@@ -0,0 +1,60 @@
+// big_integer test
+//
+// the magnitude constructor against the integer one: random values held
+// in bitsets of every width from their bit length to 130 bits, so that
+// most of them do not end on a whole byte, must give the same number,
+// the same strings in every base and the same arithmetic results.
+
+#include <cstdio>
+#include <string>
+
+#include "big_integer.h"
+#include "test_check.h"
+
+// value in the low width bits of a bitset of width bits, big-endian
+my_bitset magnitude_of(const unsigned long long &value, const int &width){
+  my_bitset result(width, false);
+  for(int i = 0; (i < 64) && (i < width); ++i)
+    if((value >> i) & 1) result.set(width - 1 - i, true);
+  return result;
+}
+
+int bit_length(const unsigned long long &value){
+  int result = 0;
+  while((result < 64) && ((value >> result) != 0)) ++result;
+  return result;
+}
+
+int main(){
+  for(int round = 0; round < 3000; ++round){
+    unsigned long long value = test_random() >> (test_random() % 64);
+    if(round < 10) value = (unsigned long long)round;
+    if(round == 10) value = 0xABCULL;
+    signed char sign = (signed char)((value == 0) ? 0 : ((test_random() % 2) ? 1 : -1));
+    int width = bit_length(value) + (int)(test_random() % (131 - bit_length(value)));
+    if(round == 10) width = 12;
+
+    big_integer expected(value, sign);
+    big_integer found(magnitude_of(value, width), sign);
+    CHECK(found == expected);
+    CHECK(found.get_sign() == expected.get_sign());
+    CHECK(found.get_magnitude().size() % my_bitset::get_word_size() == 0);
+    CHECK(found.to_string() == expected.to_string());
+    CHECK(found.to_hex_string() == expected.to_hex_string());
+    CHECK(found.to_bin_string() == expected.to_bin_string());
+    CHECK(found.to_oct_string() == expected.to_oct_string());
+
+    big_integer other((unsigned long long)(test_random() >> 8), 1);
+    CHECK((found + other) == (expected + other));
+    CHECK((found - other) == (expected - other));
+    CHECK((found * other) == (expected * other));
+    CHECK((found / other) == (expected / other));
+    CHECK((found % other) == (expected % other));
+    CHECK((found >> 3) == (expected >> 3));
+  }
+
+  CHECK(big_integer(magnitude_of(0xABCULL, 12), 1).to_hex_string() == big_integer(2748ULL, 1).to_hex_string());
+  CHECK(big_integer(my_bitset(7, false), 1) == big_integer(0ULL, 0));
+
+  return test_result("big_integer_test");
+}
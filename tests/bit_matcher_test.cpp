@@ -0,0 +1,101 @@
+// bit_matcher test
+//
+// random patterns of 1 to 300 characters over alphabets of 1 to 4
+// letters, so there are many matches and the long patterns take several
+// words, against random texts with a copy of the pattern planted half of
+// the time. exact matching is compared with a naive search, approximate
+// matching and the edit distance with the dynamic programming recurrence
+// computed column by column.
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bit_matcher.h"
+#include "test_check.h"
+
+std::string random_string(const int &length, const int &letters){
+  std::string result;
+  for(int i = 0; i < length; ++i)
+    result += (char)('a' + test_random() % letters);
+  return result;
+}
+
+// the ends of the substrings of text within k edits of pattern, column j
+// of the matrix holds the best distance of the pattern prefixes to a
+// substring ending at text[j]
+std::vector<bit_matcher::match> search_reference(const std::string &pattern, const std::string &text, const int &k){
+  int m = (int)pattern.size();
+  std::vector<int> column(m + 1);
+  for(int i = 0; i <= m; ++i) column[i] = i;
+  std::vector<bit_matcher::match> result;
+  for(int j = 0; j < (int)text.size(); ++j){
+    int diagonal = column[0];
+    column[0] = 0;
+    for(int i = 1; i <= m; ++i){
+      int above = column[i];
+      column[i] = std::min(std::min(column[i] + 1, column[i - 1] + 1), diagonal + (pattern[i - 1] != text[j]));
+      diagonal = above;
+    }
+    if(column[m] <= k) {
+      bit_matcher::match found = {j, column[m]};
+      result.push_back(found);
+    }
+  }
+  return result;
+}
+
+int distance_reference(const std::string &pattern, const std::string &text){
+  int m = (int)pattern.size();
+  std::vector<int> column(m + 1);
+  for(int i = 0; i <= m; ++i) column[i] = i;
+  for(int j = 0; j < (int)text.size(); ++j){
+    int diagonal = column[0];
+    column[0] = j + 1;
+    for(int i = 1; i <= m; ++i){
+      int above = column[i];
+      column[i] = std::min(std::min(column[i] + 1, column[i - 1] + 1), diagonal + (pattern[i - 1] != text[j]));
+      diagonal = above;
+    }
+  }
+  return column[m];
+}
+
+int main(){
+  for(int round = 0; round < 400; ++round){
+    int letters = 1 + (int)(test_random() % 4);
+    int m = 1 + (int)(test_random() % ((round % 4 == 0) ? 300 : 80));
+    int n = (int)(test_random() % 400);
+    std::string pattern = random_string(m, letters);
+    std::string text = random_string(n, letters);
+    if((n > m) && (test_random() % 2))
+      text.replace(test_random() % (n - m + 1), m, pattern);
+
+    bit_matcher matcher(pattern);
+    CHECK(matcher.size() == m);
+
+    std::vector<int> expected;
+    for(int i = 0; i + m <= n; ++i)
+      if(text.compare(i, m, pattern) == 0) expected.push_back(i);
+    CHECK(matcher.find_all(text) == expected);
+    CHECK(matcher.find(text.c_str(), n, 0) == (expected.empty() ? -1 : expected[0]));
+    if(expected.size() > 1)
+      CHECK(matcher.find(text.c_str(), n, expected[0] + 1) == expected[1]);
+    my_bitset occurrences = matcher.occurrences(text.c_str(), n);
+    CHECK(occurrences.count() == (long long)expected.size());
+    for(size_t i = 0; i < expected.size(); ++i)
+      CHECK(occurrences.get(expected[i]));
+
+    int k = (int)(test_random() % (m + 2));
+    std::vector<bit_matcher::match> found = matcher.find_approximate(text, k);
+    std::vector<bit_matcher::match> reference = search_reference(pattern, text, k);
+    CHECK(found.size() == reference.size());
+    for(size_t i = 0; (i < found.size()) && (i < reference.size()); ++i)
+      CHECK((found[i].end == reference[i].end) && (found[i].distance == reference[i].distance));
+
+    CHECK(matcher.edit_distance(text) == distance_reference(pattern, text));
+  }
+
+  return test_result("bit_matcher_test");
+}
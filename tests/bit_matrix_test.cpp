@@ -0,0 +1,90 @@
+// bit_matrix test
+//
+// random matrices of sizes across the 64 bits block boundaries: the
+// product, single and multi threaded, against the cubic definition over
+// gf(2), the transpose against the swapped indices, and solve against
+// systems with a known solution, with one checked to be inconsistent
+// whenever the matrix is not of full row rank.
+
+#include <vector>
+
+#include "bit_matrix.h"
+#include "test_check.h"
+
+bit_matrix random_matrix(const int &rows, const int &cols, const int &sparsity){
+  bit_matrix result(rows, cols);
+  for(int i = 0; i < rows; ++i)
+    for(int j = 0; j < cols; ++j)
+      if(test_random() % sparsity == 0) result.set(i, j, true);
+  return result;
+}
+
+my_bitset random_vector(const int &size){
+  my_bitset result(size, 0);
+  for(int i = 0; i < size; ++i)
+    if(test_random() & 1) result.set(i, true);
+  return result;
+}
+
+bit_matrix naive_product(const bit_matrix &a, const bit_matrix &b){
+  bit_matrix result(a.rows_count(), b.cols_count());
+  for(int i = 0; i < a.rows_count(); ++i)
+    for(int k = 0; k < a.cols_count(); ++k)
+      if(a.get(i, k))
+        for(int j = 0; j < b.cols_count(); ++j)
+          if(b.get(k, j)) result.set(i, j, !result.get(i, j));
+  return result;
+}
+
+int main(){
+  for(int round = 0; round < 150; ++round){
+    int n = (int)(test_random() % 150);
+    int m = (int)(test_random() % 150);
+    int p = (int)(test_random() % 150);
+    bit_matrix a = random_matrix(n, m, 2);
+    bit_matrix b = random_matrix(m, p, 2);
+
+    bit_matrix c = a * b;
+    CHECK(c == naive_product(a, b));
+    CHECK(bit_matrix::multiply(a, b, 4) == c);
+    CHECK((a ^ a) == bit_matrix(n, m));
+
+    bit_matrix t = a.transpose();
+    CHECK((t.rows_count() == m) && (t.cols_count() == n));
+    bool swapped = true;
+    for(int i = 0; i < n; ++i)
+      for(int j = 0; j < m; ++j)
+        if(a.get(i, j) != t.get(j, i)) swapped = false;
+    CHECK(swapped);
+    CHECK(t.transpose() == a);
+
+    // a right hand side made from a known solution is always solvable
+    bit_matrix s = random_matrix(n, m, 1 + round % 3);
+    my_bitset rhs = s * random_vector(m);
+    my_bitset x;
+    CHECK(s.solve(rhs, x));
+    CHECK(s * x == rhs);
+
+    int rank = s.rank();
+    CHECK((rank <= n) && (rank <= m));
+    if(rank < n) {
+      bool inconsistent = false;
+      for(int k = 0; (k < 40) && !inconsistent; ++k){
+        my_bitset y = random_vector(n);
+        my_bitset z;
+        if(!s.solve(y, z)) inconsistent = true;
+        else CHECK(s * z == y);
+      }
+      CHECK(inconsistent);
+    }
+
+    CHECK(bit_matrix::identity(n) * s == s);
+    std::vector<my_bitset> rows;
+    for(int i = 0; i < n; ++i) rows.push_back(s.get_row(i));
+    CHECK((n == 0) || (bit_matrix(rows) == s));
+  }
+
+  CHECK(bit_matrix::identity(200).rank() == 200);
+
+  return test_result("bit_matrix_test");
+}
@@ -0,0 +1,111 @@
+// bitset_codec test
+//
+// random bitsets of 0 to 700 bits: the binary, hex and base64 texts
+// against ones written a bit at a time (base64 through a plain rfc 4648
+// encoder), decoded back with and without a bit count, in upper case,
+// without padding and into a larger bitset whose storage is reused, and
+// a wrong character anywhere rejected. a bitset of a few million bits
+// goes through the three formats and back.
+
+#include <cctype>
+#include <stdexcept>
+#include <string>
+
+#include "bitset_codec.h"
+#include "test_check.h"
+
+std::string reference_base64(const std::string &bytes){
+  const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string result;
+  for(size_t i = 0; i < bytes.size(); i += 3){
+    unsigned int value = 0;
+    for(size_t k = 0; k < 3; ++k)
+      value = (value << 8) | ((i + k < bytes.size()) ? (unsigned char)bytes[i + k] : 0);
+    size_t digits = ((bytes.size() - i >= 3) ? 4 : (bytes.size() - i + 1));
+    for(size_t k = 0; k < 4; ++k)
+      result += ((k < digits) ? alphabet[(value >> (18 - 6 * k)) & 63] : '=');
+  }
+  return result;
+}
+
+template<typename decode>
+bool throws(decode f){
+  try {
+    f();
+  } catch(std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+int main(){
+  for(int round = 0; round < 2000; ++round){
+    int n = (int)(test_random() % 700);
+    my_bitset bits(n, false);
+    for(int i = 0; i < n; ++i)
+      if(test_random() & 1) bits.set(i, true);
+
+    std::string binary;
+    for(int i = 0; i < n; ++i) binary += (bits.get(i) ? '1' : '0');
+    CHECK(bitset_codec::to_binary(bits) == binary);
+    my_bitset decoded = bitset_codec::from_binary(binary);
+    CHECK((decoded.size() == n) && (decoded == bits));
+
+    std::string hex;
+    for(int i = 0; i < n; i += 4){
+      int digit = 0;
+      for(int k = 0; k < 4; ++k) digit = 2 * digit + (((i + k < n) && bits.get(i + k)) ? 1 : 0);
+      hex += "0123456789abcdef"[digit];
+    }
+    CHECK(bitset_codec::to_hex(bits) == hex);
+    decoded = bitset_codec::from_hex(hex, n);
+    CHECK((decoded.size() == n) && (decoded == bits));
+    std::string upper = hex;
+    for(size_t i = 0; i < upper.size(); ++i) upper[i] = (char)std::toupper(upper[i]);
+    CHECK(bitset_codec::from_hex(upper, n) == bits);
+
+    std::string bytes;
+    for(int i = 0; i < (n + 7) / 8; ++i){
+      int byte = 0;
+      for(int k = 0; k < 8; ++k) byte = 2 * byte + (((8 * i + k < n) && bits.get(8 * i + k)) ? 1 : 0);
+      bytes += (char)byte;
+    }
+    std::string base64 = reference_base64(bytes);
+    CHECK(bitset_codec::to_base64(bits) == base64);
+    decoded = bitset_codec::from_base64(base64, n);
+    CHECK((decoded.size() == n) && (decoded == bits));
+    CHECK(bitset_codec::from_base64(base64).size() == 8 * (long long)bytes.size());
+    std::string unpadded = base64;
+    while(!unpadded.empty() && (unpadded[unpadded.size() - 1] == '=')) unpadded.erase(unpadded.size() - 1);
+    my_bitset unpadded_decoded;
+    bitset_codec::decode_base64(unpadded.c_str(), (int)unpadded.size(), unpadded_decoded, n);
+    CHECK(unpadded_decoded == bits);
+
+    // the storage of a larger bitset is reused, its old bits do not leak
+    my_bitset reused(5000, true);
+    bitset_codec::decode_hex(hex.c_str(), (int)hex.size(), reused, n);
+    CHECK((reused.size() == n) && (reused == bits));
+
+    if(n > 0) {
+      std::string bad_binary = binary;
+      bad_binary[test_random() % bad_binary.size()] = '2';
+      CHECK(throws([&](){ bitset_codec::from_binary(bad_binary); }));
+      std::string bad_hex = hex;
+      bad_hex[test_random() % bad_hex.size()] = 'g';
+      CHECK(throws([&](){ bitset_codec::from_hex(bad_hex); }));
+      std::string bad_base64 = base64;
+      bad_base64[test_random() % unpadded.size()] = '*';
+      CHECK(throws([&](){ bitset_codec::from_base64(bad_base64); }));
+    }
+  }
+  CHECK(throws([](){ bitset_codec::from_hex("abc", 5); }));
+  CHECK(bitset_codec::from_base64("").size() == 0);
+
+  my_bitset large(5000003, false);
+  for(int i = 0; i < large.blocks_count(); ++i) large.set_block(i, test_random());
+  CHECK(bitset_codec::from_binary(bitset_codec::to_binary(large)) == large);
+  CHECK(bitset_codec::from_hex(bitset_codec::to_hex(large), (int)large.size()) == large);
+  CHECK(bitset_codec::from_base64(bitset_codec::to_base64(large), (int)large.size()) == large);
+
+  return test_result("bitset_codec_test");
+}
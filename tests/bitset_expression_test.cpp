@@ -0,0 +1,52 @@
+// bitset_expression test
+//
+// fused expressions against the eager my_bitset operators on operands of
+// random, unequal sizes: evaluate, count, and evaluate_into with the
+// result being one of the operands, across the sizes where the fast and
+// the checked block accessors meet. the expressions are the ones of the
+// header example, written as it writes them.
+
+#include <cstdio>
+
+#include "bitset_expression.h"
+#include "test_check.h"
+
+my_bitset random_bitset(const long long &size){
+  my_bitset result(size, false);
+  for(int i = 0; i < result.blocks_count(); ++i)
+    result.set_block(i, test_random());
+  return result;
+}
+
+int main(){
+  for(int round = 0; round < 3000; ++round){
+    long long sizes[4];
+    for(int i = 0; i < 4; ++i)
+      sizes[i] = ((round % 3 == 0) ? 640 : (long long)(test_random() % 700));
+    my_bitset a = random_bitset(sizes[0]), b = random_bitset(sizes[1]);
+    my_bitset c = random_bitset(sizes[2]), d = random_bitset(sizes[3]);
+
+    my_bitset expected = (a & b) | (c & ~d);
+    my_bitset r = bitset_eval::evaluate((bitset_eval::ref(a) & bitset_eval::ref(b)) |
+        (bitset_eval::ref(c) & ~bitset_eval::ref(d)));
+    CHECK((r.size() == expected.size()) && (r == expected));
+    long long n = bitset_eval::count(bitset_eval::ref(a) & ~bitset_eval::ref(b));
+    CHECK(n == (a & ~b).count());
+
+    expected = ~(a ^ b) & ~(~c | d);
+    CHECK(bitset_eval::evaluate(~(bitset_eval::ref(a) ^ bitset_eval::ref(b)) &
+        ~(~bitset_eval::ref(c) | bitset_eval::ref(d))) == expected);
+    CHECK(bitset_eval::count(~(bitset_eval::ref(a) ^ bitset_eval::ref(b)) &
+        ~(~bitset_eval::ref(c) | bitset_eval::ref(d))) == expected.count());
+
+    // the result is the left operand, then the right one of another size
+    my_bitset left(a);
+    bitset_eval::evaluate_into(bitset_eval::ref(left) & ~bitset_eval::ref(b), left);
+    CHECK(left == (a & ~b));
+    my_bitset right(b);
+    bitset_eval::evaluate_into(bitset_eval::ref(a) | bitset_eval::ref(right), right);
+    CHECK((right == (a | b)) && (right.size() == a.size()));
+  }
+
+  return test_result("bitset_expression_test");
+}
@@ -0,0 +1,119 @@
+// bitset_kernels test
+//
+// every kernel at every instruction set the cpu supports against a plain
+// loop, on arrays of 0 to 300 blocks that start off the vector alignment
+// and with dst the same array as a source, so the vector bodies, their
+// tails and the unaligned loads are all used. then the table is switched
+// by one thread while others run the kernels, for tsan.
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "bitset_kernels.h"
+#include "test_check.h"
+
+long long popcount_reference(const unsigned long long &block){
+  long long result = 0;
+  for(int i = 0; i < 64; ++i) result += (long long)((block >> i) & 1);
+  return result;
+}
+
+void test_kernels(){
+  for(int round = 0; round < 400; ++round){
+    int n = (int)(test_random() % 301);
+    int offset = 1 + (int)(test_random() % 7);
+    // sparse blocks now and then, so the counts are not all near 32 per block
+    bool sparse = (round % 3) == 0;
+    std::vector<unsigned long long> a(n + offset), b(n + offset), dst(n + offset);
+    for(int i = 0; i < n + offset; ++i){
+      a[i] = test_random();
+      b[i] = test_random();
+      if(sparse) a[i] &= test_random() & test_random(), b[i] &= test_random() & test_random();
+    }
+    const unsigned long long *pa = &a[0] + offset, *pb = &b[0] + offset;
+    unsigned long long *pd = &dst[0] + offset;
+
+    bitset_kernels::and_blocks(pd, pa, pb, n);
+    for(int i = 0; i < n; ++i) CHECK(pd[i] == (pa[i] & pb[i]));
+    bitset_kernels::or_blocks(pd, pa, pb, n);
+    for(int i = 0; i < n; ++i) CHECK(pd[i] == (pa[i] | pb[i]));
+    bitset_kernels::xor_blocks(pd, pa, pb, n);
+    for(int i = 0; i < n; ++i) CHECK(pd[i] == (pa[i] ^ pb[i]));
+    bitset_kernels::not_blocks(pd, pa, n);
+    for(int i = 0; i < n; ++i) CHECK(pd[i] == ~pa[i]);
+
+    long long count = 0, count_and = 0, count_xor = 0;
+    for(int i = 0; i < n; ++i){
+      count += popcount_reference(pa[i]);
+      count_and += popcount_reference(pa[i] & pb[i]);
+      count_xor += popcount_reference(pa[i] ^ pb[i]);
+    }
+    CHECK(bitset_kernels::count_blocks(pa, n) == count);
+    CHECK(bitset_kernels::count_and_blocks(pa, pb, n) == count_and);
+    CHECK(bitset_kernels::count_xor_blocks(pa, pb, n) == count_xor);
+
+    // dst is the first source
+    std::vector<unsigned long long> c(a);
+    bitset_kernels::xor_blocks(&c[0] + offset, &c[0] + offset, pb, n);
+    for(int i = 0; i < n; ++i) CHECK(c[offset + i] == (pa[i] ^ pb[i]));
+
+    CHECK(bitset_kernels::equal_blocks(pa, pa, n));
+    if(n > 0) {
+      std::vector<unsigned long long> d(a);
+      d[offset + test_random() % n] ^= 1ULL << (test_random() % 64);
+      CHECK(!bitset_kernels::equal_blocks(pa, &d[0] + offset, n));
+    }
+
+    // the rows of a, stride blocks each, against the first stride blocks of b
+    int stride = 1 + (int)(test_random() % 9);
+    int rows = n / stride;
+    if(rows > 0) {
+      std::vector<int> out(rows, -1);
+      bitset_kernels::count_xor_rows(&out[0], pa, stride, rows, pb);
+      for(int r = 0; r < rows; ++r){
+        long long expected = 0;
+        for(int i = 0; i < stride; ++i) expected += popcount_reference(pa[r * stride + i] ^ pb[i]);
+        CHECK(out[r] == expected);
+      }
+    }
+  }
+}
+
+void test_switching(){
+  std::vector<unsigned long long> blocks(1000, 0x5555555555555555ULL);
+  std::atomic<bool> stop(false);
+  std::thread switcher([&stop](){
+    int i = 0;
+    while(!stop.load())
+      bitset_kernels::set_isa((bitset_kernels::isa)(i++ % (bitset_kernels::best_isa() + 1)));
+  });
+  std::vector<std::thread> counters;
+  std::vector<int> wrong(2, 0);
+  for(int t = 0; t < 2; ++t)
+    counters.push_back(std::thread([&blocks, &wrong, t](){
+      for(int i = 0; i < 20000; ++i)
+        if(bitset_kernels::count_blocks(&blocks[0], 1000) != 32000) ++wrong[t];
+    }));
+  for(int t = 0; t < 2; ++t) counters[t].join();
+  stop.store(true);
+  switcher.join();
+  CHECK((wrong[0] == 0) && (wrong[1] == 0));
+}
+
+int main(){
+  for(int isa = bitset_kernels::SCALAR; isa <= bitset_kernels::AVX512; ++isa){
+    bool supported = (isa <= bitset_kernels::best_isa());
+    CHECK(bitset_kernels::set_isa((bitset_kernels::isa)isa) == supported);
+    if(!supported) continue;
+    CHECK(bitset_kernels::get_isa() == isa);
+    std::printf("bitset_kernels_test: %s\n", bitset_kernels::isa_name((bitset_kernels::isa)isa));
+    test_kernels();
+  }
+  bitset_kernels::set_isa(bitset_kernels::best_isa());
+  test_switching();
+  bitset_kernels::set_isa(bitset_kernels::best_isa());
+
+  return test_result("bitset_kernels_test");
+}
@@ -0,0 +1,168 @@
+// bitset_view test
+//
+// byte views over unaligned buffers and block views over blocks with
+// garbage past the size, compared with the my_bitset holding the same
+// bits: reads, counts, searches, and the combine functions writing into
+// byte buffers (guarded by sentinel bytes), into my_bitsets and in place.
+// every simd level of bitset_kernels the machine has is run in turn. the
+// sizes near the int limit are checked without touching memory.
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "bitset_view.h"
+#include "test_check.h"
+
+my_bitset random_bitset(const int &size){
+  my_bitset result(size, false);
+  for(int i = 0; i < size; ++i)
+    if(test_random() & 1) result.set(i, true);
+  return result;
+}
+
+// the first set bit of a at or after from, -1 if there is none
+int find_reference(const my_bitset &a, const int &from){
+  for(int i = from; i < a.size(); ++i)
+    if(a.get(i)) return i;
+  return -1;
+}
+
+void test_combine(const my_bitset &a, const my_bitset &b, const bitset_view &view_a, const bitset_view &view_b){
+  int bytes = (int)(a.size() / 8);
+  // the result bytes between two sentinels
+  std::vector<unsigned char> out(bytes + 2, 0xA5);
+  mutable_bitset_view view_out = mutable_bitset_view::from_bytes(&out[1], bytes);
+  bitset_view::and_into(view_a, view_b, view_out);
+  CHECK(view_out.to_my_bitset() == (a & b));
+  bitset_view::or_into(view_a, view_b, view_out);
+  CHECK(view_out.to_my_bitset() == (a | b));
+  bitset_view::xor_into(view_a, view_b, view_out);
+  CHECK(view_out.to_my_bitset() == (a ^ b));
+  bitset_view::not_into(view_a, view_out);
+  CHECK(view_out.to_my_bitset() == ~a);
+  CHECK((out[0] == 0xA5) && (out[bytes + 1] == 0xA5));
+
+  // into a my_bitset, all blocks views
+  my_bitset result(a.size(), false);
+  mutable_bitset_view view_result(result);
+  bitset_view::xor_into(bitset_view(a), bitset_view(b), view_result);
+  CHECK(result == (a ^ b));
+  bitset_view::and_into(bitset_view(a), view_b, view_result);
+  CHECK(result == (a & b));
+  bitset_view::not_into(bitset_view(a), view_result);
+  CHECK(result == ~a);
+
+  // the result is the left operand
+  my_bitset c = a;
+  mutable_bitset_view view_c(c);
+  bitset_view::or_into(view_c, bitset_view(b), view_c);
+  CHECK(c == (a | b));
+
+  // a block result keeps the bits past its size
+  int size = (int)a.size() - 1;
+  if(size > 0) {
+    std::vector<unsigned long long> blocks((size + 63) / 64, ~0ULL);
+    mutable_bitset_view view_blocks = mutable_bitset_view::from_blocks(&blocks[0], size);
+    my_bitset shorter(size, false);
+    for(int i = 0; i < size; ++i) shorter.set(i, a.get(i));
+    bitset_view::copy_into(bitset_view(shorter), view_blocks);
+    CHECK(view_blocks.to_my_bitset() == shorter);
+    if(size % 64) CHECK((blocks.back() & (~0ULL >> (size % 64))) == (~0ULL >> (size % 64)));
+    view_blocks.clear();
+    CHECK(view_blocks.none());
+    view_blocks.set(size - 1, true);
+    CHECK(view_blocks.get(size - 1) && (view_blocks.count() == 1));
+
+    // a result of another size than the left operand
+    bool thrown = false;
+    try {
+      bitset_view::and_into(view_a, view_b, view_blocks);
+    } catch(std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+}
+
+void test_sizes(){
+  // the bits of the largest buffers do not fit an int
+  const int sizes[] = {-1, 0x7FFFFFFF / 8 + 1, 300000000, (1 << 29) + 1};
+  for(int i = 0; i < 4; ++i){
+    bool thrown = false;
+    try {
+      bitset_view::from_bytes((const unsigned char*)NULL, sizes[i]);
+    } catch(std::length_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+      mutable_bitset_view::from_bytes((unsigned char*)NULL, sizes[i]);
+    } catch(std::length_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+  bitset_view largest = bitset_view::from_bytes((const unsigned char*)NULL, 0x7FFFFFFF / 8);
+  CHECK(largest.size() == (0x7FFFFFFF / 8) * 8);
+
+  // the block count of the sizes within 63 of the limit
+  bitset_view near_limit = bitset_view::from_blocks(NULL, 0x7FFFFFFF);
+  CHECK(near_limit.blocks_count() == (int)((0x7FFFFFFFLL + 63) / 64));
+  near_limit = bitset_view::from_blocks(NULL, 0x7FFFFFFF - 63);
+  CHECK(near_limit.blocks_count() == (int)((0x7FFFFFFFLL - 63 + 63) / 64));
+}
+
+int main(){
+  test_sizes();
+
+  for(int isa = 0; isa <= bitset_kernels::best_isa(); ++isa){
+    bitset_kernels::set_isa((bitset_kernels::isa)isa);
+    for(int round = 0; round < 300; ++round){
+      int bytes = (int)(test_random() % 100);
+      int size_a = bytes * 8;
+      int size_b = ((round % 3 == 0) ? size_a : (int)(test_random() % (size_a + 1)));
+      my_bitset a = random_bitset(size_a), b = random_bitset(size_b);
+
+      // a's bits in an unaligned byte buffer
+      std::vector<unsigned char> buffer(bytes + 1);
+      for(int i = 0; i < bytes; ++i){
+        unsigned int byte = 0;
+        for(int j = 0; j < 8; ++j) byte = (byte << 1) | (a.get(i * 8 + j) ? 1 : 0);
+        buffer[i + 1] = (unsigned char)byte;
+      }
+      bitset_view view_a = bitset_view::from_bytes(&buffer[1], bytes);
+
+      // b's blocks, set past the size
+      std::vector<unsigned long long> blocks(b.blocks_count() + 1, 0);
+      for(int i = 0; i < b.blocks_count(); ++i) blocks[i] = b.get_block(i);
+      if(size_b % 64) blocks[b.blocks_count() - 1] |= ~0ULL >> (size_b % 64);
+      bitset_view view_b = bitset_view::from_blocks(&blocks[0], size_b);
+
+      CHECK((view_a.size() == size_a) && (view_b.size() == size_b));
+      CHECK((view_a.count() == a.count()) && (view_b.count() == b.count()));
+      CHECK((view_a.to_my_bitset() == a) && (view_b.to_my_bitset() == b));
+      CHECK((view_a == bitset_view(a)) && (view_b == bitset_view(b)));
+      CHECK(view_a.count_and(view_b) == (a & b).count());
+      for(int i = 0; i < 5 && size_a > 0; ++i){
+        int index = (int)(test_random() % size_a);
+        CHECK(view_a.get(index) == a.get(index));
+      }
+      CHECK(view_a.find_first() == find_reference(a, 0));
+      if(size_a > 0) {
+        int from = (int)(test_random() % size_a);
+        CHECK(view_a.find_next_set(from) == find_reference(a, from));
+      }
+      int seen = 0;
+      bool all_set = true;
+      view_b.for_each_set_bit([&](const int &index){ all_set = all_set && b.get(index); ++seen; });
+      CHECK(all_set && (seen == b.count()));
+
+      test_combine(a, b, view_a, view_b);
+    }
+  }
+  bitset_kernels::set_isa(bitset_kernels::best_isa());
+
+  return test_result("bitset_view_test");
+}
@@ -0,0 +1,87 @@
+// bloom_filter test
+//
+// no false negatives, for single keys, batches and byte keys, a measured
+// false positive rate within 30% of the target for several targets, the
+// batches giving the same filter and answers as the single key calls for
+// every batch size around the group size, and the copy, union and clear
+// functions.
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+#include "bloom_filter.h"
+#include "test_check.h"
+
+void test_rates(){
+  const double rates[] = {0.1, 0.01, 0.001};
+  for(int r = 0; r < 3; ++r){
+    const int items = 100000;
+    bloom_filter filter(items, rates[r]);
+    std::vector<unsigned long long> keys(items);
+    for(int i = 0; i < items; ++i) keys[i] = 3ULL * i;
+    filter.insert_batch(&keys[0], items);
+
+    bool *found = new bool[items];
+    filter.contains_batch(&keys[0], items, found);
+    int missed = 0;
+    for(int i = 0; i < items; ++i) missed += (found[i] ? 0 : 1);
+    CHECK(missed == 0);
+    delete[] found;
+
+    // keys never inserted
+    const int queries = 500000;
+    int positives = 0;
+    for(int i = 0; i < queries; ++i)
+      positives += (filter.contains(3ULL * items + 1 + 3ULL * i) ? 1 : 0);
+    CHECK((double)positives / queries < rates[r] * 1.3);
+    CHECK(filter.estimated_false_positive_rate() < rates[r] * 1.3);
+
+    bloom_filter copy(filter);
+    for(int i = 0; i < items; i += 7) CHECK(copy.contains(keys[i]));
+    bloom_filter other(items, rates[r]);
+    other.insert("hello", 5);
+    CHECK(other.contains("hello", 5));
+    other |= filter;
+    CHECK(other.contains(keys[7]) && other.contains("hello", 5));
+    other = copy;
+    CHECK(other.contains(keys[9]));
+    other.clear();
+    CHECK(other.estimated_false_positive_rate() == 0);
+  }
+}
+
+void test_batches(){
+  const int sizes[] = {0, 1, 7, 8, 9, 15, 16, 17, 100, 1001};
+  for(int s = 0; s < 10; ++s){
+    int n = sizes[s];
+    bloom_filter batched = bloom_filter::with_shape(50, 5), single = bloom_filter::with_shape(50, 5);
+    std::vector<unsigned long long> keys(n + 1), queries(2 * n + 1);
+    for(int i = 0; i < n; ++i) keys[i] = test_random();
+    for(int i = 0; i < 2 * n; ++i) queries[i] = ((i % 2) ? keys[i / 2] : test_random());
+    batched.insert_batch(&keys[0], n);
+    for(int i = 0; i < n; ++i) single.insert(keys[i]);
+
+    bool *results = new bool[2 * n + 1];
+    batched.contains_batch(&queries[0], 2 * n, results);
+    for(int i = 0; i < 2 * n; ++i) CHECK(results[i] == single.contains(queries[i]));
+    for(int i = 0; i < 2 * n; ++i) CHECK(batched.contains(queries[i]) == single.contains(queries[i]));
+    delete[] results;
+  }
+}
+
+int main(){
+  test_rates();
+  test_batches();
+
+  bloom_filter a = bloom_filter::with_shape(10, 3), b = bloom_filter::with_shape(11, 3);
+  bool thrown = false;
+  try {
+    a |= b;
+  } catch(std::runtime_error &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+
+  return test_result("bloom_filter_test");
+}
@@ -0,0 +1,114 @@
+// fingerprint_store test
+//
+// random stores, half of the fingerprints close to a few centers so the
+// index has near neighbours to find: search, search_batch and
+// search_radius against a brute force sort of every distance, at each
+// instruction set the kernels support, without an index, with one, and
+// with fingerprints added after it was built.
+
+#include <algorithm>
+#include <vector>
+
+#include "fingerprint_store.h"
+#include "test_check.h"
+
+typedef fingerprint_store::match match;
+
+my_bitset random_fingerprint(const int &bits){
+  my_bitset result(bits, 0);
+  for(int i = 0; i < bits; ++i)
+    if(test_random() & 1) result.set(i, true);
+  return result;
+}
+
+my_bitset near_fingerprint(const my_bitset &center, const int &flips){
+  my_bitset result = center;
+  for(int i = 0; i < flips; ++i){
+    long long j = (long long)(test_random() % center.size());
+    result.set(j, !result.get(j));
+  }
+  return result;
+}
+
+std::vector<match> brute_force(const std::vector<my_bitset> &stored, const my_bitset &query, const int &k){
+  std::vector<match> result;
+  for(int i = 0; i < (int)stored.size(); ++i){
+    match candidate = {i, (int)(stored[i] ^ query).count()};
+    result.push_back(candidate);
+  }
+  std::sort(result.begin(), result.end());
+  if((int)result.size() > k) result.resize(k);
+  return result;
+}
+
+bool same_matches(const std::vector<match> &a, const std::vector<match> &b){
+  if(a.size() != b.size()) return false;
+  for(size_t i = 0; i < a.size(); ++i)
+    if((a[i].id != b[i].id) || (a[i].distance != b[i].distance)) return false;
+  return true;
+}
+
+void compare_searches(const fingerprint_store &store, const std::vector<my_bitset> &stored,
+    const std::vector<my_bitset> &queries, const int &k){
+  std::vector<std::vector<match> > batch = store.search_batch(queries, k, 3);
+  for(size_t i = 0; i < queries.size(); ++i){
+    std::vector<match> expected = brute_force(stored, queries[i], k);
+    CHECK(same_matches(store.search(queries[i], k), expected));
+    CHECK(same_matches(batch[i], expected));
+  }
+}
+
+int main(){
+  for(int isa = bitset_kernels::SCALAR; isa <= bitset_kernels::best_isa(); ++isa){
+    bitset_kernels::set_isa((bitset_kernels::isa)isa);
+    for(int round = 0; round < 30; ++round){
+      int bits = 1 + (int)(test_random() % 600);
+      int n = (int)(test_random() % 400);
+      fingerprint_store store(bits);
+      std::vector<my_bitset> stored;
+      std::vector<my_bitset> centers;
+      for(int c = 0; c < 5; ++c) centers.push_back(random_fingerprint(bits));
+      for(int i = 0; i < n; ++i){
+        my_bitset fingerprint = ((i % 2) ? random_fingerprint(bits) :
+            near_fingerprint(centers[test_random() % 5], (int)(test_random() % 8)));
+        stored.push_back(fingerprint);
+        CHECK(store.add(fingerprint) == i);
+      }
+
+      std::vector<my_bitset> queries;
+      for(int i = 0; i < 40; ++i)
+        queries.push_back((i % 2) ? random_fingerprint(bits) :
+            near_fingerprint(centers[test_random() % 5], (int)(test_random() % 5)));
+      int k = (int)(test_random() % 12);
+      compare_searches(store, stored, queries, k);
+
+      // substrings of at most 64 bits
+      int substrings = std::max((bits + 63) / 64, std::min(bits, 1 + (int)(test_random() % 8)));
+      if((bits + substrings - 1) / substrings <= 64) {
+        store.build_index(substrings);
+        CHECK(store.is_indexed());
+        compare_searches(store, stored, queries, k);
+        for(int i = 0; i < 10; ++i){
+          my_bitset fingerprint = near_fingerprint(centers[0], 2);
+          stored.push_back(fingerprint);
+          store.add(fingerprint);
+        }
+        compare_searches(store, stored, queries, k);
+      }
+
+      if(n != 0) {
+        my_bitset query = random_fingerprint(bits);
+        int radius = bits / 2;
+        std::vector<match> all = brute_force(stored, query, (int)stored.size());
+        std::vector<match> expected;
+        for(size_t i = 0; i < all.size(); ++i)
+          if(all[i].distance <= radius) expected.push_back(all[i]);
+        CHECK(same_matches(store.search_radius(query, radius), expected));
+        CHECK(store.get(0) == stored[0]);
+      }
+    }
+  }
+  bitset_kernels::set_isa(bitset_kernels::best_isa());
+
+  return test_result("fingerprint_store_test");
+}
@@ -0,0 +1,94 @@
+// my_bitset growth test
+//
+// random push_back, append_bits, resize, pop_back, reserve and
+// shrink_to_fit against a std::vector<bool>, the bits past the size kept
+// clear after every step, appends one bit at a time reallocating a
+// logarithmic number of times, and a mapped bitset growing in its file
+// while it fits and moving to the heap once it does not.
+
+#include <cstdio>
+#include <vector>
+
+#include "my_bitset.h"
+#include "test_check.h"
+
+bool same(const my_bitset &bits, const std::vector<bool> &reference){
+  if(bits.size() != (long long)reference.size()) return false;
+  for(size_t i = 0; i < reference.size(); ++i)
+    if(bits.get((long long)i) != reference[i]) return false;
+  int used = (int)(bits.size() % 64);
+  return (used == 0) || ((bits.get_block(bits.blocks_count() - 1) & (~0ULL >> used)) == 0);
+}
+
+int main(){
+  for(int round = 0; round < 200; ++round){
+    my_bitset bits;
+    std::vector<bool> reference;
+    if(round % 2) {
+      int size = (int)(test_random() % 200);
+      bits = my_bitset(size, round % 4 == 1);
+      reference.assign(size, round % 4 == 1);
+    }
+    for(int step = 0; step < 300; ++step){
+      int op = (int)(test_random() % 7);
+      if(op <= 2) {
+        bool value = (test_random() & 1) != 0;
+        bits.push_back(value);
+        reference.push_back(value);
+      } else if(op == 3) {
+        int length = (int)(test_random() % 65);
+        unsigned long long value = test_random();
+        bits.append_bits(value, length);
+        for(int j = length - 1; j >= 0; --j) reference.push_back(((value >> j) & 1) != 0);
+      } else if(op == 4) {
+        int size = (int)(test_random() % 300);
+        bool value = (test_random() & 1) != 0;
+        bits.resize(size, value);
+        reference.resize(size, value);
+      } else if((op == 5) && !reference.empty()) {
+        bits.pop_back();
+        reference.pop_back();
+      } else if(op == 6) {
+        long long capacity = (long long)(test_random() % 400);
+        bits.reserve(capacity);
+        CHECK(bits.capacity_bits() >= capacity);
+        if(test_random() % 4 == 0) bits.shrink_to_fit();
+      }
+      CHECK(same(bits, reference));
+    }
+    my_bitset copy = bits;
+    CHECK((copy == bits) && (copy.count() == bits.count()));
+  }
+
+  // amortized constant appends
+  my_bitset appended;
+  int reallocations = 0;
+  long long capacity = appended.capacity_bits();
+  for(int i = 0; i < 1000000; ++i){
+    appended.push_back(i % 3 == 0);
+    if(appended.capacity_bits() != capacity) {
+      ++reallocations;
+      capacity = appended.capacity_bits();
+    }
+  }
+  CHECK(reallocations < 30);
+  CHECK(appended.count() == 333334);
+
+#ifdef MY_BITSET_MMAP
+  // the file holds one block, 64 bits
+  const char *path = "my_bitset_growth_test.bits";
+  {
+    my_bitset mapped = my_bitset::create_file(path, 10);
+    for(int i = 0; i < 54; ++i) mapped.push_back(true);
+    CHECK(mapped.is_mapped() && (mapped.size() == 64));
+    mapped.sync();
+    my_bitset reopened = my_bitset::map_file(path, my_bitset::READ_ONLY);
+    CHECK((reopened.size() == 64) && (reopened.count() == 54));
+    mapped.push_back(true);
+    CHECK(!mapped.is_mapped() && (mapped.size() == 65) && (mapped.count() == 55));
+  }
+  std::remove(path);
+#endif
+
+  return test_result("my_bitset_growth_test");
+}
@@ -0,0 +1,151 @@
+// my_bitset file storage test
+//
+// saves and maps back random bitsets: READ_ONLY mappings are copy on
+// write and leave the file alone, READ_WRITE ones write through, copies
+// and moves keep or carry the mapping, an assignment that does not fit
+// the file moves the bitset to the heap, a bitset is saved over the file
+// it is mapped from, and files that are not bitsets are refused. a sparse
+// file of 5 billion bits checks the indices past 2^31 and 2^32 without
+// writing more than a few pages. the files are made in the working
+// directory (the build directory under ctest) and removed at the end.
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "my_bitset.h"
+#include "test_check.h"
+
+#ifdef MY_BITSET_MMAP
+
+const char *path = "my_bitset_mmap_test.bits";
+
+void test_round_trips(){
+  for(int round = 0; round < 50; ++round){
+    long long size = (long long)(test_random() % 100000);
+    my_bitset bits(size, false);
+    for(long long i = 0; i < size / 10; ++i) bits.set((long long)(test_random() % size), true);
+    bits.save(path);
+
+    {
+      my_bitset mapped = my_bitset::map_file(path, my_bitset::READ_ONLY);
+      CHECK(mapped.is_mapped());
+      CHECK((mapped.size() == size) && (mapped == bits) && (mapped.count() == bits.count()));
+      // copy on write
+      if(size > 0) {
+        mapped.set(0, !mapped.get(0));
+        CHECK(mapped != bits);
+      }
+    }
+    CHECK(my_bitset::map_file(path, my_bitset::READ_ONLY) == bits);
+
+    {
+      my_bitset written = my_bitset::map_file(path, my_bitset::READ_WRITE);
+      if(size > 0) {
+        written.set(size - 1, true);
+        written.sync();
+      }
+      my_bitset copy(written);
+      CHECK(!copy.is_mapped() && (copy == written));
+      my_bitset moved(std::move(written));
+      CHECK(moved.is_mapped() && !written.is_mapped());
+    }
+    {
+      my_bitset mapped = my_bitset::map_file(path, my_bitset::READ_ONLY);
+      if(size > 0) CHECK(mapped.get(size - 1));
+      // a smaller value is copied into the file
+      my_bitset smaller(size / 2, true);
+      my_bitset written = my_bitset::map_file(path, my_bitset::READ_WRITE);
+      written = smaller;
+      CHECK(written.is_mapped());
+    }
+    {
+      my_bitset mapped = my_bitset::map_file(path, my_bitset::READ_ONLY);
+      CHECK((mapped.size() == size / 2) && (mapped.count() == size / 2));
+      my_bitset larger(size + 100, true);
+      mapped = larger;
+      CHECK(!mapped.is_mapped() && (mapped == larger));
+    }
+  }
+
+  // saved over its own mapping, read only and read write
+  my_bitset bits(1000, false);
+  for(int i = 0; i < 1000; i += 3) bits.set(i, true);
+  bits.save(path);
+  {
+    my_bitset mapped = my_bitset::map_file(path, my_bitset::READ_WRITE);
+    mapped.set(1, true);
+    mapped.save(path);
+    CHECK(mapped.count() == 335);
+  }
+  CHECK(my_bitset::map_file(path, my_bitset::READ_ONLY).count() == 335);
+  {
+    my_bitset mapped = my_bitset::map_file(path, my_bitset::READ_ONLY);
+    mapped.set(2, true);
+    mapped.save(path);
+  }
+  CHECK(my_bitset::map_file(path, my_bitset::READ_ONLY).count() == 336);
+
+  {
+    my_bitset created = my_bitset::create_file(path, 1000);
+    CHECK((created.size() == 1000) && created.none());
+    created.set(5, true);
+  }
+  my_bitset reopened = my_bitset::map_file(path, my_bitset::READ_ONLY);
+  CHECK((reopened.count() == 1) && reopened.get(5));
+}
+
+void test_refused(){
+  // a file that is not a bitset, then no file at all
+  FILE *text = std::fopen(path, "w");
+  std::fputs("not a bitset file, only text that is long enough to hold a header of 64 bytes\n", text);
+  std::fclose(text);
+  const char *paths[] = {path, "my_bitset_mmap_test.missing"};
+  for(int i = 0; i < 2; ++i){
+    bool thrown = false;
+    try {
+      my_bitset::map_file(paths[i], my_bitset::READ_ONLY);
+    } catch(std::runtime_error &) {
+      thrown = true;
+    }
+    CHECK(thrown);
+  }
+}
+
+void test_past_int_range(){
+  long long size = 5000000000LL;
+  const long long positions[] = {0, 2147483647LL, 2147483648LL, 4294967296LL, 4999999999LL};
+  {
+    my_bitset created = my_bitset::create_file(path, size);
+    CHECK(created.size() == size);
+    for(int i = 0; i < 5; ++i) created.set(positions[i], true);
+    created.sync();
+  }
+  my_bitset mapped = my_bitset::map_file(path, my_bitset::READ_ONLY);
+  CHECK(mapped.size() == size);
+  long long index = mapped.find_first();
+  for(int i = 0; i < 5; ++i){
+    CHECK(index == positions[i]);
+    index = mapped.find_next(index);
+  }
+  CHECK(index == -1);
+  CHECK(mapped.find_prev_set(size) == positions[4]);
+  CHECK(!mapped.get(positions[3] + 1) && mapped.get(positions[3]));
+}
+
+int main(){
+  test_round_trips();
+  test_refused();
+  test_past_int_range();
+  std::remove(path);
+  return test_result("my_bitset_mmap_test");
+}
+
+#else
+
+int main(){
+  std::printf("my_bitset_mmap_test: no file storage on this platform, skipped\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,104 @@
+// parallel_bitset test
+//
+// every parallel bulk operation against its my_bitset counterpart, on
+// random bitsets of up to 8M bits (so up to 8 threads get a range of
+// their own) with 1 to 7 threads or the default, dense and sparse bits,
+// sizes that are not a multiple of 64 and results that are one of the
+// operands. the thread pool is checked on its own first: each part of a
+// job runs exactly once. built with -DMY_CPP_LIB_SANITIZE=thread this is
+// the test that runs the pool and the kernels under tsan.
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#include "parallel_bitset.h"
+#include "test_check.h"
+
+my_bitset random_bitset(const long long &size, const bool &sparse){
+  my_bitset result(size, false);
+  for(int i = 0; i < result.blocks_count(); ++i){
+    unsigned long long block = test_random();
+    if(sparse) block &= test_random() & test_random() & test_random();
+    result.set_block(i, block);
+  }
+  // the unused bits of the last block stay clear
+  if(size % 64) {
+    int last = result.blocks_count() - 1;
+    result.set_block(last, result.get_block(last) & ~(~0ULL >> (size % 64)));
+  }
+  return result;
+}
+
+void test_pool(){
+  bitset_thread_pool pool(4);
+  CHECK(pool.size() == 4);
+  std::vector<std::atomic<int> > runs(37);
+  for(int round = 0; round < 200; ++round){
+    int parts = 1 + (int)(test_random() % 37);
+    for(size_t i = 0; i < runs.size(); ++i) runs[i].store(0);
+    pool.run(parts, [&runs](int part) { runs[part].fetch_add(1); });
+    for(int i = 0; i < (int)runs.size(); ++i)
+      CHECK(runs[i].load() == ((i < parts) ? 1 : 0));
+  }
+}
+
+int main(){
+  test_pool();
+
+  for(int round = 0; round < 40; ++round){
+    int threads = round % 8;
+    long long size1 = 1 + (long long)(test_random() % (8LL << 20));
+    long long size2 = ((round % 3 == 0) ? size1 : 1 + (long long)(test_random() % (8LL << 20)));
+    my_bitset a = random_bitset(size1, (round % 4) == 1);
+    my_bitset b = random_bitset(size2, (round % 4) == 2);
+
+    my_bitset result;
+    parallel_bitset::and_into(a, b, result, threads);
+    CHECK(result == (a & b));
+    parallel_bitset::or_into(a, b, result, threads);
+    CHECK(result == (a | b));
+    my_bitset smaller(100, true);
+    parallel_bitset::xor_into(a, b, smaller, threads);
+    CHECK((smaller == (a ^ b)) && (smaller.size() == size1));
+    parallel_bitset::not_into(a, result, threads);
+    CHECK(result == ~a);
+
+    // the result is one of the operands
+    my_bitset left = a;
+    parallel_bitset::and_into(left, b, left, threads);
+    CHECK(left == (a & b));
+    my_bitset right = b;
+    parallel_bitset::xor_into(a, right, right, threads);
+    CHECK((right == (a ^ b)) && (right.size() == size1));
+
+    CHECK(parallel_bitset::count(a, threads) == a.count());
+    CHECK(parallel_bitset::count_and(a, b, threads) == a.count_and(b));
+
+    my_bitset single(size1, false);
+    if(round % 3) single.set((long long)(test_random() % size1), true);
+    if(round % 7 == 0) single.set(size1 - 1, true);
+    CHECK(parallel_bitset::find_first(single, threads) == single.find_first());
+
+    my_bitset copy = a;
+    CHECK(parallel_bitset::equal(a, copy, threads));
+    long long flipped = (long long)(test_random() % size1);
+    copy.set(flipped, !copy.get(flipped));
+    CHECK(!parallel_bitset::equal(a, copy, threads));
+    CHECK(parallel_bitset::compare(a, copy, threads) == my_bitset::compare(a, copy));
+    CHECK(parallel_bitset::compare(a, b, threads) == my_bitset::compare(a, b));
+    // the same value with leading zeros
+    my_bitset padded = a.pad_left(37, false);
+    CHECK((parallel_bitset::compare(a, padded, threads) == 0) && parallel_bitset::equal(padded, a, threads));
+
+    my_bitset assigned;
+    parallel_bitset::assign(assigned, size1, (round % 2) == 1, threads);
+    CHECK(assigned == my_bitset(size1, (round % 2) == 1));
+  }
+
+  my_bitset empty, result;
+  parallel_bitset::and_into(empty, empty, result);
+  CHECK((result.size() == 0) && (parallel_bitset::count(empty) == 0) && (parallel_bitset::find_first(empty) == -1));
+
+  return test_result("parallel_bitset_test");
+}
@@ -0,0 +1,67 @@
+// prime_sieve test
+//
+// random ranges, from a few numbers to several segments and starting
+// below the wheel primes as well as inside the wheel period, against a
+// plain sieve of eratosthenes, ranges near 2^40 against a sieve of their own,
+// with one to three worker threads, and the prime counting function at
+// 10^7 and 10^8.
+//
+// the reference for the ranges near 2^40 crosses off the multiples of the
+// primes of the plain sieve, which goes past their square root.
+
+#include <vector>
+
+#include "prime_sieve.h"
+#include "test_check.h"
+
+int main(){
+  const unsigned long long limit = 4000000;
+  std::vector<bool> composite(limit, false);
+  composite[0] = composite[1] = true;
+  for(unsigned long long i = 2; i * i < limit; ++i)
+    if(!composite[i])
+      for(unsigned long long j = i * i; j < limit; j += i) composite[j] = true;
+
+  for(int round = 0; round < 300; ++round){
+    unsigned long long lo = ((round % 5 == 0) ? (test_random() % 40) : (test_random() % 3000000));
+    unsigned long long length = test_random() % ((round % 3 == 0) ? 1000000 : 300);
+    int threads = round % 4;
+    std::vector<unsigned long long> expected;
+    for(unsigned long long n = lo; n < lo + length; ++n)
+      if(!composite[n]) expected.push_back(n);
+    CHECK(prime_sieve::primes(lo, lo + length, threads) == expected);
+    CHECK(prime_sieve::count_primes(lo, lo + length, round % 3) == expected.size());
+  }
+
+  for(int round = 0; round < 20; ++round){
+    unsigned long long lo = test_random() % (1ULL << 40);
+    unsigned long long length = test_random() % 20000;
+    std::vector<bool> crossed(length, false);
+    for(unsigned long long p = 2; p * p < lo + length; ++p)
+      if(!composite[p])
+        for(unsigned long long j = ((lo + p - 1) / p) * p; j < lo + length; j += p) crossed[j - lo] = true;
+    std::vector<unsigned long long> expected;
+    for(unsigned long long n = lo; n < lo + length; ++n)
+      if(!crossed[n - lo]) expected.push_back(n);
+    CHECK(prime_sieve::primes(lo, lo + length, 2) == expected);
+  }
+
+  CHECK(prime_sieve::count_primes(0, 10000000) == 664579);
+  CHECK(prime_sieve::count_primes(10, 5) == 0);
+  std::vector<unsigned int> small = prime_sieve::small_primes(100);
+  CHECK((small.size() == 25) && (small.back() == 97));
+
+  unsigned long long streamed = 0;
+  unsigned long long previous = 0;
+  bool increasing = true;
+  prime_sieve::for_each_prime(0, 100000000ULL, [&](unsigned long long p){
+    if(p <= previous) increasing = false;
+    previous = p;
+    ++streamed;
+  }, 2);
+  CHECK(increasing);
+  CHECK(streamed == 5761455);
+  CHECK(prime_sieve::count_primes(0, 100000000ULL, 0) == 5761455);
+
+  return test_result("prime_sieve_test");
+}
@@ -0,0 +1,77 @@
+// rank_select test
+//
+// rank at every position and select of every set bit against a running
+// count, on bitsets around the block and superblock sizes and on larger
+// ones from very sparse to full, so that the select samples land in all
+// the places of a superblock. one bitset of 2^31 + 1000 bits (256 MB)
+// checks the positions past the int range, it is skipped when the memory
+// cannot be had.
+
+#include <cstdio>
+#include <new>
+
+#include "rank_select.h"
+#include "test_check.h"
+
+// one bit in every density on average, 0 for none and 1 for all
+my_bitset random_bitset(const long long &size, const int &density){
+  my_bitset result(size, false);
+  for(long long i = 0; i < size; ++i)
+    if((density != 0) && (test_random() % density == 0)) result.set(i, true);
+  return result;
+}
+
+void compare_with(const my_bitset &bits){
+  rank_select index(bits);
+  CHECK(index.size() == bits.size());
+  long long ones = 0;
+  for(long long i = 0; i <= bits.size(); ++i){
+    CHECK(index.rank(i) == ones);
+    CHECK(index.rank0(i) == i - ones);
+    if((i < bits.size()) && bits.get(i)) {
+      CHECK(index.get(i));
+      CHECK(index.select(ones) == i);
+      ++ones;
+    }
+  }
+  CHECK(index.count() == ones);
+  CHECK((index.select(ones) == -1) && (index.select(-1) == -1));
+}
+
+void test_past_int_range(){
+  long long size = (1LL << 31) + 1000;
+  my_bitset bits;
+  try {
+    bits = my_bitset(size, false);
+  } catch(std::bad_alloc &) {
+    std::printf("rank_select_test: no memory for %lld bits, skipped\n", size);
+    return;
+  }
+  const long long positions[] = {5, (1LL << 31) - 1, 1LL << 31, (1LL << 31) + 999};
+  for(int i = 0; i < 4; ++i) bits.set(positions[i], true);
+  rank_select index(bits);
+  CHECK(index.size() == size);
+  CHECK(index.count() == 4);
+  for(int i = 0; i < 4; ++i){
+    CHECK(index.select(i) == positions[i]);
+    CHECK(index.rank(positions[i]) == i);
+    CHECK(index.rank(positions[i] + 1) == i + 1);
+  }
+  CHECK(index.rank(size) == 4);
+  CHECK(index.rank0(size) == size - 4);
+}
+
+int main(){
+  const long long sizes[] = {0, 1, 63, 64, 65, 511, 512, 513, 4095, 4097};
+  for(int i = 0; i < 10; ++i)
+    for(int density = 0; density <= 3; ++density)
+      compare_with(random_bitset(sizes[i], density));
+
+  const int densities[] = {0, 1, 2, 3, 10, 100, 5000};
+  for(int i = 0; i < 7; ++i)
+    compare_with(random_bitset(200000 + (long long)(test_random() % 1000), densities[i]));
+
+  test_past_int_range();
+
+  return test_result("rank_select_test");
+}
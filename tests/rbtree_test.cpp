@@ -0,0 +1,106 @@
+// rbtree test
+//
+// 200000 random inserts and erases on an rbtree<int, int> and a std::set
+// of the same keys, a small key range so the erases hit and the subtree
+// sizes go up and down through every rotation. every 101 operations the
+// tree is compared with the set: size, in order walk both ways, and
+// select, rank and count_range at random points. select(rank(k)) is
+// checked for every key once at the end, which walks every subtree size.
+
+#include <cstdio>
+#include <iterator>
+#include <set>
+#include <string>
+
+#include "rbtree.h"
+#include "test_check.h"
+
+typedef rbtree<int, int> tree;
+
+// a comparator that takes a const char * for a std::string key, as
+// std::less<> does in c++14
+struct string_less {
+  typedef void is_transparent;
+  bool operator () (const std::string &a, const std::string &b) const { return a < b; }
+  bool operator () (const std::string &a, const char *b) const { return a.compare(b) < 0; }
+  bool operator () (const char *a, const std::string &b) const { return b.compare(a) > 0; }
+};
+
+void compare_with(const tree &t, const std::set<int> &reference){
+  CHECK(t.size() == reference.size());
+  CHECK(std::distance(t.begin(), t.end()) == std::distance(reference.begin(), reference.end()));
+
+  std::set<int>::const_iterator r = reference.begin();
+  for(tree::const_iterator it = t.begin(); (it != t.end()) && (r != reference.end()); ++it, ++r)
+    CHECK(it->first == *r);
+  std::set<int>::const_reverse_iterator rr = reference.rbegin();
+  tree::const_iterator it = t.end();
+  for(; (it != t.begin()) && (rr != reference.rend()); ++rr)
+    CHECK((--it)->first == *rr);
+
+  size_t k = test_random() % (reference.size() + 2);
+  tree::const_iterator selected = t.select(k);
+  if(k < reference.size()) CHECK((selected != t.end()) && (selected->first == *std::next(reference.begin(), k)));
+  else CHECK(selected == t.end());
+
+  int key = (int)(test_random() % 3100) - 50;
+  CHECK(t.rank(key) == (size_t)std::distance(reference.begin(), reference.lower_bound(key)));
+
+  int lo = (int)(test_random() % 3000), hi = (int)(test_random() % 3000);
+  size_t in_range = ((lo < hi) ? (size_t)std::distance(reference.lower_bound(lo), reference.lower_bound(hi)) : 0);
+  CHECK(t.count_range(lo, hi) == in_range);
+
+  tree::const_iterator lower = t.lower_bound(key), upper = t.upper_bound(key);
+  std::set<int>::const_iterator reference_lower = reference.lower_bound(key), reference_upper = reference.upper_bound(key);
+  CHECK((lower == t.end()) == (reference_lower == reference.end()));
+  if(lower != t.end()) CHECK(lower->first == *reference_lower);
+  CHECK((upper == t.end()) == (reference_upper == reference.end()));
+  if(upper != t.end()) CHECK(upper->first == *reference_upper);
+}
+
+int main(){
+  tree t;
+  std::set<int> reference;
+
+  for(int i = 0; i < 200000; ++i){
+    int key = (int)(test_random() % 3000);
+    int op = (int)(test_random() % 5);
+    if(op < 2) {
+      bool inserted = t.insert(key).second;
+      CHECK(inserted == reference.insert(key).second);
+    } else if(op < 4) {
+      CHECK(t.erase(key) == reference.erase(key));
+    } else {
+      // erase through an iterator
+      tree::iterator it = t.find(key);
+      CHECK((it != t.end()) == (reference.count(key) != 0));
+      if(it != t.end()) {
+        tree::iterator next = t.erase(it);
+        std::set<int>::iterator reference_next = reference.upper_bound(key);
+        reference.erase(key);
+        CHECK((next == t.end()) == (reference_next == reference.end()));
+        if(next != t.end()) CHECK(next->first == *reference_next);
+      }
+    }
+    if(i % 101 == 0) compare_with(t, reference);
+  }
+  compare_with(t, reference);
+  for(tree::const_iterator it = t.begin(); it != t.end(); ++it)
+    CHECK(it == t.select(t.rank(it->first)));
+
+  // the transparent lookups, on a const tree as well
+  rbtree<std::string, int, string_less> names;
+  names.insert(std::string("b"));
+  names.insert(std::string("d"));
+  names.insert(std::string("f"));
+  const rbtree<std::string, int, string_less> &constant = names;
+  CHECK(constant.contains("d") && !constant.contains("c"));
+  CHECK(constant.rank("c") == 1);
+  CHECK(constant.count_range(std::string("a"), std::string("e")) == 2);
+  CHECK(constant.lower_bound("c")->first == "d");
+  CHECK(constant.upper_bound("d")->first == "f");
+  CHECK(constant.upper_bound("f") == constant.end());
+  CHECK(names.select(2)->first == "f");
+
+  return test_result("rbtree_test");
+}
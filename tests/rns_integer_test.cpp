@@ -0,0 +1,76 @@
+// rns_integer test
+//
+// random signed values of up to 186 bits taken to a basis large enough
+// for their products, the ring operations done on the residues and
+// brought back with garner's algorithm against the same operations on
+// big_integer, the residues of non negative values against big_integer
+// remainders, and the operations between two bases rejected.
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "rns_integer.h"
+#include "test_check.h"
+
+// a value of words random 62 bits words, its sign random too. the
+// long long constructor is used throughout, it is the one that gives
+// zero a sign of 0
+big_integer random_value(const int &words){
+  big_integer base(1LL << 62);
+  big_integer result(0LL);
+  for(int i = 0; i < words; ++i)
+    result = result * base + big_integer((long long)(test_random() >> (2 + test_random() % 62)));
+  if(test_random() % 2) result = big_integer(0LL) - result;
+  return result;
+}
+
+int main(){
+  rns_basis basis(rns_basis::primes_for_bits(400));
+  CHECK(basis.modulus_bits() >= 401);
+  for(int i = 0; i + 1 < basis.size(); ++i)
+    CHECK(basis.get_prime(i) < (1U << 31));
+
+  for(int round = 0; round < 300; ++round){
+    big_integer x = random_value(1 + (int)(test_random() % 3));
+    big_integer y = random_value(1 + (int)(test_random() % 3));
+    if(round < 3) x = big_integer((long long)round - 1);
+    rns_integer a(basis, x), b(basis, y);
+
+    CHECK(a.to_big_integer() == x);
+    CHECK((a + b).to_big_integer() == (x + y));
+    CHECK((a - b).to_big_integer() == (x - y));
+    CHECK((a * b).to_big_integer() == (x * y));
+    CHECK((-a).to_big_integer() == (big_integer(0LL) - x));
+    CHECK((a * b - a + b * b).to_big_integer() == (x * y - x + y * y));
+    CHECK((a == b) == (x == y));
+    CHECK(a == rns_integer(basis, a.to_big_integer()));
+
+    rns_integer c(a);
+    c += b;
+    c *= a;
+    c -= b;
+    CHECK(c.to_big_integer() == ((x + y) * x - y));
+
+    if(x.get_sign() >= 0)
+      for(int i = 0; i < basis.size(); ++i){
+        big_integer p((long long)basis.get_prime(i));
+        CHECK(big_integer((long long)a.get_residue(i)) == (x % p));
+      }
+  }
+
+  rns_integer small(basis, -7LL), three(basis, 3LL);
+  CHECK((small * three).to_big_integer() == big_integer(-21LL));
+  CHECK(small.get_residue(0) == basis.get_prime(0) - 7);
+
+  rns_basis other(2);
+  bool thrown = false;
+  try {
+    rns_integer(basis, 1LL) + rns_integer(other, 1LL);
+  } catch(std::runtime_error &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+
+  return test_result("rns_integer_test");
+}
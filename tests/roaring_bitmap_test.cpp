@@ -0,0 +1,147 @@
+// roaring_bitmap test
+//
+// random adds and removes on a roaring_bitmap and a std::set of the same
+// values, over a few chunks and with run_optimize now and then so every
+// container type, runs included, takes adds and removes. the contents,
+// the boolean operators and their cardinalities are compared with the
+// set algorithms, and the my_bitset conversions with the set bits. the
+// memory checks use that a bitmap container alone is 8 KB: a chunk that
+// is not too dense for an array must stay well below that.
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <set>
+#include <vector>
+
+#include "roaring_bitmap.h"
+#include "test_check.h"
+
+typedef std::set<unsigned int> value_set;
+
+// a value in one of three chunks, dense in the first 3000 values of a
+// chunk so that runs form
+unsigned int random_value(){
+  unsigned int chunk = (unsigned int)(test_random() % 3) * 7;
+  unsigned int low = (unsigned int)((test_random() % 4) ? test_random() % 3000 : test_random() % 65536);
+  return (chunk << 16) | low;
+}
+
+value_set values_of(const roaring_bitmap &bitmap){
+  std::vector<unsigned int> result;
+  bitmap.for_each([&result](const unsigned int &value){ result.push_back(value); });
+  CHECK(std::is_sorted(result.begin(), result.end()));
+  return value_set(result.begin(), result.end());
+}
+
+roaring_bitmap bitmap_of(const value_set &values){
+  roaring_bitmap result;
+  for(value_set::const_iterator it = values.begin(); it != values.end(); ++it)
+    result.add(*it);
+  return result;
+}
+
+void compare_with(const roaring_bitmap &bitmap, const value_set &reference){
+  CHECK(bitmap.cardinality() == (long long)reference.size());
+  CHECK(bitmap.empty() == reference.empty());
+  CHECK(values_of(bitmap) == reference);
+  if(!reference.empty())
+    CHECK((bitmap.minimum() == *reference.begin()) && (bitmap.maximum() == *reference.rbegin()));
+  for(int i = 0; i < 100; ++i){
+    unsigned int value = random_value();
+    CHECK(bitmap.contains(value) == (reference.count(value) != 0));
+  }
+}
+
+void test_operators(const value_set &values1, const value_set &values2){
+  roaring_bitmap bitmap1 = bitmap_of(values1), bitmap2 = bitmap_of(values2);
+  if(test_random() % 2) bitmap1.run_optimize();
+  if(test_random() % 2) bitmap2.run_optimize();
+
+  value_set both, either, one;
+  std::set_intersection(values1.begin(), values1.end(), values2.begin(), values2.end(), std::inserter(both, both.end()));
+  std::set_union(values1.begin(), values1.end(), values2.begin(), values2.end(), std::inserter(either, either.end()));
+  std::set_symmetric_difference(values1.begin(), values1.end(), values2.begin(), values2.end(), std::inserter(one, one.end()));
+
+  compare_with(bitmap1 & bitmap2, both);
+  compare_with(bitmap1 | bitmap2, either);
+  compare_with(bitmap1 ^ bitmap2, one);
+  CHECK(bitmap1.and_cardinality(bitmap2) == (long long)both.size());
+  CHECK(bitmap1.or_cardinality(bitmap2) == (long long)either.size());
+  CHECK((bitmap1 == bitmap2) == (values1 == values2));
+
+  roaring_bitmap result = bitmap1;
+  result ^= bitmap2;
+  result |= bitmap1;
+  CHECK(values_of(result) == either);
+  result &= bitmap2;
+  CHECK(values_of(result) == values2);
+
+  my_bitset bits = bitmap1.to_my_bitset();
+  CHECK(bits.count() == (long long)values1.size());
+  for(value_set::const_iterator it = values1.begin(); it != values1.end(); ++it)
+    CHECK(bits.get(*it));
+  CHECK(roaring_bitmap(bits) == bitmap1);
+}
+
+// a run container that takes adds and removes stays compact
+void test_run_container_memory(){
+  roaring_bitmap bitmap;
+  for(unsigned int value = 1000; value <= 1100; ++value) bitmap.add(value);
+  bitmap.run_optimize();
+  long long runs_bytes = bitmap.memory_bytes();
+
+  // next to the run, away from it, and splitting it
+  CHECK(bitmap.add(1101) && bitmap.add(5000) && bitmap.remove(1050));
+  CHECK(bitmap.cardinality() == 102);
+  CHECK(bitmap.memory_bytes() < runs_bytes + 64);
+  CHECK(bitmap.contains(1101) && bitmap.contains(5000) && !bitmap.contains(1050) && bitmap.contains(1051));
+
+  // isolated values make the runs larger than an array, the chunk becomes
+  // one, then a bitmap once it passes 4096 values
+  for(unsigned int value = 20000; value < 20000 + 2 * 3000; value += 2) bitmap.add(value);
+  CHECK(bitmap.cardinality() == 3102);
+  CHECK(bitmap.memory_bytes() < 8192);
+  for(unsigned int value = 30000; value < 30000 + 2 * 1000; value += 2) bitmap.add(value);
+  CHECK(bitmap.cardinality() == 4102);
+  CHECK(bitmap.memory_bytes() >= 8192);
+
+  // a long run stays a run through adds and removes
+  roaring_bitmap dense;
+  for(unsigned int value = 0; value < 60000; ++value) dense.add(value);
+  dense.run_optimize();
+  CHECK(dense.memory_bytes() < 256);
+  dense.add(62000);
+  dense.remove(30000);
+  dense.remove(0);
+  dense.add(60000);
+  CHECK(dense.cardinality() == 60000);
+  CHECK(dense.memory_bytes() < 256);
+  CHECK(!dense.contains(0) && dense.contains(1) && !dense.contains(30000) && dense.contains(60000));
+}
+
+int main(){
+  test_run_container_memory();
+
+  roaring_bitmap bitmap;
+  value_set reference;
+  for(int i = 0; i < 60000; ++i){
+    unsigned int value = random_value();
+    if(test_random() % 3) CHECK(bitmap.add(value) == reference.insert(value).second);
+    else CHECK(bitmap.remove(value) == (reference.erase(value) != 0));
+    if(i % 5000 == 0) bitmap.run_optimize();
+    if(i % 1000 == 0) compare_with(bitmap, reference);
+  }
+  compare_with(bitmap, reference);
+
+  for(int round = 0; round < 20; ++round){
+    value_set values1, values2;
+    int count1 = (int)(test_random() % 20000), count2 = (int)(test_random() % 20000);
+    for(int i = 0; i < count1; ++i) values1.insert(random_value());
+    for(int i = 0; i < count2; ++i) values2.insert(random_value());
+    if(round % 5 == 0) values2 = values1;
+    test_operators(values1, values2);
+  }
+
+  return test_result("roaring_bitmap_test");
+}
@@ -0,0 +1,36 @@
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+
+#include <cstdio>
+
+// what the test programs share: a failed CHECK prints its line and
+// condition (the first 20 of them) and counts, main returns
+// test_result(), so ctest sees a nonzero exit code when any check failed,
+// and test_random is a splitmix64 generator, the same sequence on every
+// platform so a failure can be replayed
+
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+    if(!(condition)) { \
+      if(test_failures < 20) std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      ++test_failures; \
+    } \
+  } while(0)
+
+static unsigned long long test_random_state = 1;
+
+inline unsigned long long test_random(){
+  unsigned long long z = (test_random_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+inline int test_result(const char *name){
+  if(test_failures == 0) std::printf("%s: ok\n", name);
+  else std::printf("%s: %d failed checks\n", name, test_failures);
+  return ((test_failures == 0) ? 0 : 1);
+}
+
+#endif /* TEST_CHECK_H_ */